@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+#
+#  Compare two JSON result files written by run.py.
+#
+
+import argparse
+import json
+import sys
+
+
+def load(filename):
+    with open(filename) as data:
+        return json.load(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare two osmium benchmark result files.')
+    parser.add_argument('baseline', help='results of the baseline build')
+    parser.add_argument('current', help='results of the build to compare')
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    if baseline['generator'] != current['generator']:
+        print("Warning: results were created with different input data.",
+              file=sys.stderr)
+
+    base_scenarios = {s['name']: s for s in baseline['scenarios']}
+
+    print("{:<24} {:>10} {:>10} {:>8} {:>12} {:>12} {:>8}".format(
+        'scenario', 'base [s]', 'curr [s]', 'time', 'base RSS', 'curr RSS', 'RSS'))
+    for scenario in current['scenarios']:
+        base = base_scenarios.get(scenario['name'])
+        if base is None:
+            continue
+        time_change = (scenario['median'] / base['median'] - 1.0) * 100.0
+        rss_change = (scenario['peak_rss_kb'] / base['peak_rss_kb'] - 1.0) * 100.0
+        print("{:<24} {:>10.3f} {:>10.3f} {:>+7.1f}% {:>12} {:>12} {:>+7.1f}%".format(
+            scenario['name'], base['median'], scenario['median'], time_change,
+            base['peak_rss_kb'], scenario['peak_rss_kb'], rss_change))
+
+
+if __name__ == '__main__':
+    main()
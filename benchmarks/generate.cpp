@@ -0,0 +1,430 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+/*
+ * Generator for synthetic OSM data used by the benchmarks. The output only
+ * depends on the command line options, the same options always result in
+ * the same data. Random numbers are mapped from the raw output of
+ * std::mt19937_64 by hand, because the distributions in the standard
+ * library give different results on different implementations.
+ */
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/io/any_output.hpp>
+#include <osmium/io/file.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/timestamp.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace po = boost::program_options;
+
+namespace {
+
+    constexpr const std::size_t flush_buffer_size = 10UL * 1024UL * 1024UL;
+
+    struct Options {
+        std::string output;
+        std::string output_format;
+        uint64_t nodes = 1000000;
+        uint64_t ways = 100000;
+        uint64_t relations = 1000;
+        double id_density = 0.5;
+        double tagged_nodes = 0.1;
+        unsigned int max_way_tags = 4;
+        unsigned int max_way_nodes = 20;
+        unsigned int max_members = 10;
+        uint32_t seed = 1;
+        double changes = 0.0;
+        bool shuffle = false;
+        bool overwrite = false;
+    };
+
+    // Keys and values for tags with their relative weights.
+    struct TagChoice {
+        const char* key;
+        const char* value;
+        unsigned int weight;
+    };
+
+    const std::vector<TagChoice> node_tags = {
+        {"amenity", "restaurant", 3},
+        {"amenity", "bench", 2},
+        {"shop", "bakery", 2},
+        {"highway", "bus_stop", 3},
+        {"natural", "tree", 5},
+        {"name", "Synthetic Place", 2},
+        {"addr:housenumber", "42", 4}
+    };
+
+    const std::vector<TagChoice> way_tags = {
+        {"highway", "residential", 20},
+        {"highway", "primary", 5},
+        {"highway", "footway", 10},
+        {"building", "yes", 30},
+        {"landuse", "forest", 5},
+        {"natural", "water", 3},
+        {"name", "Synthetic Street", 15},
+        {"surface", "asphalt", 8},
+        {"oneway", "yes", 4}
+    };
+
+    const std::vector<TagChoice> relation_tags = {
+        {"type", "multipolygon", 6},
+        {"type", "route", 3},
+        {"route", "bus", 2},
+        {"boundary", "administrative", 1},
+        {"name", "Synthetic Relation", 4}
+    };
+
+    const char* const member_roles[] = {"", "outer", "inner", "stop", "platform"};
+
+    // Random number in the range [0, n).
+    uint64_t random_below(std::mt19937_64& rng, uint64_t n) {
+        return rng() % n;
+    }
+
+    // Random number in the range [min, max].
+    unsigned int random_between(std::mt19937_64& rng, unsigned int min, unsigned int max) {
+        return min + static_cast<unsigned int>(random_below(rng, static_cast<uint64_t>(max - min) + 1));
+    }
+
+    // Returns true with the given probability.
+    bool random_chance(std::mt19937_64& rng, double probability) {
+        return static_cast<double>(rng() >> 11U) * (1.0 / 9007199254740992.0) < probability;
+    }
+
+    // Share of the changed objects which are deleted instead of modified.
+    constexpr const double deleted_share = 0.2;
+
+    class Generator {
+
+        Options m_options;
+        std::mt19937_64 m_rng;
+
+        // Decides which objects are changed when writing a change file.
+        // This is separate from m_rng so the objects are generated
+        // exactly as in the data file with the same options.
+        std::mt19937_64 m_change_rng;
+        osmium::memory::Buffer m_buffer{flush_buffer_size + 1024UL * 1024UL, osmium::memory::Buffer::auto_grow::yes};
+        osmium::io::Writer* m_writer = nullptr;
+
+        std::vector<osmium::object_id_type> m_node_ids;
+        std::vector<osmium::object_id_type> m_way_ids;
+        std::vector<osmium::object_id_type> m_relation_ids;
+
+        std::vector<osmium::object_id_type> make_ids(uint64_t count) {
+            std::vector<osmium::object_id_type> ids;
+            ids.reserve(count);
+            osmium::object_id_type id = 0;
+            while (ids.size() < count) {
+                ++id;
+                if (random_chance(m_rng, m_options.id_density)) {
+                    ids.push_back(id);
+                }
+            }
+            return ids;
+        }
+
+        std::vector<osmium::object_id_type> output_order(const std::vector<osmium::object_id_type>& ids) {
+            std::vector<osmium::object_id_type> order{ids};
+            if (m_options.shuffle) {
+                // Fisher-Yates shuffle, std::shuffle is implementation
+                // defined.
+                for (std::size_t n = order.size(); n > 1; --n) {
+                    std::swap(order[n - 1], order[random_below(m_rng, n)]);
+                }
+            }
+            return order;
+        }
+
+        uint64_t random_index(std::size_t size) {
+            return random_below(m_rng, size);
+        }
+
+        const TagChoice& random_tag(const std::vector<TagChoice>& choices) {
+            uint64_t sum = 0;
+            for (const auto& choice : choices) {
+                sum += choice.weight;
+            }
+            auto r = random_below(m_rng, sum);
+            for (const auto& choice : choices) {
+                if (r < choice.weight) {
+                    return choice;
+                }
+                r -= choice.weight;
+            }
+            return choices.back();
+        }
+
+        template <typename TBuilder>
+        void set_metadata(TBuilder& builder, osmium::object_id_type id) {
+            const auto uid = static_cast<osmium::user_id_type>(1 + (id % 1000));
+            builder.set_id(id)
+                   .set_version(static_cast<osmium::object_version_type>(1 + (id % 5)))
+                   .set_changeset(static_cast<osmium::changeset_id_type>(1 + (id / 100)))
+                   .set_uid(uid)
+                   .set_timestamp(osmium::Timestamp{static_cast<uint32_t>(1262304000 + (id % 300000000))});
+            builder.set_user("user_" + std::to_string(uid));
+        }
+
+        template <typename TBuilder>
+        void add_tags(TBuilder& builder, const std::vector<TagChoice>& choices, unsigned int count) {
+            if (count == 0) {
+                return;
+            }
+            osmium::builder::TagListBuilder tl_builder{builder};
+            std::vector<const char*> keys;
+            for (unsigned int n = 0; n < count; ++n) {
+                const auto& tag = random_tag(choices);
+                if (std::find(keys.cbegin(), keys.cend(), tag.key) == keys.cend()) {
+                    keys.push_back(tag.key);
+                    tl_builder.add_tag(tag.key, tag.value);
+                }
+            }
+        }
+
+        // In change file mode decide whether the object just built is
+        // kept as modified or deleted version or is removed from the
+        // buffer again. Otherwise keep all objects.
+        template <typename TObject>
+        void commit_object() {
+            if (m_options.changes > 0.0) {
+                if (!random_chance(m_change_rng, m_options.changes)) {
+                    m_buffer.rollback();
+                    return;
+                }
+                auto& object = m_buffer.get<TObject>(m_buffer.committed());
+                object.set_version(static_cast<osmium::object_version_type>(object.version() + 1));
+                object.set_changeset(object.changeset() + 1000000);
+                object.set_timestamp(osmium::Timestamp{object.timestamp().seconds_since_epoch() + 86400});
+                if (random_chance(m_change_rng, deleted_share)) {
+                    object.set_visible(false);
+                } else {
+                    modify(object);
+                }
+            }
+            m_buffer.commit();
+            flush();
+        }
+
+        void modify(osmium::Node& node) {
+            const auto offset = static_cast<int32_t>(random_below(m_change_rng, 2001)) - 1000;
+            const auto& location = node.location();
+            node.set_location(osmium::Location{location.x() + offset, location.y() - offset});
+        }
+
+        void modify(osmium::Way& way) {
+            auto& nodes = way.nodes();
+            nodes[nodes.size() - 1].set_ref(m_node_ids[random_below(m_change_rng, m_node_ids.size())]);
+        }
+
+        void modify(osmium::Relation& relation) {
+            if (relation.members().empty()) {
+                return;
+            }
+            auto& member = *relation.members().begin();
+            const auto& ids = member.type() == osmium::item_type::way ? m_way_ids : m_node_ids;
+            member.set_ref(ids[random_below(m_change_rng, ids.size())]);
+        }
+
+        void flush(bool force = false) {
+            if (force || m_buffer.committed() > flush_buffer_size) {
+                (*m_writer)(std::move(m_buffer));
+                m_buffer = osmium::memory::Buffer{flush_buffer_size + 1024UL * 1024UL, osmium::memory::Buffer::auto_grow::yes};
+            }
+        }
+
+        void generate_nodes() {
+            constexpr const uint64_t coordinate_range = 10 * osmium::detail::coordinate_precision + 1;
+
+            for (const auto id : output_order(m_node_ids)) {
+                {
+                    osmium::builder::NodeBuilder builder{m_buffer};
+                    set_metadata(builder, id);
+                    const auto x = static_cast<int32_t>(random_below(m_rng, coordinate_range));
+                    const auto y = static_cast<int32_t>(random_below(m_rng, coordinate_range));
+                    builder.set_location(osmium::Location{x, y});
+                    add_tags(builder, node_tags, random_chance(m_rng, m_options.tagged_nodes) ? random_between(m_rng, 1, 3) : 0);
+                }
+                commit_object<osmium::Node>();
+            }
+        }
+
+        void generate_ways() {
+            for (const auto id : output_order(m_way_ids)) {
+                {
+                    osmium::builder::WayBuilder builder{m_buffer};
+                    set_metadata(builder, id);
+                    const auto count = random_between(m_rng, 2, std::max(2U, m_options.max_way_nodes));
+                    const auto start = random_index(m_node_ids.size());
+                    {
+                        osmium::builder::WayNodeListBuilder wnl_builder{builder};
+                        for (unsigned int n = 0; n < count; ++n) {
+                            wnl_builder.add_node_ref(m_node_ids[(start + n) % m_node_ids.size()]);
+                        }
+                    }
+                    add_tags(builder, way_tags, random_between(m_rng, 0, m_options.max_way_tags));
+                }
+                commit_object<osmium::Way>();
+            }
+        }
+
+        void generate_relations() {
+            constexpr const uint64_t num_roles = sizeof(member_roles) / sizeof(member_roles[0]);
+
+            for (const auto id : output_order(m_relation_ids)) {
+                {
+                    osmium::builder::RelationBuilder builder{m_buffer};
+                    set_metadata(builder, id);
+                    const auto count = random_between(m_rng, 1, std::max(1U, m_options.max_members));
+                    {
+                        osmium::builder::RelationMemberListBuilder rml_builder{builder};
+                        for (unsigned int n = 0; n < count; ++n) {
+                            if (!m_way_ids.empty() && (n % 2 == 0 || m_node_ids.empty())) {
+                                rml_builder.add_member(osmium::item_type::way, m_way_ids[random_index(m_way_ids.size())], member_roles[random_below(m_rng, num_roles)]);
+                            } else if (!m_node_ids.empty()) {
+                                rml_builder.add_member(osmium::item_type::node, m_node_ids[random_index(m_node_ids.size())], member_roles[random_below(m_rng, num_roles)]);
+                            }
+                        }
+                    }
+                    add_tags(builder, relation_tags, random_between(m_rng, 1, 3));
+                }
+                commit_object<osmium::Relation>();
+            }
+        }
+
+    public:
+
+        explicit Generator(const Options& options) :
+            m_options(options),
+            m_rng(options.seed),
+            m_change_rng(static_cast<uint64_t>(options.seed) + 0x9e3779b97f4a7c15ULL) {
+            m_node_ids = make_ids(m_options.nodes);
+            m_way_ids = make_ids(m_options.ways);
+            m_relation_ids = make_ids(m_options.relations);
+        }
+
+        void run() {
+            osmium::io::File file{m_options.output, m_options.output_format};
+            osmium::io::Header header;
+            header.set("generator", "osmium-bench-generate");
+            header.add_box(osmium::Box{0.0, 0.0, 10.0, 10.0});
+
+            osmium::io::Writer writer{file, header, m_options.overwrite ? osmium::io::overwrite::allow : osmium::io::overwrite::no};
+            m_writer = &writer;
+
+            generate_nodes();
+            generate_ways();
+            generate_relations();
+
+            flush(true);
+            writer.close();
+            m_writer = nullptr;
+        }
+
+    }; // class Generator
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+
+    po::options_description desc{"Usage: osmium-bench-generate [OPTIONS] -o OUTPUT-FILE\n\nOptions"};
+    desc.add_options()
+    ("help,h", "Show usage help")
+    ("output,o", po::value<std::string>(&options.output)->required(), "Output file")
+    ("output-format,f", po::value<std::string>(&options.output_format), "Format of output file")
+    ("overwrite,O", "Allow existing output file to be overwritten")
+    ("nodes", po::value<uint64_t>(&options.nodes), "Number of nodes (default: 1000000)")
+    ("ways", po::value<uint64_t>(&options.ways), "Number of ways (default: 100000)")
+    ("relations", po::value<uint64_t>(&options.relations), "Number of relations (default: 1000)")
+    ("id-density", po::value<double>(&options.id_density), "Fraction of IDs used, between 0 and 1 (default: 0.5)")
+    ("tagged-nodes", po::value<double>(&options.tagged_nodes), "Fraction of nodes with tags (default: 0.1)")
+    ("max-way-tags", po::value<unsigned int>(&options.max_way_tags), "Maximum number of tags on ways (default: 4)")
+    ("max-way-nodes", po::value<unsigned int>(&options.max_way_nodes), "Maximum number of nodes in ways (default: 20)")
+    ("max-members", po::value<unsigned int>(&options.max_members), "Maximum number of relation members (default: 10)")
+    ("seed", po::value<uint32_t>(&options.seed), "Seed for random number generator (default: 1)")
+    ("shuffle", "Write objects of each type in random order (unsorted file)")
+    ("changes", po::value<double>(&options.changes), "Write a change file modifying or deleting this fraction of the objects generated with the same options")
+    ;
+
+    try {
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+
+        if (vm.count("help")) {
+            std::cout << desc << "\n";
+            return 0;
+        }
+
+        po::notify(vm);
+
+        options.shuffle = vm.count("shuffle") != 0;
+        options.overwrite = vm.count("overwrite") != 0;
+
+        if (options.id_density <= 0.0 || options.id_density > 1.0) {
+            std::cerr << "Option --id-density must be larger than 0 and not larger than 1.\n";
+            return 2;
+        }
+
+        if (options.changes < 0.0 || options.changes > 1.0) {
+            std::cerr << "Option --changes must be between 0 and 1.\n";
+            return 2;
+        }
+
+        if (options.nodes == 0 && options.ways > 0) {
+            std::cerr << "Need some nodes for the ways.\n";
+            return 2;
+        }
+
+        Generator generator{options};
+        generator.run();
+    } catch (const po::error& e) {
+        std::cerr << e.what() << "\n";
+        return 2;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
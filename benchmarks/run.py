@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+#
+#  Run the osmium benchmark scenarios on synthetic data and write the
+#  results as JSON. Usually called through the 'bench' CMake target.
+#
+
+import argparse
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import time
+
+# Size of the generated data at scale 1. All counts are multiplied by the
+# scale factor.
+BASE_PARAMS = {
+    'nodes': 2000000,
+    'ways': 250000,
+    'relations': 5000,
+    'id-density': 0.5,
+    'tagged-nodes': 0.1,
+    'max-way-tags': 4,
+    'max-way-nodes': 20,
+    'max-members': 10,
+}
+
+SEED_INPUT = 1
+SEED_SECOND = 2
+
+# Fraction of the objects in the input data changed by the change file.
+CHANGES = 0.1
+
+
+def generator_params(scale):
+    params = dict(BASE_PARAMS)
+    for key in ('nodes', 'ways', 'relations'):
+        params[key] = max(1, int(params[key] * scale))
+    return params
+
+
+def run_timed(cmd):
+    """Run a command, return wall time in seconds and peak RSS in kB."""
+    start = time.perf_counter()
+    proc = subprocess.Popen(cmd, stdout=subprocess.DEVNULL)
+    _, status, rusage = os.wait4(proc.pid, 0)
+    elapsed = time.perf_counter() - start
+    proc.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+    if proc.returncode != 0:
+        raise RuntimeError("command failed with return code {}: {}".format(
+            proc.returncode, ' '.join(cmd)))
+    # ru_maxrss is in kilobytes on Linux, in bytes on macOS
+    maxrss = rusage.ru_maxrss
+    if sys.platform == 'darwin':
+        maxrss //= 1024
+    return elapsed, maxrss
+
+
+def generate(generator, filename, params, seed, shuffle=False, changes=None):
+    cmd = [generator, '-O', '-o', filename, '--seed', str(seed)]
+    for key, value in params.items():
+        cmd.extend(['--' + key, str(value)])
+    if shuffle:
+        cmd.append('--shuffle')
+    if changes is not None:
+        cmd.extend(['--changes', str(changes)])
+    subprocess.run(cmd, check=True)
+
+
+def scenarios(osmium, data, out):
+    """List of (name, command) pairs for all benchmark scenarios."""
+    return [
+        ('cat', [osmium, 'cat', '-O', '-o', out('cat.osm.pbf'),
+                 data('input.osm.pbf')]),
+        ('sort', [osmium, 'sort', '-O', '-o', out('sort.osm.pbf'),
+                  data('shuffled.osm.pbf')]),
+        ('merge', [osmium, 'merge', '-O', '-o', out('merge.osm.pbf'),
+                   data('input.osm.pbf'), data('input2.osm.pbf')]),
+        ('extract', [osmium, 'extract', '-O', '-b', '0,0,5,5',
+                     '-o', out('extract.osm.pbf'), data('input.osm.pbf')]),
+        ('export', [osmium, 'export', '-O', '-f', 'geojsonseq',
+                    '-o', out('export.geojsonseq'), data('input.osm.pbf')]),
+        ('tags-filter', [osmium, 'tags-filter', '-O',
+                         '-o', out('tags-filter.osm.pbf'),
+                         data('input.osm.pbf'), 'w/highway']),
+        ('add-locations-to-ways', [osmium, 'add-locations-to-ways', '-O',
+                                   '-o', out('add-locations.osm.pbf'),
+                                   data('input.osm.pbf')]),
+        ('apply-changes', [osmium, 'apply-changes', '-O',
+                           '-o', out('apply-changes.osm.pbf'),
+                           data('input.osm.pbf'), data('changes.osc.gz')]),
+    ]
+
+
+def osmium_version(osmium):
+    result = subprocess.run([osmium, 'version'], stdout=subprocess.PIPE,
+                            universal_newlines=True, check=True)
+    return result.stdout.splitlines()[0] if result.stdout else ''
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Run osmium benchmarks on synthetic data.')
+    parser.add_argument('--osmium', required=True,
+                        help='osmium binary to benchmark')
+    parser.add_argument('--generator', required=True,
+                        help='osmium-bench-generate binary')
+    parser.add_argument('--work-dir', required=True,
+                        help='directory for generated and output data')
+    parser.add_argument('--output', required=True,
+                        help='file to write JSON results to')
+    parser.add_argument('--scale', type=float, default=1.0,
+                        help='scale factor for generated data size')
+    parser.add_argument('--repeat', type=int, default=3,
+                        help='number of runs per scenario')
+    parser.add_argument('--only', action='append', default=[],
+                        help='only run this scenario (can be given several times)')
+    args = parser.parse_args()
+
+    os.makedirs(args.work_dir, exist_ok=True)
+
+    def data(name):
+        return os.path.join(args.work_dir, name)
+
+    out_dir = data('out')
+    os.makedirs(out_dir, exist_ok=True)
+
+    def out(name):
+        return os.path.join(out_dir, name)
+
+    params = generator_params(args.scale)
+    num_objects = params['nodes'] + params['ways'] + params['relations']
+
+    # Generating the input data is not timed. The data only depends on the
+    # parameters and seeds, so it is the same for every build.
+    print("Generating input data...", flush=True)
+    generate(args.generator, data('input.osm.pbf'), params, SEED_INPUT)
+    generate(args.generator, data('input2.osm.pbf'), params, SEED_SECOND)
+    generate(args.generator, data('shuffled.osm.pbf'), params, SEED_INPUT,
+             shuffle=True)
+    generate(args.generator, data('changes.osc.gz'), params, SEED_INPUT,
+             changes=CHANGES)
+
+    results = []
+    for name, cmd in scenarios(args.osmium, data, out):
+        if args.only and name not in args.only:
+            continue
+        print("Running {}...".format(name), flush=True)
+        times = []
+        peak_rss = 0
+        for _ in range(args.repeat):
+            elapsed, maxrss = run_timed(cmd)
+            times.append(round(elapsed, 4))
+            peak_rss = max(peak_rss, maxrss)
+        median = statistics.median(times)
+        results.append({
+            'name': name,
+            'command': ' '.join(cmd[1:]),
+            'times': times,
+            'median': round(median, 4),
+            'peak_rss_kb': peak_rss,
+            'objects': num_objects,
+            'objects_per_second': round(num_objects / median) if median > 0 else None,
+        })
+        print("  median {:.3f}s, peak RSS {} kB".format(median, peak_rss),
+              flush=True)
+
+    report = {
+        'format_version': 1,
+        'osmium_version': osmium_version(args.osmium),
+        'host': {
+            'machine': platform.machine(),
+            'system': platform.system(),
+            'cpus': os.cpu_count(),
+        },
+        'generator': {
+            'params': params,
+            'seeds': [SEED_INPUT, SEED_SECOND],
+            'changes': CHANGES,
+        },
+        'repeat': args.repeat,
+        'scenarios': results,
+    }
+
+    with open(args.output, 'w') as out_file:
+        json.dump(report, out_file, indent=2)
+        out_file.write('\n')
+
+    print("Results written to {}".format(args.output))
+
+
+if __name__ == '__main__':
+    main()
@@ -5,8 +5,11 @@
 #  Then runs a test command given in the variable 'cmd' in directory 'dir'.
 #  Checks that the return code is the same as variable 'return_code'.
 #  Checks that there is nothing on stderr.
+#  If the variables 'edit_file', 'edit_regex', and 'edit_replace' are set,
+#  the regex is replaced in the file after running the first command.
 #  If the variable 'cmd2' is set, the command will be run and checked in the
-#  same manner.
+#  same manner. If the variable 'stderr2_regex' is set, the stderr output
+#  of this command must match the regex instead of being empty.
 #  Compares output on stdout with reference file in variable 'reference'.
 #
 
@@ -52,6 +55,13 @@ if(NOT result EQUAL ${return_code})
     message(FATAL_ERROR "Error when calling '${cmd}': ${result} (should be ${return_code})")
 endif()
 
+if(edit_file)
+    message("Editing: ${edit_file}")
+    file(READ ${edit_file} _content)
+    string(REGEX REPLACE "${edit_regex}" "${edit_replace}" _content "${_content}")
+    file(WRITE ${edit_file} "${_content}")
+endif()
+
 if(cmd2)
     message("Executing: ${cmd2}")
     separate_arguments(cmd2)
@@ -64,7 +74,11 @@ if(cmd2)
         ERROR_VARIABLE stderr
     )
 
-    if(NOT (stderr STREQUAL ""))
+    if(stderr2_regex)
+        if(NOT (stderr MATCHES "${stderr2_regex}"))
+            message(SEND_ERROR "Output on stderr does not match '${stderr2_regex}': ${stderr}")
+        endif()
+    elseif(NOT (stderr STREQUAL ""))
         message(SEND_ERROR "Command tested wrote to stderr: ${stderr}")
     endif()
 
@@ -4,6 +4,7 @@ set(OSMIUM_INSTALL_FILES
     share/man/man1/osmium-apply-changes.1
     share/man/man1/osmium-cat.1
     share/man/man1/osmium-changeset-filter.1
+    share/man/man1/osmium-changeset-index.1
     share/man/man1/osmium-check-refs.1
     share/man/man1/osmium-create-locations-index.1
     share/man/man1/osmium-derive-changes.1
@@ -13,8 +14,10 @@ set(OSMIUM_INSTALL_FILES
     share/man/man1/osmium-fileinfo.1
     share/man/man1/osmium-getid.1
     share/man/man1/osmium-getparents.1
+    share/man/man1/osmium-index.1
     share/man/man1/osmium-merge-changes.1
     share/man/man1/osmium-merge.1
+    share/man/man1/osmium-pipeline.1
     share/man/man1/osmium-query-locations-index.1
     share/man/man1/osmium-removeid.1
     share/man/man1/osmium-renumber.1
@@ -0,0 +1,118 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "buffer_compactor.hpp"
+
+#include <osmium/thread/pool.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+    // Buffers filled at least this much are not copied.
+    constexpr const std::size_t min_fill_percent = 90;
+
+    // Maximum number of output buffers waiting for the worker threads.
+    constexpr const std::size_t max_pending_buffers = 20;
+
+    bool is_full(const osmium::memory::Buffer& buffer) noexcept {
+        return buffer.committed() * 100 >= buffer.capacity() * min_fill_percent;
+    }
+
+    bool is_ready(const std::future<osmium::memory::Buffer>& future) {
+        return future.wait_for(std::chrono::seconds{0}) == std::future_status::ready;
+    }
+
+} // anonymous namespace
+
+BufferCompactor::BufferCompactor(output_func_type output, std::size_t buffer_size) :
+    m_output(std::move(output)),
+    m_buffer_size(buffer_size) {
+}
+
+osmium::memory::Buffer BufferCompactor::pack(std::vector<osmium::memory::Buffer>& buffers, std::size_t size) {
+    osmium::memory::Buffer output{size, osmium::memory::Buffer::auto_grow::no};
+
+    // The items in a buffer only contain offsets relative to their own
+    // position, so the committed data can be copied as a whole. The
+    // copied buffers are freed when the vector goes away. They don't go
+    // into the buffer pool, because the commands using this class never
+    // take buffers from there.
+    for (const auto& buffer : buffers) {
+        std::memcpy(output.reserve_space(buffer.committed()), buffer.data(), buffer.committed());
+        output.commit();
+    }
+
+    return output;
+}
+
+void BufferCompactor::submit_group() {
+    if (m_group.empty()) {
+        return;
+    }
+
+    m_pending.push_back(osmium::thread::Pool::default_instance().submit([buffers = std::move(m_group), size = m_group_size]() mutable {
+        return pack(buffers, size);
+    }));
+
+    m_group.clear();
+    m_group_size = 0;
+}
+
+void BufferCompactor::pass_through(osmium::memory::Buffer&& buffer) {
+    std::promise<osmium::memory::Buffer> promise;
+    promise.set_value(std::move(buffer));
+    m_pending.push_back(promise.get_future());
+}
+
+void BufferCompactor::output_ready(std::size_t max_pending) {
+    while (!m_pending.empty() && (m_pending.size() > max_pending || is_ready(m_pending.front()))) {
+        m_output(m_pending.front().get());
+        m_pending.pop_front();
+    }
+}
+
+void BufferCompactor::add(osmium::memory::Buffer&& buffer) {
+    if (buffer.committed() == 0) {
+        return;
+    }
+
+    if (is_full(buffer)) {
+        submit_group();
+        pass_through(std::move(buffer));
+    } else {
+        if (m_group_size + buffer.committed() > m_buffer_size) {
+            submit_group();
+        }
+        m_group_size += buffer.committed();
+        m_group.push_back(std::move(buffer));
+    }
+
+    output_ready(max_pending_buffers);
+}
+
+void BufferCompactor::flush() {
+    submit_group();
+    output_ready(0);
+}
@@ -0,0 +1,91 @@
+#ifndef BUFFER_COMPACTOR_HPP
+#define BUFFER_COMPACTOR_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <vector>
+
+/**
+ * Packs the contents of partially filled buffers densely into new
+ * buffers. This is used by commands keeping lots of buffers from a reader
+ * in memory, which are often only half full.
+ *
+ * Buffers are added in order and come out in the same order through the
+ * output function, so the order of the objects is retained. Buffers which
+ * are (nearly) full are passed through unchanged, the others are collected
+ * until there is enough data for a new buffer. The copying happens on the
+ * worker threads of the thread pool while the caller reads more data. The
+ * buffers which were copied are freed.
+ *
+ * The output function is always called from the thread calling add() or
+ * flush(). Data in the output buffers doesn't move any more, so pointers
+ * to the objects in them can be kept.
+ */
+class BufferCompactor {
+
+public:
+
+    using output_func_type = std::function<void(osmium::memory::Buffer&&)>;
+
+private:
+
+    output_func_type m_output;
+    std::size_t m_buffer_size;
+
+    // Partially filled buffers collected for the next output buffer.
+    std::vector<osmium::memory::Buffer> m_group;
+    std::size_t m_group_size = 0;
+
+    std::deque<std::future<osmium::memory::Buffer>> m_pending;
+
+    void submit_group();
+    void pass_through(osmium::memory::Buffer&& buffer);
+    void output_ready(std::size_t max_pending);
+
+public:
+
+    // Default (maximum) size of the buffers created.
+    static constexpr const std::size_t default_buffer_size = 16UL * 1024UL * 1024UL;
+
+    explicit BufferCompactor(output_func_type output, std::size_t buffer_size = default_buffer_size);
+
+    // Copy the contents of the buffers into a new buffer of exactly the
+    // size needed.
+    static osmium::memory::Buffer pack(std::vector<osmium::memory::Buffer>& buffers, std::size_t size);
+
+    // Add the next buffer.
+    void add(osmium::memory::Buffer&& buffer);
+
+    // Pack the remaining buffers and wait until everything has been
+    // handed to the output function.
+    void flush();
+
+}; // class BufferCompactor
+
+#endif // BUFFER_COMPACTOR_HPP
@@ -0,0 +1,96 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "buffer_pool.hpp"
+
+#include <utility>
+
+namespace {
+
+    // Keep this small, every buffer in the pool is memory nobody else
+    // can use.
+    constexpr const std::size_t default_max_buffers = 16;
+    constexpr const std::size_t default_max_memory = 64UL * 1024UL * 1024UL;
+
+} // anonymous namespace
+
+BufferPool& BufferPool::instance() {
+    static BufferPool pool{default_max_buffers, default_max_memory};
+    return pool;
+}
+
+osmium::memory::Buffer BufferPool::get(std::size_t capacity, std::size_t min_capacity) {
+    {
+        const std::lock_guard<std::mutex> lock{m_mutex};
+
+        // Use the smallest buffer that is large enough.
+        auto best = m_buffers.end();
+        for (auto it = m_buffers.begin(); it != m_buffers.end(); ++it) {
+            if (it->capacity() >= min_capacity &&
+                (best == m_buffers.end() || it->capacity() < best->capacity())) {
+                best = it;
+            }
+        }
+
+        if (best != m_buffers.end()) {
+            osmium::memory::Buffer buffer{std::move(*best)};
+            if (best != m_buffers.end() - 1) {
+                *best = std::move(m_buffers.back());
+            }
+            m_buffers.pop_back();
+            m_memory -= buffer.capacity();
+            return buffer;
+        }
+    }
+
+    return osmium::memory::Buffer{capacity, osmium::memory::Buffer::auto_grow::yes};
+}
+
+void BufferPool::put(osmium::memory::Buffer&& buffer) {
+    if (!buffer) {
+        return;
+    }
+
+    buffer.clear();
+
+    const std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_buffers.size() < m_max_buffers && m_memory + buffer.capacity() <= m_max_memory) {
+        m_memory += buffer.capacity();
+        m_buffers.push_back(std::move(buffer));
+    }
+}
+
+std::size_t BufferPool::size() const {
+    const std::lock_guard<std::mutex> lock{m_mutex};
+    return m_buffers.size();
+}
+
+std::size_t BufferPool::memory() const {
+    const std::lock_guard<std::mutex> lock{m_mutex};
+    return m_memory;
+}
+
+void BufferPool::clear() {
+    const std::lock_guard<std::mutex> lock{m_mutex};
+    m_buffers.clear();
+    m_memory = 0;
+}
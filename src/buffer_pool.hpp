@@ -0,0 +1,88 @@
+#ifndef BUFFER_POOL_HPP
+#define BUFFER_POOL_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+/**
+ * Pool of buffers for reuse. Code that is done with a buffer (for instance
+ * after processing a buffer from a reader) can give it back to the pool,
+ * code that needs a new buffer takes one from the pool. This saves
+ * allocating and page-faulting in the memory for each new buffer.
+ *
+ * Buffers handed to an osmium::io::Writer are consumed by the writer and
+ * can not come back to the pool.
+ *
+ * Buffers from the pool might or might not grow automatically, so users
+ * must check that there is enough space before adding items. All functions
+ * are thread safe.
+ */
+class BufferPool {
+
+    std::vector<osmium::memory::Buffer> m_buffers;
+    std::size_t m_max_buffers;
+    std::size_t m_memory = 0;
+    std::size_t m_max_memory;
+    mutable std::mutex m_mutex;
+
+public:
+
+    BufferPool(std::size_t max_buffers, std::size_t max_memory) :
+        m_max_buffers(max_buffers),
+        m_max_memory(max_memory) {
+    }
+
+    // The pool shared by all code in the process.
+    static BufferPool& instance();
+
+    // Get an empty buffer with at least min_capacity bytes from the pool.
+    // If there is none, a new buffer with the specified capacity is
+    // allocated.
+    osmium::memory::Buffer get(std::size_t capacity, std::size_t min_capacity);
+
+    // Get an empty buffer with at least the specified capacity.
+    osmium::memory::Buffer get(std::size_t capacity) {
+        return get(capacity, capacity);
+    }
+
+    // Give a buffer back to the pool. The buffer is cleared. If the pool
+    // is full, the buffer is freed.
+    void put(osmium::memory::Buffer&& buffer);
+
+    // Number of buffers in the pool.
+    std::size_t size() const;
+
+    // Sum of the capacities of the buffers in the pool.
+    std::size_t memory() const;
+
+    // Free all buffers in the pool.
+    void clear();
+
+}; // class BufferPool
+
+#endif // BUFFER_POOL_HPP
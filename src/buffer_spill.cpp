@@ -0,0 +1,118 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "buffer_spill.hpp"
+
+#include <cerrno>
+#include <system_error>
+#include <utility>
+
+SpillFile::SpillFile() :
+    m_file(std::tmpfile()) {
+    if (!m_file) {
+        throw std::system_error{errno, std::system_category(), "Could not create temporary file"};
+    }
+}
+
+// Each buffer is written as its size followed by its data.
+void SpillFile::write(const osmium::memory::Buffer& buffer) {
+    const uint64_t size = buffer.committed();
+    if (std::fwrite(&size, sizeof(size), 1, m_file.get()) != 1 ||
+        std::fwrite(buffer.data(), 1, size, m_file.get()) != size) {
+        throw std::system_error{errno, std::system_category(), "Write error on temporary file"};
+    }
+    m_written += sizeof(size) + size;
+}
+
+void SpillFile::rewind() {
+    if (std::fflush(m_file.get()) != 0) {
+        throw std::system_error{errno, std::system_category(), "Write error on temporary file"};
+    }
+    std::rewind(m_file.get());
+}
+
+osmium::memory::Buffer SpillFile::read() {
+    uint64_t size = 0;
+    if (std::fread(&size, sizeof(size), 1, m_file.get()) != 1) {
+        if (std::ferror(m_file.get())) {
+            throw std::system_error{errno, std::system_category(), "Read error on temporary file"};
+        }
+        return osmium::memory::Buffer{};
+    }
+
+    osmium::memory::Buffer buffer{static_cast<std::size_t>(size), osmium::memory::Buffer::auto_grow::no};
+    if (std::fread(buffer.reserve_space(static_cast<std::size_t>(size)), 1, size, m_file.get()) != size) {
+        throw std::system_error{errno, std::system_category(), "Read error on temporary file"};
+    }
+    buffer.commit();
+
+    return buffer;
+}
+
+void BufferSpill::spill() {
+    if (!m_file) {
+        m_file = std::make_unique<SpillFile>();
+    }
+    for (const auto& buffer : m_buffers) {
+        m_file->write(buffer);
+    }
+    m_buffers.clear();
+    m_in_memory = 0;
+}
+
+void BufferSpill::add(osmium::memory::Buffer&& buffer) {
+    if (buffer.committed() == 0) {
+        return;
+    }
+    m_in_memory += buffer.capacity();
+    m_buffers.push_back(std::move(buffer));
+    if (m_in_memory > m_max_in_memory) {
+        spill();
+    }
+}
+
+void BufferSpill::for_each(const std::function<void(const osmium::memory::Buffer&)>& func) {
+    if (m_file) {
+        m_file->rewind();
+        while (const auto buffer = m_file->read()) {
+            func(buffer);
+        }
+    }
+    for (const auto& buffer : m_buffers) {
+        func(buffer);
+    }
+}
+
+void BufferSpill::consume(const std::function<void(osmium::memory::Buffer&&)>& func) {
+    if (m_file) {
+        m_file->rewind();
+        while (auto buffer = m_file->read()) {
+            func(std::move(buffer));
+        }
+        m_file.reset();
+    }
+    for (auto& buffer : m_buffers) {
+        func(std::move(buffer));
+    }
+    m_buffers.clear();
+    m_in_memory = 0;
+}
@@ -0,0 +1,116 @@
+#ifndef BUFFER_SPILL_HPP
+#define BUFFER_SPILL_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * Temporary file buffers can be written to and read back from in the
+ * same order. The file is removed automatically when it is closed.
+ */
+class SpillFile {
+
+    struct file_closer {
+        void operator()(std::FILE* file) const noexcept {
+            std::fclose(file);
+        }
+    };
+
+    std::unique_ptr<std::FILE, file_closer> m_file;
+    uint64_t m_written = 0;
+
+public:
+
+    SpillFile();
+
+    // Append the committed data of the buffer to the file.
+    void write(const osmium::memory::Buffer& buffer);
+
+    // Start reading from the beginning of the file.
+    void rewind();
+
+    // Read the next buffer. Returns an invalid buffer at the end of the
+    // file.
+    osmium::memory::Buffer read();
+
+    // Bytes written to the file.
+    uint64_t written() const noexcept {
+        return m_written;
+    }
+
+}; // class SpillFile
+
+/**
+ * Keeps buffers in the order they were added. If the buffers take more
+ * than max_in_memory bytes, they are written to a temporary file and
+ * read back from there when they are needed.
+ */
+class BufferSpill {
+
+    std::vector<osmium::memory::Buffer> m_buffers;
+    std::unique_ptr<SpillFile> m_file;
+    std::size_t m_in_memory = 0;
+    std::size_t m_max_in_memory;
+
+    void spill();
+
+public:
+
+    explicit BufferSpill(std::size_t max_in_memory) :
+        m_max_in_memory(max_in_memory) {
+    }
+
+    void set_max_in_memory(std::size_t max_in_memory) noexcept {
+        m_max_in_memory = max_in_memory;
+    }
+
+    void add(osmium::memory::Buffer&& buffer);
+
+    bool empty() const noexcept {
+        return m_buffers.empty() && !m_file;
+    }
+
+    // Bytes written to the temporary file.
+    uint64_t used_disk() const noexcept {
+        return m_file ? m_file->written() : 0;
+    }
+
+    // Call func for all buffers in the order they were added. Can be
+    // called several times.
+    void for_each(const std::function<void(const osmium::memory::Buffer&)>& func);
+
+    // Hand all buffers to func in the order they were added. Afterwards
+    // the object is empty.
+    void consume(const std::function<void(osmium::memory::Buffer&&)>& func);
+
+}; // class BufferSpill
+
+#endif // BUFFER_SPILL_HPP
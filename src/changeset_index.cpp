@@ -0,0 +1,550 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "changeset_index.hpp"
+
+#include "util.hpp"
+
+#include <osmium/geom/relations.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/writer_options.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/util/file.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+    const char magic[8] = {'O', 'S', 'M', 'C', 'S', 'I', 'D', 'X'};
+    constexpr const uint32_t format_version = 1;
+
+    // Used to detect an index written on a machine with different byte order.
+    constexpr const uint32_t byte_order_mark = 0x01020304;
+
+    constexpr const std::size_t header_size = sizeof(magic) + 2 * sizeof(uint32_t);
+    constexpr const std::size_t footer_size = 2 * sizeof(uint64_t) + sizeof(magic);
+
+    constexpr const int grid_width = 360;
+    constexpr const int grid_height = 180;
+
+    // Maximum number of blocks handed to the worker threads for
+    // compression which haven't been written out yet.
+    constexpr const std::size_t max_pending_blocks = 20;
+
+    constexpr const std::size_t initial_buffer_size = 1024UL * 1024UL;
+
+    // Upper bounds for the uncompressed size of a block read from the
+    // index. Zlib can not compress better than about 1:1032, so a larger
+    // size in the index can only come from a broken file.
+    constexpr const uint64_t max_compression_ratio = 1032;
+    constexpr const uint64_t max_block_size = 1024UL * 1024UL * 1024UL;
+
+    template <typename T>
+    void append(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T)); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    }
+
+    void append(std::string& out, const osmium::Box& box) {
+        append(out, box.bottom_left().x());
+        append(out, box.bottom_left().y());
+        append(out, box.top_right().x());
+        append(out, box.top_right().y());
+    }
+
+    void append(std::string& out, const std::vector<uint32_t>& blocks) {
+        append(out, static_cast<uint32_t>(blocks.size()));
+        for (const auto block : blocks) {
+            append(out, block);
+        }
+    }
+
+    std::string header() {
+        std::string out{magic, sizeof(magic)};
+        append(out, format_version);
+        append(out, byte_order_mark);
+        return out;
+    }
+
+    std::runtime_error broken_index(const std::string& filename) {
+        return std::runtime_error{"Changeset index file '" + filename + "' is broken."};
+    }
+
+    class TableReader {
+
+        const std::string& m_data;
+        const std::string& m_filename;
+        std::size_t m_pos = 0;
+
+        void check(std::size_t size) const {
+            if (m_pos + size > m_data.size()) {
+                throw broken_index(m_filename);
+            }
+        }
+
+    public:
+
+        TableReader(const std::string& data, const std::string& filename) noexcept :
+            m_data(data),
+            m_filename(filename) {
+        }
+
+        template <typename T>
+        T get() {
+            check(sizeof(T));
+            T value;
+            std::memcpy(&value, m_data.data() + m_pos, sizeof(T));
+            m_pos += sizeof(T);
+            return value;
+        }
+
+        // Get the number of elements of the given size which follow.
+        // Checks that there is enough data left for all of them, so
+        // corrupt counts don't lead to huge allocations.
+        std::size_t get_count(std::size_t element_size) {
+            const auto count = get<uint64_t>();
+            if (count > (m_data.size() - m_pos) / element_size) {
+                throw broken_index(m_filename);
+            }
+            return static_cast<std::size_t>(count);
+        }
+
+        std::string get_string() {
+            const auto size = get<uint32_t>();
+            check(size);
+            std::string str{m_data.data() + m_pos, size};
+            m_pos += size;
+            return str;
+        }
+
+        osmium::Box get_box() {
+            const auto x1 = get<int32_t>();
+            const auto y1 = get<int32_t>();
+            const auto x2 = get<int32_t>();
+            const auto y2 = get<int32_t>();
+            return osmium::Box{osmium::Location{x1, y1}, osmium::Location{x2, y2}};
+        }
+
+        std::vector<uint32_t> get_blocks(std::size_t num_blocks) {
+            const auto size = get<uint32_t>();
+            check(static_cast<std::size_t>(size) * sizeof(uint32_t));
+            std::vector<uint32_t> blocks(size);
+            for (auto& block : blocks) {
+                block = get_block(num_blocks);
+            }
+            return blocks;
+        }
+
+        uint32_t get_block(std::size_t num_blocks) {
+            const auto block = get<uint32_t>();
+            if (block >= num_blocks) {
+                throw broken_index(m_filename);
+            }
+            return block;
+        }
+
+    }; // class TableReader
+
+    void add_block_to(std::vector<uint32_t>& blocks, uint32_t block) {
+        if (blocks.empty() || blocks.back() != block) {
+            blocks.push_back(block);
+        }
+    }
+
+    int cell_x(const osmium::Location& location) noexcept {
+        return std::min(std::max(static_cast<int>(std::floor(location.lon_without_check() + 180.0)), 0), grid_width - 1);
+    }
+
+    int cell_y(const osmium::Location& location) noexcept {
+        return std::min(std::max(static_cast<int>(std::floor(location.lat_without_check() + 90.0)), 0), grid_height - 1);
+    }
+
+    std::string compress_buffer(const osmium::memory::Buffer& buffer) {
+        uLongf size = ::compressBound(static_cast<uLong>(buffer.committed()));
+        std::string out(size, '\0');
+        if (::compress2(reinterpret_cast<Bytef*>(&out[0]), &size, buffer.data(), static_cast<uLong>(buffer.committed()), Z_DEFAULT_COMPRESSION) != Z_OK) { // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+            throw std::runtime_error{"Compression of changeset index block failed."};
+        }
+        out.resize(size);
+        return out;
+    }
+
+} // anonymous namespace
+
+std::string changeset_index_filename(const std::string& changeset_filename) {
+    return changeset_filename + ".csidx";
+}
+
+ChangesetIndex::ChangesetIndex() :
+    m_grid(static_cast<std::size_t>(grid_width) * grid_height) {
+}
+
+void ChangesetIndex::add_block() {
+    m_blocks.emplace_back();
+}
+
+void ChangesetIndex::add(const osmium::Changeset& changeset) {
+    const auto block_num = static_cast<uint32_t>(m_blocks.size() - 1);
+    auto& block = m_blocks.back();
+
+    ++block.count;
+    block.min_created_at = std::min(block.min_created_at, changeset.created_at());
+    block.max_closed_at = changeset.open() ? osmium::end_of_time() : std::max(block.max_closed_at, changeset.closed_at());
+
+    add_block_to(m_uid_blocks[changeset.uid()], block_num);
+
+    auto& uids = m_users[changeset.user()];
+    if (std::find(uids.cbegin(), uids.cend(), changeset.uid()) == uids.cend()) {
+        uids.push_back(changeset.uid());
+    }
+
+    const auto& bounds = changeset.bounds();
+    if (!bounds.valid()) {
+        return;
+    }
+
+    const int x1 = cell_x(bounds.bottom_left());
+    const int y1 = cell_y(bounds.bottom_left());
+    const int x2 = cell_x(bounds.top_right());
+    const int y2 = cell_y(bounds.top_right());
+
+    if (static_cast<std::size_t>(x2 - x1 + 1) * static_cast<std::size_t>(y2 - y1 + 1) > max_cells_per_changeset) {
+        m_large_boxes.emplace_back(block_num, bounds);
+        return;
+    }
+
+    for (int y = y1; y <= y2; ++y) {
+        for (int x = x1; x <= x2; ++x) {
+            add_block_to(m_grid[static_cast<std::size_t>(y) * grid_width + x], block_num);
+        }
+    }
+}
+
+std::string ChangesetIndex::tables(uint64_t input_size, int64_t input_mtime) const {
+    std::string out;
+
+    append(out, input_size);
+    append(out, input_mtime);
+
+    append(out, static_cast<uint64_t>(m_blocks.size()));
+    for (const auto& block : m_blocks) {
+        append(out, block.offset);
+        append(out, block.compressed_size);
+        append(out, block.size);
+        append(out, block.count);
+        append(out, block.min_created_at.seconds_since_epoch());
+        append(out, block.max_closed_at.seconds_since_epoch());
+    }
+
+    append(out, static_cast<uint64_t>(m_uid_blocks.size()));
+    for (const auto& uid_blocks : m_uid_blocks) {
+        append(out, uid_blocks.first);
+        append(out, uid_blocks.second);
+    }
+
+    append(out, static_cast<uint64_t>(m_users.size()));
+    for (const auto& user : m_users) {
+        append(out, static_cast<uint32_t>(user.first.size()));
+        out.append(user.first);
+        append(out, static_cast<uint32_t>(user.second.size()));
+        for (const auto uid : user.second) {
+            append(out, uid);
+        }
+    }
+
+    for (const auto& cell : m_grid) {
+        append(out, cell);
+    }
+
+    append(out, static_cast<uint64_t>(m_large_boxes.size()));
+    for (const auto& large_box : m_large_boxes) {
+        append(out, large_box.first);
+        append(out, large_box.second);
+    }
+
+    return out;
+}
+
+bool ChangesetIndex::open(const std::string& changeset_filename, const std::string& index_filename) {
+    m_filename = index_filename;
+    m_file.open(m_filename, std::ios::binary);
+    if (!m_file) {
+        return false;
+    }
+
+    std::string data(header_size, '\0');
+    if (!m_file.read(&data[0], static_cast<std::streamsize>(data.size())) || data != header()) {
+        throw broken_index(m_filename);
+    }
+
+    data.resize(footer_size);
+    m_file.seekg(-static_cast<std::streamoff>(footer_size), std::ios::end);
+    if (!m_file.read(&data[0], static_cast<std::streamsize>(data.size())) ||
+        std::memcmp(data.data() + 2 * sizeof(uint64_t), magic, sizeof(magic)) != 0) {
+        throw broken_index(m_filename);
+    }
+
+    uint64_t tables_offset = 0;
+    uint64_t tables_size = 0;
+    {
+        TableReader footer{data, m_filename};
+        tables_offset = footer.get<uint64_t>();
+        tables_size = footer.get<uint64_t>();
+    }
+
+    const auto index_size = osmium::file_size(m_filename);
+    if (tables_offset < header_size || tables_offset > index_size ||
+        tables_size > index_size - tables_offset ||
+        tables_offset + tables_size + footer_size > index_size) {
+        throw broken_index(m_filename);
+    }
+
+    data.resize(tables_size);
+    m_file.seekg(static_cast<std::streamoff>(tables_offset));
+    if (!m_file.read(&data[0], static_cast<std::streamsize>(data.size()))) {
+        throw broken_index(m_filename);
+    }
+
+    TableReader reader{data, m_filename};
+
+    if (reader.get<uint64_t>() != osmium::file_size(changeset_filename) ||
+        reader.get<int64_t>() != file_mtime(changeset_filename)) {
+        m_file.close();
+        return false;
+    }
+
+    m_blocks.resize(reader.get_count(4 * sizeof(uint64_t) + 2 * sizeof(uint32_t)));
+    for (auto& block : m_blocks) {
+        block.offset = reader.get<uint64_t>();
+        block.compressed_size = reader.get<uint64_t>();
+        if (block.offset < header_size || block.offset > tables_offset ||
+            block.compressed_size > tables_offset - block.offset) {
+            throw broken_index(m_filename);
+        }
+        block.size = reader.get<uint64_t>();
+        if (block.size > max_block_size ||
+            block.size > block.compressed_size * max_compression_ratio + 64) {
+            throw broken_index(m_filename);
+        }
+        block.count = reader.get<uint64_t>();
+        block.min_created_at = osmium::Timestamp{reader.get<uint32_t>()};
+        block.max_closed_at = osmium::Timestamp{reader.get<uint32_t>()};
+    }
+
+    const auto num_blocks = m_blocks.size();
+
+    for (auto n = reader.get_count(sizeof(osmium::user_id_type) + sizeof(uint32_t)); n > 0; --n) {
+        const auto uid = reader.get<osmium::user_id_type>();
+        m_uid_blocks[uid] = reader.get_blocks(num_blocks);
+    }
+
+    for (auto n = reader.get_count(2 * sizeof(uint32_t)); n > 0; --n) {
+        auto& uids = m_users[reader.get_string()];
+        const auto size = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < size; ++i) {
+            const auto uid = reader.get<osmium::user_id_type>();
+            if (m_uid_blocks.count(uid) == 0) {
+                throw broken_index(m_filename);
+            }
+            uids.push_back(uid);
+        }
+    }
+
+    for (auto& cell : m_grid) {
+        cell = reader.get_blocks(num_blocks);
+    }
+
+    m_large_boxes.resize(reader.get_count(sizeof(uint32_t) + 4 * sizeof(int32_t)));
+    for (auto& large_box : m_large_boxes) {
+        large_box.first = reader.get_block(num_blocks);
+        large_box.second = reader.get_box();
+    }
+
+    return true;
+}
+
+std::vector<uint32_t> ChangesetIndex::find_blocks(const ChangesetQuery& query) const {
+    std::vector<bool> selected(m_blocks.size(), true);
+
+    const auto restrict_to = [&selected](const std::vector<uint32_t>& blocks) {
+        std::vector<bool> in_list(selected.size(), false);
+        for (const auto block : blocks) {
+            in_list[block] = true;
+        }
+        for (std::size_t n = 0; n < selected.size(); ++n) {
+            selected[n] = selected[n] && in_list[n];
+        }
+    };
+
+    for (std::size_t n = 0; n < m_blocks.size(); ++n) {
+        if (m_blocks[n].max_closed_at < query.after || m_blocks[n].min_created_at > query.before) {
+            selected[n] = false;
+        }
+    }
+
+    if (query.uid != 0) {
+        const auto it = m_uid_blocks.find(query.uid);
+        restrict_to(it == m_uid_blocks.end() ? std::vector<uint32_t>{} : it->second);
+    }
+
+    if (!query.user.empty()) {
+        std::vector<uint32_t> blocks;
+        const auto it = m_users.find(query.user);
+        if (it != m_users.end()) {
+            for (const auto uid : it->second) {
+                const auto& uid_blocks = m_uid_blocks.at(uid);
+                blocks.insert(blocks.end(), uid_blocks.cbegin(), uid_blocks.cend());
+            }
+        }
+        restrict_to(blocks);
+    }
+
+    if (query.box.valid()) {
+        std::vector<uint32_t> blocks;
+        for (int y = cell_y(query.box.bottom_left()); y <= cell_y(query.box.top_right()); ++y) {
+            for (int x = cell_x(query.box.bottom_left()); x <= cell_x(query.box.top_right()); ++x) {
+                const auto& cell = m_grid[static_cast<std::size_t>(y) * grid_width + x];
+                blocks.insert(blocks.end(), cell.cbegin(), cell.cend());
+            }
+        }
+        for (const auto& large_box : m_large_boxes) {
+            if (osmium::geom::overlaps(large_box.second, query.box)) {
+                blocks.push_back(large_box.first);
+            }
+        }
+        restrict_to(blocks);
+    }
+
+    std::vector<uint32_t> result;
+    for (std::size_t n = 0; n < selected.size(); ++n) {
+        if (selected[n]) {
+            result.push_back(static_cast<uint32_t>(n));
+        }
+    }
+
+    return result;
+}
+
+std::string ChangesetIndex::read_block_data(uint32_t block) const {
+    const auto& b = m_blocks.at(block);
+    std::string data(b.compressed_size, '\0');
+
+    m_file.seekg(static_cast<std::streamoff>(b.offset));
+    if (!m_file.read(&data[0], static_cast<std::streamsize>(data.size()))) {
+        throw broken_index(m_filename);
+    }
+
+    return data;
+}
+
+osmium::memory::Buffer decode_changeset_block(const ChangesetBlock& block, const std::string& data) {
+    osmium::memory::Buffer buffer{block.size};
+    auto* const ptr = buffer.reserve_space(block.size);
+
+    uLongf size = static_cast<uLongf>(block.size);
+    if (::uncompress(ptr, &size, reinterpret_cast<const Bytef*>(data.data()), static_cast<uLong>(data.size())) != Z_OK || size != block.size) { // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+        throw std::runtime_error{"Uncompressing changeset index block failed."};
+    }
+
+    buffer.commit();
+    return buffer;
+}
+
+ChangesetIndexWriter::ChangesetIndexWriter(const std::string& index_filename, bool overwrite) :
+    m_buffer(initial_buffer_size, osmium::memory::Buffer::auto_grow::yes),
+    m_fd(osmium::io::detail::open_for_writing(index_filename, overwrite ? osmium::io::overwrite::allow : osmium::io::overwrite::no)) {
+    write(header());
+}
+
+void ChangesetIndexWriter::write(const std::string& data) {
+    osmium::io::detail::reliable_write(m_fd, data.data(), data.size());
+    m_offset += data.size();
+}
+
+void ChangesetIndexWriter::write_next_block() {
+    const auto data = m_pending.front().get();
+    m_pending.pop_front();
+
+    auto& block = m_index.block(m_next_block++);
+    block.offset = m_offset;
+    block.compressed_size = data.size();
+    write(data);
+}
+
+void ChangesetIndexWriter::flush_block() {
+    auto buffer = std::make_shared<osmium::memory::Buffer>(std::move(m_buffer));
+    m_buffer = osmium::memory::Buffer{initial_buffer_size, osmium::memory::Buffer::auto_grow::yes};
+
+    m_index.block(m_index.blocks().size() - 1).size = buffer->committed();
+
+    m_pending.push_back(osmium::thread::Pool::default_instance().submit([buffer]() {
+        return compress_buffer(*buffer);
+    }));
+
+    if (m_pending.size() >= max_pending_blocks) {
+        write_next_block();
+    }
+}
+
+void ChangesetIndexWriter::add(const osmium::Changeset& changeset) {
+    if (m_buffer.committed() == 0) {
+        m_index.add_block();
+    }
+
+    m_buffer.add_item(changeset);
+    m_buffer.commit();
+    m_index.add(changeset);
+
+    if (m_index.blocks().back().count == ChangesetIndex::changesets_per_block) {
+        flush_block();
+    }
+}
+
+std::size_t ChangesetIndexWriter::close(const std::string& changeset_filename) {
+    if (m_buffer.committed() > 0) {
+        flush_block();
+    }
+
+    while (!m_pending.empty()) {
+        write_next_block();
+    }
+
+    const auto tables_offset = m_offset;
+    const auto tables = m_index.tables(osmium::file_size(changeset_filename), file_mtime(changeset_filename));
+    write(tables);
+
+    std::string footer;
+    append(footer, tables_offset);
+    append(footer, static_cast<uint64_t>(tables.size()));
+    footer.append(magic, sizeof(magic));
+    write(footer);
+
+    osmium::io::detail::reliable_close(m_fd);
+
+    return m_index.blocks().size();
+}
@@ -0,0 +1,183 @@
+#ifndef CHANGESET_INDEX_HPP
+#define CHANGESET_INDEX_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/changeset.hpp>
+#include <osmium/osm/timestamp.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * A block of changesets in a changeset index file together with some
+ * information about the changesets in it.
+ */
+struct ChangesetBlock {
+
+    // Position and size of the compressed data in the index file.
+    uint64_t offset = 0;
+    uint64_t compressed_size = 0;
+
+    // Size of the uncompressed buffer data.
+    uint64_t size = 0;
+
+    uint64_t count = 0;
+
+    osmium::Timestamp min_created_at = osmium::end_of_time();
+
+    // This is end_of_time() if there are open changesets in the block.
+    osmium::Timestamp max_closed_at = osmium::start_of_time();
+
+}; // struct ChangesetBlock
+
+/**
+ * Criteria for finding changesets in the index. Only those criteria
+ * which can be used to rule out whole blocks are here.
+ */
+struct ChangesetQuery {
+    std::string user;
+    osmium::Box box;
+    osmium::Timestamp after = osmium::start_of_time();
+    osmium::Timestamp before = osmium::end_of_time();
+    osmium::user_id_type uid = 0;
+};
+
+/**
+ * A sidecar index for a changeset file. The index file contains copies
+ * of all changesets in compressed blocks followed by a table of blocks
+ * with their time ranges, a map from uids (and user names) to the blocks
+ * containing their changesets, and a grid of 1x1 degree cells with the
+ * blocks containing changesets overlapping each cell.
+ *
+ * The blocks contain the binary buffer contents, so the index can only
+ * be read on the kind of machine it was written on.
+ *
+ * By default the index file has the name of the changeset file with
+ * ".csidx" appended.
+ */
+class ChangesetIndex {
+
+public:
+
+    static constexpr const std::size_t changesets_per_block = 4096;
+
+    // Changesets covering more grid cells than this are stored in a
+    // separate list instead of the grid.
+    static constexpr const std::size_t max_cells_per_changeset = 256;
+
+private:
+
+    std::vector<ChangesetBlock> m_blocks;
+    std::map<osmium::user_id_type, std::vector<uint32_t>> m_uid_blocks;
+    std::map<std::string, std::vector<osmium::user_id_type>> m_users;
+    std::vector<std::vector<uint32_t>> m_grid;
+    std::vector<std::pair<uint32_t, osmium::Box>> m_large_boxes;
+
+    std::string m_filename;
+    mutable std::ifstream m_file;
+
+public:
+
+    ChangesetIndex();
+
+    const std::vector<ChangesetBlock>& blocks() const noexcept {
+        return m_blocks;
+    }
+
+    // Add information about a changeset in the current (last) block.
+    void add(const osmium::Changeset& changeset);
+
+    // Start a new block.
+    void add_block();
+
+    ChangesetBlock& block(std::size_t n) noexcept {
+        return m_blocks[n];
+    }
+
+    // Serialize the tables, the index file has to be written up to the
+    // end of the last block already.
+    std::string tables(uint64_t input_size, int64_t input_mtime) const;
+
+    /**
+     * Open the index file for the given changeset file. Returns false if
+     * the index doesn't exist or is out of date.
+     *
+     * @throws std::runtime_error If the index file is broken.
+     */
+    bool open(const std::string& changeset_filename, const std::string& index_filename);
+
+    // Numbers of the blocks which might contain changesets matching the
+    // query.
+    std::vector<uint32_t> find_blocks(const ChangesetQuery& query) const;
+
+    // Read the compressed data of a block from the index file.
+    std::string read_block_data(uint32_t block) const;
+
+}; // class ChangesetIndex
+
+// Uncompress the data of a block into a buffer. Can be called from any
+// thread.
+osmium::memory::Buffer decode_changeset_block(const ChangesetBlock& block, const std::string& data);
+
+/**
+ * Writes a changeset index. The blocks are compressed on the worker
+ * threads.
+ */
+class ChangesetIndexWriter {
+
+    ChangesetIndex m_index;
+    osmium::memory::Buffer m_buffer;
+    std::deque<std::future<std::string>> m_pending;
+    uint64_t m_offset = 0;
+    uint32_t m_next_block = 0;
+    int m_fd;
+
+    void write(const std::string& data);
+    void write_next_block();
+    void flush_block();
+
+public:
+
+    ChangesetIndexWriter(const std::string& index_filename, bool overwrite);
+
+    void add(const osmium::Changeset& changeset);
+
+    // Returns the number of blocks written.
+    std::size_t close(const std::string& changeset_filename);
+
+}; // class ChangesetIndexWriter
+
+std::string changeset_index_filename(const std::string& changeset_filename);
+
+#endif // CHANGESET_INDEX_HPP
@@ -25,13 +25,20 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "exception.hpp"
 
 #include <osmium/index/map.hpp>
+#include <osmium/io/reader.hpp>
+#include <osmium/io/writer.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/types.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/util/memory.hpp>
 #include <osmium/util/verbose_output.hpp>
 
+#include <cerrno>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <system_error>
 
 po::options_description Command::add_common_options(const bool with_progress) {
     po::options_description options{"COMMON OPTIONS"};
@@ -39,6 +46,9 @@ po::options_description Command::add_common_options(const bool with_progress) {
     auto opts = options.add_options()
     ("help,h", "Show usage help")
     ("verbose,v", "Set verbose mode")
+    ("stats", po::value<std::string>()->implicit_value("text"), "Show statistics about processing stages (text or json)")
+    ("metrics-file", po::value<std::string>(), "Write statistics about the run as JSON to this file")
+    ("threads", po::value<int>(), "Number of worker threads (default: number of CPUs)")
     ;
 
     if (with_progress) {
@@ -49,6 +59,22 @@ po::options_description Command::add_common_options(const bool with_progress) {
     return options;
 }
 
+void Command::set_pool_threads(int threads) {
+    if (threads < 1 || threads > osmium::thread::detail::max_pool_threads) {
+        throw argument_error{"Value for --threads must be between 1 and " + std::to_string(osmium::thread::detail::max_pool_threads) + "."};
+    }
+
+    // The pool is created on first use and sized from this environment
+    // variable, so this has to happen before any reader, writer or
+    // parallel processing stage is set up.
+    const auto value = std::to_string(threads);
+#ifdef _WIN32
+    _putenv_s("OSMIUM_POOL_THREADS", value.c_str());
+#else
+    setenv("OSMIUM_POOL_THREADS", value.c_str(), 1);
+#endif
+}
+
 bool Command::setup_common(const boost::program_options::variables_map& vm, const po::options_description& desc) {
     if (vm.count("help")) {
         std::cout << "Usage: " << synopsis() << "\n\n"
@@ -62,6 +88,30 @@ bool Command::setup_common(const boost::program_options::variables_map& vm, cons
         m_vout.verbose(true);
     }
 
+    if (vm.count("stats")) {
+        const auto& format = vm["stats"].as<std::string>();
+        if (format == "text") {
+            m_stats_format = stats_format_type::text;
+        } else if (format == "json") {
+            m_stats_format = stats_format_type::json;
+        } else {
+            throw argument_error{"Unknown format for --stats option '" + format + "' (Allowed are 'text' and 'json')."};
+        }
+    }
+
+    if (vm.count("metrics-file")) {
+        m_metrics_filename = vm["metrics-file"].as<std::string>();
+        if (m_metrics_filename.empty()) {
+            throw argument_error{"Missing file name for --metrics-file option."};
+        }
+    }
+
+    if (vm.count("threads")) {
+        set_pool_threads(vm["threads"].as<int>());
+    }
+
+    m_run_stats.set_command(name());
+
     return true;
 }
 
@@ -155,6 +205,79 @@ void Command::show_memory_used() {
     }
 }
 
+osmium::memory::Buffer Command::read_buffer(osmium::io::Reader& reader) {
+    auto& read_stage = stage("read");
+    const auto offset = reader.offset();
+
+    osmium::memory::Buffer buffer;
+    {
+        const StageTimer timer{read_stage};
+        buffer = reader.read();
+    }
+
+    read_stage.bytes_in += reader.offset() - offset;
+    if (buffer && collect_stats()) {
+        read_stage.bytes_out += buffer.committed();
+        read_stage.add_buffer(buffer);
+    }
+
+    return buffer;
+}
+
+void Command::write_buffer(osmium::io::Writer& writer, osmium::memory::Buffer&& buffer) {
+    auto& write_stage = stage("write");
+
+    if (collect_stats()) {
+        write_stage.bytes_in += buffer.committed();
+        write_stage.add_buffer(buffer);
+    }
+
+    const StageTimer timer{write_stage};
+    writer(std::move(buffer));
+}
+
+std::size_t Command::close_writer(osmium::io::Writer& writer) {
+    auto& write_stage = stage("write");
+    std::size_t bytes_written = 0;
+    {
+        const StageTimer timer{write_stage};
+        bytes_written = writer.close();
+    }
+    write_stage.bytes_out += bytes_written;
+    return bytes_written;
+}
+
+void Command::show_stats() const {
+    switch (m_stats_format) {
+        case stats_format_type::text:
+            m_run_stats.print(std::cerr);
+            break;
+        case stats_format_type::json:
+            m_run_stats.print_json(std::cerr);
+            break;
+        default:
+            break;
+    }
+}
+
+void Command::write_metrics() const {
+    if (m_metrics_filename.empty()) {
+        return;
+    }
+
+    std::ofstream out{m_metrics_filename};
+    if (!out) {
+        throw std::system_error{errno, std::system_category(), "Could not open metrics file '" + m_metrics_filename + "'"};
+    }
+
+    m_run_stats.print_json(out);
+
+    out.close();
+    if (!out) {
+        throw std::system_error{errno, std::system_category(), "Could not write metrics file '" + m_metrics_filename + "'"};
+    }
+}
+
 std::string check_index_type(const std::string& index_type_name, bool allow_none) {
     if (allow_none && index_type_name == "none") {
         return index_type_name;
@@ -23,11 +23,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 */
 
+#include "file_stats.hpp"
 #include "option_clean.hpp"
+#include "stage_stats.hpp"
 
 #include <osmium/io/file.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/io/writer_options.hpp>
+#include <osmium/memory/buffer.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/util/file.hpp>
 #include <osmium/util/verbose_output.hpp>
@@ -48,6 +51,13 @@ const char* get_libosmium_version() noexcept;
 
 class CommandFactory;
 
+namespace osmium {
+    namespace io {
+        class Reader;
+        class Writer;
+    } // namespace io
+} // namespace osmium
+
 namespace po = boost::program_options;
 
 /**
@@ -63,6 +73,20 @@ class Command {
         always = 2
     } m_display_progress = display_progress_type::on_tty;
 
+    enum class stats_format_type {
+        none = 0,
+        text = 1,
+        json = 2
+    } m_stats_format = stats_format_type::none;
+
+    RunStats m_run_stats;
+
+    std::string m_metrics_filename;
+
+    // Set the number of threads in the thread pool shared by the readers,
+    // writers and parallel processing stages of the command.
+    static void set_pool_threads(int threads);
+
 protected:
 
     const CommandFactory& m_command_factory;
@@ -118,6 +142,43 @@ public:
     void print_arguments(const std::string& command);
     void show_memory_used();
 
+    // Get statistics for the named processing stage. Shown at the end
+    // if the --stats option is set and written to the metrics file if
+    // the --metrics-file option is set.
+    StageStats& stage(const char* name) {
+        return m_run_stats.stage(name);
+    }
+
+    RunStats& run_stats() noexcept {
+        return m_run_stats;
+    }
+
+    // Are statistics needed, because of the --stats or --metrics-file
+    // options? Counting objects costs some time, so this should be
+    // checked before doing that.
+    bool collect_stats() const noexcept {
+        return m_stats_format != stats_format_type::none || !m_metrics_filename.empty();
+    }
+
+    // Record memory used by an index for the statistics.
+    void add_index_memory(const char* name, std::size_t memory) {
+        m_run_stats.add_index(name, memory);
+    }
+
+    // Read a buffer from the reader, accounting for it in the "read" stage.
+    osmium::memory::Buffer read_buffer(osmium::io::Reader& reader);
+
+    // Write a buffer to the writer, accounting for it in the "write" stage.
+    void write_buffer(osmium::io::Writer& writer, osmium::memory::Buffer&& buffer);
+
+    // Close the writer, accounting for it in the "write" stage.
+    std::size_t close_writer(osmium::io::Writer& writer);
+
+    void show_stats() const;
+
+    // Write statistics to the file set with the --metrics-file option.
+    void write_metrics() const;
+
     osmium::osm_entity_bits::type osm_entity_bits() const {
         return m_osm_entity_bits;
     }
@@ -234,6 +295,9 @@ protected:
     osmium::io::File m_output_file;
     osmium::io::overwrite m_output_overwrite = osmium::io::overwrite::no;
     osmium::io::fsync m_fsync = osmium::io::fsync::no;
+    bool m_write_stats = false;
+    bool m_write_index = false;
+    FileStats m_output_stats;
 
 public:
 
@@ -262,6 +326,21 @@ public:
         return m_output_overwrite;
     }
 
+    // Only commands which call update_output_stats() for all data they
+    // write and write_output_stats() after closing the writer should
+    // offer the --write-stats option.
+    void update_output_stats(osmium::memory::Buffer& buffer) {
+        if (m_write_stats) {
+            m_output_stats.update(buffer);
+        }
+    }
+
+    void write_output_stats() const;
+
+    // Only commands which call write_output_index() after closing the
+    // writer should offer the --write-index option.
+    void write_output_index() const;
+
 }; // class with_osm_output
 
 
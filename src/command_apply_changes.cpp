@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "command_apply_changes.hpp"
 
+#include "buffer_compactor.hpp"
 #include "exception.hpp"
 #include "util.hpp"
 
@@ -278,6 +279,11 @@ bool CommandApplyChanges::run() {
     std::vector<osmium::memory::Buffer> changes;
     osmium::ObjectPointerCollection objects;
 
+    BufferCompactor compactor{[&](osmium::memory::Buffer&& buffer) {
+        osmium::apply(buffer, objects);
+        changes.push_back(std::move(buffer));
+    }};
+
     m_vout << "Reading change file contents...\n";
 
     for (const std::string& change_file_name : m_change_filenames) {
@@ -288,11 +294,11 @@ bool CommandApplyChanges::run() {
         const osmium::io::File file{change_file_name, m_change_file_format};
         osmium::io::Reader reader{file, osmium::osm_entity_bits::object};
         while (osmium::memory::Buffer buffer = reader.read()) {
-            osmium::apply(buffer, objects);
-            changes.push_back(std::move(buffer));
+            compactor.add(std::move(buffer));
         }
         reader.close();
     }
+    compactor.flush();
 
     m_vout << "Opening input file...\n";
     osmium::io::ReaderWithProgressBar reader{display_progress(), m_input_file, osmium::osm_entity_bits::object};
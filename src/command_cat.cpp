@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "command_cat.hpp"
 
+#include "buffer_compactor.hpp"
 #include "exception.hpp"
 #include "util.hpp"
 
@@ -45,6 +46,8 @@ bool CommandCat::setup(const std::vector<std::string>& arguments) {
     ("object-type,t", po::value<std::vector<std::string>>(), "Read only objects of given type (node, way, relation, changeset)")
     ("clean,c", po::value<std::vector<std::string>>(), "Clean attribute (version, changeset, timestamp, uid, user)")
     ("buffer-data", "Buffer all data in memory before writing it out")
+    ("write-stats", "Write statistics to sidecar file (OUTPUT-FILE.stats)")
+    ("write-index", "Write block index to sidecar file (OUTPUT-FILE.idx)")
     ;
 
     const po::options_description opts_common{add_common_options()};
@@ -78,6 +81,7 @@ bool CommandCat::setup(const std::vector<std::string>& arguments) {
     setup_output_file(vm);
 
     m_clean.setup(vm);
+    m_clean.apply_to(m_output_file);
 
     if (vm.count("buffer-data")) {
         m_buffer_data = true;
@@ -95,28 +99,41 @@ void CommandCat::show_arguments() {
     m_vout << "    attributes to clean: " << m_clean.to_string() << '\n';
 }
 
-void CommandCat::copy(osmium::ProgressBar& progress_bar, osmium::io::Reader& reader, osmium::io::Writer& writer) const {
-    while (osmium::memory::Buffer buffer = reader.read()) {
+void CommandCat::copy(osmium::ProgressBar& progress_bar, osmium::io::Reader& reader, osmium::io::Writer& writer) {
+    while (osmium::memory::Buffer buffer = read_buffer(reader)) {
         progress_bar.update(reader.offset());
 
-        m_clean.apply_to(buffer);
+        if (m_write_stats) {
+            // The statistics have to match the data written out.
+            m_clean.apply_to(buffer);
+            update_output_stats(buffer);
+        }
 
-        writer(std::move(buffer));
+        write_buffer(writer, std::move(buffer));
     }
 }
 
 std::size_t CommandCat::read_buffers(osmium::ProgressBar& progress_bar, osmium::io::Reader& reader, std::vector<osmium::memory::Buffer>& buffers) {
     std::size_t size = 0;
 
-    while (osmium::memory::Buffer buffer = reader.read()) {
+    BufferCompactor compactor{[&](osmium::memory::Buffer&& buffer) {
+        buffers.emplace_back(std::move(buffer));
+    }};
+
+    while (osmium::memory::Buffer buffer = read_buffer(reader)) {
         progress_bar.update(reader.offset());
 
-        m_clean.apply_to(buffer);
+        if (m_write_stats) {
+            // The statistics have to match the data written out.
+            m_clean.apply_to(buffer);
+            update_output_stats(buffer);
+        }
 
         size += buffer.committed();
 
-        buffers.emplace_back(std::move(buffer));
+        compactor.add(std::move(buffer));
     }
+    compactor.flush();
 
     return size;
 }
@@ -126,7 +143,7 @@ void CommandCat::write_buffers(osmium::ProgressBar& progress_bar, std::vector<os
 
     for (auto&& buffer : buffers) {
         size += buffer.committed();
-        writer(std::move(buffer));
+        write_buffer(writer, std::move(buffer));
         progress_bar.update(size);
     }
 }
@@ -176,7 +193,7 @@ bool CommandCat::run() {
             copy(progress_bar, reader, writer);
             progress_bar.done();
         }
-        bytes_written = writer.close();
+        bytes_written = close_writer(writer);
         reader.close();
     } else { // multiple input files
         osmium::io::Header header;
@@ -201,7 +218,7 @@ bool CommandCat::run() {
             m_vout << "Writing data...\n";
             osmium::ProgressBar progress_bar_writer{size, display_progress()};
             write_buffers(progress_bar_writer, buffers, writer);
-            bytes_written = writer.close();
+            bytes_written = close_writer(writer);
             progress_bar_writer.done();
         } else {
             osmium::ProgressBar progress_bar{file_size_sum(m_input_files), display_progress()};
@@ -213,11 +230,14 @@ bool CommandCat::run() {
                 progress_bar.file_done(reader.file_size());
                 reader.close();
             }
-            bytes_written = writer.close();
+            bytes_written = close_writer(writer);
             progress_bar.done();
         }
     }
 
+    write_output_stats();
+    write_output_index();
+
     if (bytes_written > 0) {
         m_vout << "Wrote " << bytes_written << " bytes.\n";
     }
@@ -36,7 +36,7 @@ class CommandCat : public CommandWithMultipleOSMInputs, public with_osm_output {
 
     bool m_buffer_data = false;
 
-    void copy(osmium::ProgressBar& progress_bar, osmium::io::Reader& reader, osmium::io::Writer& writer) const;
+    void copy(osmium::ProgressBar& progress_bar, osmium::io::Reader& reader, osmium::io::Writer& writer);
 
     std::size_t read_buffers(osmium::ProgressBar& progress_bar, osmium::io::Reader& reader, std::vector<osmium::memory::Buffer>& buffers);
 
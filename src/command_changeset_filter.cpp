@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "command_changeset_filter.hpp"
 
+#include "changeset_index.hpp"
 #include "exception.hpp"
 #include "util.hpp"
 
@@ -31,16 +32,21 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/io/output_iterator.hpp>
 #include <osmium/io/reader.hpp>
 #include <osmium/io/writer.hpp>
+#include <osmium/memory/buffer.hpp>
 #include <osmium/osm/changeset.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/timestamp.hpp>
 #include <osmium/osm/types.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/util/progress_bar.hpp>
 #include <osmium/util/verbose_output.hpp>
 
 #include <boost/program_options.hpp>
 
 #include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <future>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -59,6 +65,7 @@ bool CommandChangesetFilter::setup(const std::vector<std::string>& arguments) {
     ("after,a", po::value<std::string>(), "Changesets opened after this time")
     ("before,b", po::value<std::string>(), "Changesets closed before this time")
     ("bbox,B", po::value<std::string>(), "Changesets overlapping this bounding box")
+    ("index", po::value<std::string>()->implicit_value(""), "Use changeset index created with 'osmium changeset-index'")
     ;
 
     const po::options_description opts_common{add_common_options()};
@@ -144,6 +151,16 @@ bool CommandChangesetFilter::setup(const std::vector<std::string>& arguments) {
         m_box = parse_bbox(vm["bbox"].as<std::string>(), "--bbox/-B");
     }
 
+    if (vm.count("index")) {
+        if (m_input_filename.empty() || m_input_filename == "-") {
+            throw argument_error{"Can not use --index when reading from STDIN."};
+        }
+        m_index_filename = vm["index"].as<std::string>();
+        if (m_index_filename.empty()) {
+            m_index_filename = changeset_index_filename(m_input_filename);
+        }
+    }
+
     if (m_with_discussion && m_without_discussion) {
         throw argument_error{"You can not use --with-discussion/-d and --without-discussion/-D together."};
     }
@@ -198,8 +215,19 @@ void CommandChangesetFilter::show_arguments() {
     if (m_before < osmium::end_of_time()) {
         m_vout << "      - be created before " << m_before.to_iso() << "\n";
     }
+    if (!m_index_filename.empty()) {
+        m_vout << "    index file: " << m_index_filename << "\n";
+    }
 }
 
+namespace {
+
+    // Maximum number of index blocks handed to the worker threads which
+    // haven't been written out yet.
+    constexpr const std::size_t max_pending_blocks = 20;
+
+} // anonymous namespace
+
 bool changeset_after(const osmium::Changeset& changeset, osmium::Timestamp time) {
     return changeset.open() || changeset.closed_at() >= time;
 }
@@ -208,7 +236,92 @@ bool changeset_before(const osmium::Changeset& changeset, osmium::Timestamp time
     return changeset.created_at() <= time;
 }
 
+bool CommandChangesetFilter::matches(const osmium::Changeset& changeset) const {
+    return (!m_with_discussion    || changeset.num_comments() > 0) &&
+           (!m_without_discussion || changeset.num_comments() == 0) &&
+           (!m_with_changes       || changeset.num_changes() > 0) &&
+           (!m_without_changes    || changeset.num_changes() == 0) &&
+           (!m_open               || changeset.open()) &&
+           (!m_closed             || changeset.closed()) &&
+           (m_uid == 0            || changeset.uid() == m_uid) &&
+           (m_user.empty()        || m_user == changeset.user()) &&
+           changeset_after(changeset, m_after) &&
+           changeset_before(changeset, m_before) &&
+           (!m_box.valid()        || (changeset.bounds().valid() && osmium::geom::overlaps(changeset.bounds(), m_box)));
+}
+
+void CommandChangesetFilter::run_with_index() {
+    ChangesetIndex index;
+    if (!index.open(m_input_filename, m_index_filename)) {
+        throw argument_error{"Changeset index '" + m_index_filename +
+                             "' is missing or out of date. Create it with 'osmium changeset-index'."};
+    }
+
+    ChangesetQuery query;
+    query.user = m_user;
+    query.box = m_box;
+    query.after = m_after;
+    query.before = m_before;
+    query.uid = m_uid;
+
+    const auto blocks = index.find_blocks(query);
+    m_vout << "Reading " << blocks.size() << " of " << index.blocks().size() << " blocks from index...\n";
+
+    // Only the header is read from the input file.
+    osmium::io::Reader reader{m_input_file, osmium::osm_entity_bits::nothing};
+    osmium::io::Header header{reader.header()};
+    setup_header(header);
+    reader.close();
+
+    m_vout << "Opening output file...\n";
+    osmium::io::Writer writer{m_output_file, header, m_output_overwrite, m_fsync};
+
+    m_vout << "Filtering data...\n";
+    osmium::ProgressBar progress_bar{blocks.size(), display_progress()};
+
+    auto& pool = osmium::thread::Pool::default_instance();
+    std::deque<std::future<osmium::memory::Buffer>> pending;
+
+    const auto write_next_result = [&]() {
+        writer(pending.front().get());
+        pending.pop_front();
+    };
+
+    std::size_t count = 0;
+    for (const auto block_num : blocks) {
+        pending.push_back(pool.submit([this, block = index.blocks()[block_num], data = index.read_block_data(block_num)]() {
+            auto input = decode_changeset_block(block, data);
+            osmium::memory::Buffer output{input.committed(), osmium::memory::Buffer::auto_grow::yes};
+            for (const auto& changeset : input.select<osmium::Changeset>()) {
+                if (matches(changeset)) {
+                    output.add_item(changeset);
+                    output.commit();
+                }
+            }
+            return output;
+        }));
+        if (pending.size() >= max_pending_blocks) {
+            write_next_result();
+        }
+        progress_bar.update(++count);
+    }
+
+    while (!pending.empty()) {
+        write_next_result();
+    }
+    progress_bar.done();
+
+    writer.close();
+}
+
 bool CommandChangesetFilter::run() {
+    if (!m_index_filename.empty()) {
+        run_with_index();
+        show_memory_used();
+        m_vout << "Done.\n";
+        return true;
+    }
+
     m_vout << "Opening input file...\n";
     osmium::io::Reader reader{m_input_file, osmium::osm_entity_bits::changeset};
 
@@ -232,18 +345,7 @@ bool CommandChangesetFilter::run() {
                 progress_bar.update(reader.offset());
                 count = 0;
             }
-            return (!m_with_discussion    || changeset.num_comments() > 0) &&
-                   (!m_without_discussion || changeset.num_comments() == 0) &&
-                   (!m_with_changes       || changeset.num_changes() > 0) &&
-                   (!m_without_changes    || changeset.num_changes() == 0) &&
-                   (!m_open               || changeset.open()) &&
-                   (!m_closed             || changeset.closed()) &&
-                   (m_uid == 0            || changeset.uid() == m_uid) &&
-                   (m_user.empty()        || m_user == changeset.user()) &&
-                   changeset_after(changeset, m_after) &&
-                   changeset_before(changeset, m_before) &&
-                   (!m_box.valid()        || (changeset.bounds().valid() && osmium::geom::overlaps(changeset.bounds(), m_box)));
-
+            return matches(changeset);
     });
 
     progress_bar.done();
@@ -26,6 +26,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "cmd.hpp" // IWYU pragma: export
 
 #include <osmium/osm/box.hpp>
+#include <osmium/osm/changeset.hpp>
 #include <osmium/osm/timestamp.hpp>
 #include <osmium/osm/types.hpp>
 
@@ -35,6 +36,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 class CommandChangesetFilter : public CommandWithSingleOSMInput, public with_osm_output {
 
     std::string m_user;
+    std::string m_index_filename;
     osmium::Box m_box;
     osmium::Timestamp m_after = osmium::start_of_time();
     osmium::Timestamp m_before = osmium::end_of_time();
@@ -47,6 +49,10 @@ class CommandChangesetFilter : public CommandWithSingleOSMInput, public with_osm
     bool m_open = false;
     bool m_closed = false;
 
+    bool matches(const osmium::Changeset& changeset) const;
+
+    void run_with_index();
+
 public:
 
     explicit CommandChangesetFilter(const CommandFactory& command_factory) :
@@ -0,0 +1,123 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "command_changeset_index.hpp"
+
+#include "changeset_index.hpp"
+#include "exception.hpp"
+#include "util.hpp"
+
+#include <osmium/io/reader.hpp>
+#include <osmium/osm/changeset.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/util/progress_bar.hpp>
+#include <osmium/util/verbose_output.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <vector>
+
+bool CommandChangesetIndex::setup(const std::vector<std::string>& arguments) {
+    po::options_description opts_cmd{"COMMAND OPTIONS"};
+    opts_cmd.add_options()
+    ("output,o", po::value<std::string>(), "Index file (default: input file name with .csidx appended)")
+    ("overwrite,O", "Allow existing index file to be overwritten")
+    ;
+
+    const po::options_description opts_common{add_common_options()};
+    const po::options_description opts_input{add_single_input_options()};
+
+    po::options_description hidden;
+    hidden.add_options()
+    ("input-filename", po::value<std::string>(), "OSM changeset file")
+    ;
+
+    po::options_description desc;
+    desc.add(opts_cmd).add(opts_common).add(opts_input);
+
+    po::options_description parsed_options;
+    parsed_options.add(desc).add(hidden);
+
+    po::positional_options_description positional;
+    positional.add("input-filename", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(arguments).options(parsed_options).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (!setup_common(vm, desc)) {
+        return false;
+    }
+    setup_progress(vm);
+    setup_input_file(vm);
+
+    if (m_input_filename.empty() || m_input_filename == "-") {
+        throw argument_error{"Can not create index for data read from STDIN."};
+    }
+
+    m_index_filename = changeset_index_filename(m_input_filename);
+    if (vm.count("output")) {
+        m_index_filename = vm["output"].as<std::string>();
+    }
+
+    if (vm.count("overwrite")) {
+        m_overwrite = true;
+    }
+
+    return true;
+}
+
+void CommandChangesetIndex::show_arguments() {
+    show_single_input_arguments(m_vout);
+    m_vout << "  other options:\n";
+    m_vout << "    index file: " << m_index_filename << "\n";
+    m_vout << "    overwrite: " << yes_no(m_overwrite);
+}
+
+bool CommandChangesetIndex::run() {
+    m_vout << "Opening input file...\n";
+    osmium::io::Reader reader{m_input_file, osmium::osm_entity_bits::changeset};
+
+    m_vout << "Opening index file...\n";
+    ChangesetIndexWriter writer{m_index_filename, m_overwrite};
+
+    m_vout << "Creating index...\n";
+    osmium::ProgressBar progress_bar{reader.file_size(), display_progress()};
+    while (osmium::memory::Buffer buffer = reader.read()) {
+        progress_bar.update(reader.offset());
+        for (const auto& changeset : buffer.select<osmium::Changeset>()) {
+            writer.add(changeset);
+        }
+    }
+    progress_bar.done();
+
+    reader.close();
+
+    const auto num_blocks = writer.close(m_input_filename);
+    m_vout << "Wrote " << num_blocks << " blocks to index file.\n";
+
+    show_memory_used();
+    m_vout << "Done.\n";
+
+    return true;
+}
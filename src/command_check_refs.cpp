@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "command_check_refs.hpp"
 
+#include "external_sort.hpp"
 #include "util.hpp"
 
 #include <osmium/handler.hpp>
@@ -29,7 +30,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/index/id_set.hpp>
 #include <osmium/index/nwr_array.hpp>
 #include <osmium/io/reader.hpp>
+#include <osmium/memory/buffer.hpp>
 #include <osmium/osm.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/util/progress_bar.hpp>
 #include <osmium/util/verbose_output.hpp>
 #include <osmium/visitor.hpp>
@@ -38,8 +41,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
@@ -96,12 +104,32 @@ void CommandCheckRefs::show_arguments() {
     m_vout << "    check relations: " << yes_no(m_check_relations);
 }
 
+namespace {
+
+    // Maximum number of relation references kept in memory before they
+    // are written to a temporary file.
+    constexpr const std::size_t max_relation_refs_in_memory = 16UL * 1024UL * 1024UL;
+
+    // Maximum number of way buffers handed to the worker threads which
+    // haven't been checked yet.
+    constexpr const std::size_t max_pending_buffers = 20;
+
+} // anonymous namespace
+
+/**
+ * Result of checking the node references of all ways in a buffer.
+ */
+struct WayCheckResult {
+    uint64_t missing_nodes = 0;
+    std::string ids;
+};
+
 class RefCheckHandler : public osmium::handler::Handler {
 
     osmium::nwr_array<osmium::index::IdSetDense<osmium::unsigned_object_id_type>> m_idset_pos;
     osmium::nwr_array<osmium::index::IdSetDense<osmium::unsigned_object_id_type>> m_idset_neg;
 
-    std::vector<std::pair<osmium::object_id_type, osmium::object_id_type>> m_relation_refs;
+    ExternalIdPairs m_relation_refs{max_relation_refs_in_memory};
 
     osmium::handler::CheckOrder m_check_order;
 
@@ -112,6 +140,7 @@ class RefCheckHandler : public osmium::handler::Handler {
     uint64_t m_missing_nodes_in_ways = 0;
     uint64_t m_missing_nodes_in_relations = 0;
     uint64_t m_missing_ways_in_relations = 0;
+    uint64_t m_missing_relations_in_relations = 0;
 
     osmium::VerboseOutput* m_vout;
     osmium::ProgressBar* m_progress_bar;
@@ -162,18 +191,53 @@ public:
     }
 
     uint64_t missing_relations_in_relations() const noexcept {
-        return m_relation_refs.size();
+        return m_missing_relations_in_relations;
+    }
+
+    uint64_t relation_refs_on_disk() const noexcept {
+        return m_relation_refs.used_disk();
     }
 
     void find_missing_relations() {
-        std::sort(m_relation_refs.begin(), m_relation_refs.end());
-
-        m_relation_refs.erase(
-            std::remove_if(m_relation_refs.begin(), m_relation_refs.end(), [this](std::pair<osmium::object_id_type, osmium::object_id_type> refs){
-                return get(osmium::item_type::relation, refs.first);
-            }),
-            m_relation_refs.end()
-        );
+        m_relation_refs.for_each_sorted([this](const ExternalIdPairs::value_type& refs){
+            if (!get(osmium::item_type::relation, refs.first)) {
+                ++m_missing_relations_in_relations;
+                if (m_show_ids) {
+                    std::cout << "r" << refs.first << " in r" << refs.second << "\n";
+                }
+            }
+        });
+    }
+
+    void add(const WayCheckResult& result) {
+        m_missing_nodes_in_ways += result.missing_nodes;
+        if (m_show_ids) {
+            std::cout << result.ids;
+        }
+    }
+
+    /**
+     * Check the node references of all ways in the buffer. This only
+     * reads the node index, so it can run on several threads at the
+     * same time once all nodes have been read.
+     */
+    WayCheckResult check_way_nodes(const osmium::memory::Buffer& buffer) const {
+        WayCheckResult result;
+        std::ostringstream ids;
+
+        for (const auto& way : buffer.select<osmium::Way>()) {
+            for (const auto& node_ref : way.nodes()) {
+                if (!get(osmium::item_type::node, node_ref.ref())) {
+                    ++result.missing_nodes;
+                    if (m_show_ids) {
+                        ids << "n" << node_ref.ref() << " in w" << way.id() << "\n";
+                    }
+                }
+            }
+        }
+
+        result.ids = ids.str();
+        return result;
     }
 
     bool no_errors() const noexcept {
@@ -207,15 +271,6 @@ public:
         if (m_check_relations) {
             set(osmium::item_type::way, way.id());
         }
-
-        for (const auto& node_ref : way.nodes()) {
-            if (!get(osmium::item_type::node, node_ref.ref())) {
-                ++m_missing_nodes_in_ways;
-                if (m_show_ids) {
-                    std::cout << "n" << node_ref.ref() << " in w" << way.id() << "\n";
-                }
-            }
-        }
     }
 
     void relation(const osmium::Relation& relation) {
@@ -251,7 +306,7 @@ public:
                         break;
                     case osmium::item_type::relation:
                         if (member.ref() > relation.id() || !get(osmium::item_type::relation, member.ref())) {
-                            m_relation_refs.emplace_back(member.ref(), relation.id());
+                            m_relation_refs.push_back(std::make_pair(member.ref(), relation.id()));
                         }
                         break;
                     default:
@@ -261,12 +316,6 @@ public:
         }
     }
 
-    void show_missing_relation_ids() {
-        for (const auto& refs : m_relation_refs) {
-            std::cout << "r" << refs.first << " in r" << refs.second << "\n";
-        }
-    }
-
     std::size_t used_memory() const noexcept {
         return m_idset_pos(osmium::item_type::node).used_memory() +
                m_idset_pos(osmium::item_type::way).used_memory() +
@@ -274,19 +323,80 @@ public:
                m_idset_neg(osmium::item_type::node).used_memory() +
                m_idset_neg(osmium::item_type::way).used_memory() +
                m_idset_neg(osmium::item_type::relation).used_memory() +
-               m_relation_refs.capacity() * sizeof(decltype(m_relation_refs)::value_type);
+               m_relation_refs.used_memory();
     }
 
 }; // class RefCheckHandler
 
+static bool has_relations(const osmium::memory::Buffer& buffer) {
+    return std::any_of(buffer.cbegin(), buffer.cend(), [](const osmium::OSMEntity& entity) {
+        return entity.type() == osmium::item_type::relation;
+    });
+}
+
 bool CommandCheckRefs::run() {
     osmium::io::Reader reader{m_input_file};
     osmium::ProgressBar progress_bar{reader.file_size(), display_progress()};
     RefCheckHandler handler{&m_vout, &progress_bar, m_show_ids, m_check_relations};
 
-    while (osmium::memory::Buffer buffer = reader.read()) {
-        progress_bar.update(reader.offset());
-        osmium::apply(buffer, handler);
+    // The node references in ways are checked on the worker threads. This
+    // is only possible because the node index doesn't change any more once
+    // the first way has been seen. Relations can add to the node index,
+    // so all pending checks are done before the first relation.
+    auto& pool = osmium::thread::Pool::default_instance();
+    std::deque<std::future<WayCheckResult>> pending;
+
+    const auto add_next_result = [&]() {
+        handler.add(pending.front().get());
+        pending.pop_front();
+    };
+
+    try {
+        while (true) {
+            auto buffer = std::make_shared<osmium::memory::Buffer>(reader.read());
+            if (!*buffer) {
+                break;
+            }
+            progress_bar.update(reader.offset());
+
+            if (has_relations(*buffer)) {
+                while (!pending.empty()) {
+                    add_next_result();
+                }
+                // The nodes in this buffer must be in the index before the
+                // ways are checked, the relations only afterwards.
+                bool ways_checked = false;
+                for (auto& entity : *buffer) {
+                    if (!ways_checked && entity.type() == osmium::item_type::relation) {
+                        handler.add(handler.check_way_nodes(*buffer));
+                        ways_checked = true;
+                    }
+                    osmium::apply_item(entity, handler);
+                }
+                continue;
+            }
+
+            const auto way_count = handler.way_count();
+            osmium::apply(*buffer, handler);
+            if (handler.way_count() != way_count) {
+                pending.push_back(pool.submit([&handler, buffer]() {
+                    return handler.check_way_nodes(*buffer);
+                }));
+                if (pending.size() >= max_pending_buffers) {
+                    add_next_result();
+                }
+            }
+        }
+
+        while (!pending.empty()) {
+            add_next_result();
+        }
+    } catch (...) {
+        // Worker threads must be done with the handler before it goes away.
+        for (auto& future : pending) {
+            future.wait();
+        }
+        throw;
     }
     progress_bar.done();
 
@@ -294,10 +404,6 @@ bool CommandCheckRefs::run() {
 
     if (m_check_relations) {
         handler.find_missing_relations();
-
-        if (m_show_ids) {
-            handler.show_missing_relation_ids();
-        }
     }
 
     std::cerr << "There are " << handler.node_count() << " nodes, "
@@ -313,7 +419,11 @@ bool CommandCheckRefs::run() {
         std::cerr << "Nodes in ways missing: " << handler.missing_nodes_in_ways() << "\n";
     }
 
+    add_index_memory("id sets", handler.used_memory());
     m_vout << "Memory used for indexes: " << show_mbytes(handler.used_memory()) << " MBytes\n";
+    if (handler.relation_refs_on_disk() > 0) {
+        m_vout << "Temporary disk space used for relation references: " << show_mbytes(static_cast<std::size_t>(handler.relation_refs_on_disk())) << " MBytes\n";
+    }
 
     show_memory_used();
     m_vout << "Done.\n";
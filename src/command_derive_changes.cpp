@@ -29,18 +29,24 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/io/file.hpp>
 #include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
-#include <osmium/io/input_iterator.hpp>
 #include <osmium/io/reader.hpp>
-#include <osmium/io/reader_with_progress_bar.hpp>
 #include <osmium/io/writer.hpp>
+#include <osmium/memory/buffer.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/object.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/util/progress_bar.hpp>
 #include <osmium/util/verbose_output.hpp>
 
 #include <boost/program_options.hpp>
 
+#include <cstddef>
+#include <cstdint>
 #include <ctime>
+#include <deque>
+#include <future>
 #include <string>
+#include <utility>
 #include <vector>
 
 bool CommandDeriveChanges::setup(const std::vector<std::string>& arguments) {
@@ -109,7 +115,25 @@ void CommandDeriveChanges::show_arguments() {
     m_vout << "      update timestamp: "  << yes_no(m_update_timestamp);
 }
 
-void CommandDeriveChanges::write_deleted(osmium::io::Writer& writer, osmium::OSMObject& object) {
+namespace {
+
+    constexpr const std::size_t initial_buffer_size = 1024UL * 1024UL;
+
+    // Objects are grouped into ranges of 2^range_bits IDs. Ranges with the
+    // same checksums in both files contain no changes.
+    constexpr const unsigned int range_bits = 12;
+
+    // Minimum number of objects in the ranges handed to a worker thread
+    // as one batch.
+    constexpr const std::size_t min_batch_objects = 10000;
+
+    // Maximum number of batches handed to the worker threads which
+    // haven't been written out yet.
+    constexpr const std::size_t max_pending_batches = 20;
+
+} // anonymous namespace
+
+void CommandDeriveChanges::write_deleted(osmium::memory::Buffer& buffer, osmium::OSMObject& object) const {
     if (m_increment_version) {
         object.set_version(object.version() + 1);
     }
@@ -120,48 +144,77 @@ void CommandDeriveChanges::write_deleted(osmium::io::Writer& writer, osmium::OSM
 
     if (m_keep_details) {
         object.set_visible(false);
-        writer(object);
+        buffer.add_item(object);
+        buffer.commit();
     } else {
         using namespace osmium::builder::attr; // NOLINT(google-build-using-namespace)
         if (object.type() == osmium::item_type::node) {
-            osmium::builder::add_node(m_buffer,
+            osmium::builder::add_node(buffer,
                 _deleted(),
                 _id(object.id()),
                 _version(object.version()),
                 _timestamp(object.timestamp())
             );
         } else if (object.type() == osmium::item_type::way) {
-            osmium::builder::add_way(m_buffer,
+            osmium::builder::add_way(buffer,
                  _deleted(),
                  _id(object.id()),
                  _version(object.version()),
                  _timestamp(object.timestamp())
              );
         } else if (object.type() == osmium::item_type::relation) {
-            osmium::builder::add_relation(m_buffer,
+            osmium::builder::add_relation(buffer,
                  _deleted(),
                  _id(object.id()),
                  _version(object.version()),
                  _timestamp(object.timestamp())
              );
         }
-        writer(m_buffer.get<osmium::OSMObject>(0));
-        m_buffer.clear();
     }
 }
 
+void CommandDeriveChanges::derive_changes(osmium::memory::Buffer& buffer, const IdRange& range1, const IdRange& range2) const {
+    auto it1 = range1.objects().cbegin();
+    auto it2 = range2.objects().cbegin();
+    const auto end1 = range1.objects().cend();
+    const auto end2 = range2.objects().cend();
+
+    while (it1 != end1 || it2 != end2) {
+        if (it2 == end2) {
+            write_deleted(buffer, **it1);
+            ++it1;
+        } else if (it1 == end1 || **it2 < **it1) {
+            buffer.add_item(**it2);
+            buffer.commit();
+            ++it2;
+        } else if (**it1 < **it2) {
+            if ((*it2)->id() != (*it1)->id()) {
+                write_deleted(buffer, **it1);
+            }
+            ++it1;
+        } else { /* **it1 == **it2 */
+            ++it1;
+            ++it2;
+        }
+    }
+}
+
+osmium::memory::Buffer CommandDeriveChanges::derive_changes(const std::vector<IdRangePair>& batch) const {
+    osmium::memory::Buffer buffer{initial_buffer_size, osmium::memory::Buffer::auto_grow::yes};
+
+    for (const auto& pair : batch) {
+        derive_changes(buffer, pair.left, pair.right);
+    }
+
+    return buffer;
+}
+
 bool CommandDeriveChanges::run() {
     m_vout << "Opening input files...\n";
     osmium::io::Reader reader1{m_input_files[0], osmium::osm_entity_bits::object};
-    osmium::io::ReaderWithProgressBar reader2{display_progress(), m_input_files[1], osmium::osm_entity_bits::object};
-    auto in1 = osmium::io::make_input_iterator_range<osmium::OSMObject>(reader1);
-    auto in2 = osmium::io::make_input_iterator_range<osmium::OSMObject>(reader2);
-    auto it1 = in1.begin();
-    auto it2 = in2.begin();
-    auto end1 = in1.end();
-    auto end2 = in2.end();
-
-    reader2.progress_bar().remove();
+    osmium::io::Reader reader2{m_input_files[1], osmium::osm_entity_bits::object};
+    osmium::ProgressBar progress_bar{reader2.file_size(), display_progress()};
+
     m_vout << "Opening output file...\n";
     if (m_output_file.format() != osmium::io::file_format::xml || !m_output_file.is_true("xml_change_format")) {
         warning("Output format chosen is not the XML change format. Use .osc(.gz|bz2) as suffix or -f option.\n");
@@ -172,33 +225,73 @@ bool CommandDeriveChanges::run() {
 
     osmium::io::Writer writer{m_output_file, header, m_output_overwrite, m_fsync};
 
-    reader2.progress_bar().remove();
     m_vout << "Deriving changes...\n";
-    while (it1 != end1 || it2 != end2) {
-        if (it2 == end2) {
-            write_deleted(writer, *it1);
-            ++it1;
-        } else if (it1 == end1 || *it2 < *it1) {
-            writer(*it2);
-            ++it2;
-        } else if (*it1 < *it2) {
-            if (it2->id() != it1->id()) {
-                write_deleted(writer, *it1);
+    IdRangeReader ranges1{reader1, range_bits};
+    IdRangeReader ranges2{reader2, range_bits};
+    IdRange range1 = ranges1.next();
+    IdRange range2 = ranges2.next();
+
+    auto& pool = osmium::thread::Pool::default_instance();
+    std::deque<std::future<osmium::memory::Buffer>> pending;
+    std::vector<IdRangePair> batch;
+    std::size_t batch_objects = 0;
+    uint64_t ranges_unchanged = 0;
+
+    const auto submit_batch = [&]() {
+        pending.push_back(pool.submit([this, b = std::move(batch)]() {
+            return derive_changes(b);
+        }));
+        batch.clear();
+        batch_objects = 0;
+        if (pending.size() >= max_pending_batches) {
+            writer(pending.front().get());
+            pending.pop_front();
+        }
+    };
+
+    while (!range1.empty() || !range2.empty()) {
+        progress_bar.update(reader2.offset());
+        if (range2.empty() || (!range1.empty() && range1.key() < range2.key())) {
+            batch_objects += range1.size();
+            batch.push_back(IdRangePair{std::move(range1), IdRange{}});
+            range1 = ranges1.next();
+        } else if (range1.empty() || range2.key() < range1.key()) {
+            batch_objects += range2.size();
+            batch.push_back(IdRangePair{IdRange{}, std::move(range2)});
+            range2 = ranges2.next();
+        } else {
+            if (range1.same_content(range2)) {
+                ++ranges_unchanged;
+            } else {
+                batch_objects += range1.size() + range2.size();
+                batch.push_back(IdRangePair{std::move(range1), std::move(range2)});
             }
-            ++it1;
-        } else { /* *it1 == *it2 */
-            ++it1;
-            ++it2;
+            range1 = ranges1.next();
+            range2 = ranges2.next();
         }
+        if (batch_objects >= min_batch_objects) {
+            submit_batch();
+        }
+    }
+
+    if (!batch.empty()) {
+        submit_batch();
+    }
+
+    while (!pending.empty()) {
+        writer(pending.front().get());
+        pending.pop_front();
     }
+    progress_bar.done();
 
     writer.close();
     reader2.close();
     reader1.close();
 
+    m_vout << "Skipped " << ranges_unchanged << " unchanged ID ranges.\n";
+
     show_memory_used();
     m_vout << "Done.\n";
 
     return true;
 }
-
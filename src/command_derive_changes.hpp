@@ -25,16 +25,24 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "cmd.hpp" // IWYU pragma: export
 
-#include <osmium/io/writer.hpp>
+#include "id_range.hpp"
+
 #include <osmium/memory/buffer.hpp>
 #include <osmium/osm/object.hpp>
 
 #include <string>
 #include <vector>
 
-class CommandDeriveChanges : public CommandWithMultipleOSMInputs, public with_osm_output {
+/**
+ * Objects from the old and new file in the same ID range. One of the
+ * ranges can be empty.
+ */
+struct IdRangePair {
+    IdRange left;
+    IdRange right;
+};
 
-    osmium::memory::Buffer m_buffer{128};
+class CommandDeriveChanges : public CommandWithMultipleOSMInputs, public with_osm_output {
 
     bool m_keep_details = false;
     bool m_update_timestamp = false;
@@ -50,7 +58,11 @@ public:
 
     void show_arguments() override final;
 
-    void write_deleted(osmium::io::Writer& writer, osmium::OSMObject& object);
+    void write_deleted(osmium::memory::Buffer& buffer, osmium::OSMObject& object) const;
+
+    void derive_changes(osmium::memory::Buffer& buffer, const IdRange& range1, const IdRange& range2) const;
+
+    osmium::memory::Buffer derive_changes(const std::vector<IdRangePair>& batch) const;
 
     bool run() override final;
 
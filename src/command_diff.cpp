@@ -23,14 +23,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "command_diff.hpp"
 
 #include "exception.hpp"
+#include "id_range.hpp"
 #include "util.hpp"
 
 #include <osmium/io/detail/read_write.hpp>
 #include <osmium/io/file.hpp>
 #include <osmium/io/file_format.hpp>
-#include <osmium/io/input_iterator.hpp>
 #include <osmium/io/reader.hpp>
-#include <osmium/io/reader_with_progress_bar.hpp>
 #include <osmium/io/writer.hpp>
 #include <osmium/io/writer_options.hpp>
 #include <osmium/memory/item.hpp>
@@ -38,11 +37,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/osm/crc.hpp>
 #include <osmium/osm/crc_zlib.hpp>
 #include <osmium/osm/item_type.hpp>
+#include <osmium/util/progress_bar.hpp>
 #include <osmium/util/verbose_output.hpp>
 
 #include <boost/program_options.hpp>
 
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <sstream>
@@ -248,15 +249,139 @@ public:
 
 }; // class OutputActionOSM
 
+static unsigned long object_crc(const osmium::OSMObject& object) {
+    osmium::CRC<osmium::CRC_zlib> crc;
+    switch (object.type()) {
+        case osmium::item_type::node:
+            crc.update(static_cast<const osmium::Node&>(object));
+            break;
+        case osmium::item_type::way:
+            crc.update(static_cast<const osmium::Way&>(object));
+            break;
+        case osmium::item_type::relation:
+            crc.update(static_cast<const osmium::Relation&>(object));
+            break;
+        default:
+            break;
+    }
+    return crc().checksum();
+}
+
+// Two objects with the same type, id, and version are the same if their
+// binary representations are the same. Only if that isn't the case (for
+// instance because they were read from different file formats) the
+// more expensive CRC comparison is needed.
+static bool same_object(const osmium::OSMObject& left, const osmium::OSMObject& right) {
+    if (left.byte_size() == right.byte_size() &&
+        std::memcmp(left.data(), right.data(), left.byte_size()) == 0) {
+        return true;
+    }
+    return object_crc(left) == object_crc(right);
+}
+
+/**
+ * Compares objects from the left and right file, keeps count of the
+ * results and calls the output action.
+ */
+class Differ {
+
+    OutputAction* m_action;
+    bool m_suppress_common;
+
+public:
+
+    uint64_t count_left = 0;
+    uint64_t count_right = 0;
+    uint64_t count_same = 0;
+    uint64_t count_different = 0;
+
+    Differ(OutputAction* action, bool suppress_common) noexcept :
+        m_action(action),
+        m_suppress_common(suppress_common) {
+    }
+
+    bool found_difference() const noexcept {
+        return count_left != 0 || count_right != 0 || count_different != 0;
+    }
+
+    void left(osmium::OSMObject& object) {
+        object.set_diff(osmium::diff_indicator_type::left);
+        ++count_left;
+        if (m_action) {
+            m_action->left(object);
+        }
+    }
+
+    void right(osmium::OSMObject& object) {
+        object.set_diff(osmium::diff_indicator_type::right);
+        ++count_right;
+        if (m_action) {
+            m_action->right(object);
+        }
+    }
+
+    void same(osmium::OSMObject& left, osmium::OSMObject& right) {
+        ++count_same;
+        if (!m_suppress_common) {
+            left.set_diff(osmium::diff_indicator_type::both);
+            right.set_diff(osmium::diff_indicator_type::both);
+            if (m_action) {
+                m_action->same(left);
+            }
+        }
+    }
+
+    void different(osmium::OSMObject& left, osmium::OSMObject& right) {
+        ++count_different;
+        left.set_diff(osmium::diff_indicator_type::left);
+        right.set_diff(osmium::diff_indicator_type::right);
+        if (m_action) {
+            m_action->different(left, right);
+        }
+    }
+
+    // Compare ranges with the same key object by object.
+    void compare(const IdRange& range1, const IdRange& range2, bool stop_early) {
+        auto it1 = range1.objects().cbegin();
+        auto it2 = range2.objects().cbegin();
+        const auto end1 = range1.objects().cend();
+        const auto end2 = range2.objects().cend();
+
+        while (it1 != end1 || it2 != end2) {
+            if (stop_early && found_difference()) {
+                return;
+            }
+            if (it2 == end2) {
+                left(**it1);
+                ++it1;
+            } else if (it1 == end1 || **it2 < **it1) {
+                right(**it2);
+                ++it2;
+            } else if (**it1 < **it2) {
+                left(**it1);
+                ++it1;
+            } else { /* **it1 == **it2 */
+                if (same_object(**it1, **it2)) {
+                    same(**it1, **it2);
+                } else {
+                    different(**it1, **it2);
+                }
+                ++it1;
+                ++it2;
+            }
+        }
+    }
+
+}; // class Differ
+
+// Objects are grouped into ranges of 2^range_bits IDs. Ranges with the
+// same checksums in both files are not compared object by object.
+constexpr const unsigned int range_bits = 12;
+
 bool CommandDiff::run() {
     osmium::io::Reader reader1{m_input_files[0], osm_entity_bits()};
-    osmium::io::ReaderWithProgressBar reader2{display_progress(), m_input_files[1], osm_entity_bits()};
-    auto in1 = osmium::io::make_input_iterator_range<osmium::OSMObject>(reader1);
-    auto in2 = osmium::io::make_input_iterator_range<osmium::OSMObject>(reader2);
-    auto it1 = in1.begin();
-    auto it2 = in2.begin();
-    auto end1 = in1.end();
-    auto end2 = in2.end();
+    osmium::io::Reader reader2{m_input_files[1], osm_entity_bits()};
+    osmium::ProgressBar progress_bar{reader2.file_size(), display_progress()};
 
     std::unique_ptr<OutputAction> action;
 
@@ -268,85 +393,58 @@ bool CommandDiff::run() {
         action = std::make_unique<OutputActionOSM>(m_output_file, m_output_overwrite);
     }
 
-    uint64_t count_left = 0;
-    uint64_t count_right = 0;
-    uint64_t count_same = 0;
-    uint64_t count_different = 0;
+    Differ differ{action.get(), m_suppress_common};
 
-    while (it1 != end1 || it2 != end2) {
-        if (it2 == end2) {
-            it1->set_diff(osmium::diff_indicator_type::left);
-            ++count_left;
-            if (action) {
-                action->left(*it1);
-            }
-            ++it1;
-        } else if (it1 == end1 || *it2 < *it1) {
-            it2->set_diff(osmium::diff_indicator_type::right);
-            ++count_right;
-            if (action) {
-                action->right(*it2);
-            }
-            ++it2;
-        } else if (*it1 < *it2) {
-            it1->set_diff(osmium::diff_indicator_type::left);
-            ++count_left;
-            if (action) {
-                action->left(*it1);
+    // If only the return code is needed, stop at the first difference.
+    const bool stop_early = !action && !m_show_summary;
+
+    IdRangeReader ranges1{reader1, range_bits};
+    IdRangeReader ranges2{reader2, range_bits};
+    IdRange range1 = ranges1.next();
+    IdRange range2 = ranges2.next();
+
+    while (!range1.empty() || !range2.empty()) {
+        if (stop_early && differ.found_difference()) {
+            m_vout << "Found difference, stopping early.\n";
+            break;
+        }
+        progress_bar.update(reader2.offset());
+        if (range2.empty() || (!range1.empty() && range1.key() < range2.key())) {
+            for (auto* object : range1.objects()) {
+                differ.left(*object);
             }
-            ++it1;
-        } else { /* *it1 == *it2 */
-            osmium::CRC<osmium::CRC_zlib> crc1;
-            osmium::CRC<osmium::CRC_zlib> crc2;
-            switch (it1->type()) {
-                case osmium::item_type::node:
-                    crc1.update(static_cast<const osmium::Node&>(*it1));
-                    crc2.update(static_cast<const osmium::Node&>(*it2));
-                    break;
-                case osmium::item_type::way:
-                    crc1.update(static_cast<const osmium::Way&>(*it1));
-                    crc2.update(static_cast<const osmium::Way&>(*it2));
-                    break;
-                case osmium::item_type::relation:
-                    crc1.update(static_cast<const osmium::Relation&>(*it1));
-                    crc2.update(static_cast<const osmium::Relation&>(*it2));
-                    break;
-                default:
-                    break;
+            range1 = ranges1.next();
+        } else if (range1.empty() || range2.key() < range1.key()) {
+            for (auto* object : range2.objects()) {
+                differ.right(*object);
             }
-            if (crc1().checksum() == crc2().checksum()) {
-                ++count_same;
-                if (!m_suppress_common) {
-                    it1->set_diff(osmium::diff_indicator_type::both);
-                    it2->set_diff(osmium::diff_indicator_type::both);
-                    if (action) {
-                        action->same(*it1);
-                    }
+            range2 = ranges2.next();
+        } else {
+            if (range1.same_content(range2)) {
+                auto it2 = range2.objects().cbegin();
+                for (auto* object : range1.objects()) {
+                    differ.same(*object, **it2++);
                 }
             } else {
-                ++count_different;
-                it1->set_diff(osmium::diff_indicator_type::left);
-                it2->set_diff(osmium::diff_indicator_type::right);
-                if (action) {
-                    action->different(*it1, *it2);
-                }
+                differ.compare(range1, range2, stop_early);
             }
-            ++it1;
-            ++it2;
+            range1 = ranges1.next();
+            range2 = ranges2.next();
         }
     }
+    progress_bar.done();
 
     if (m_show_summary) {
-        std::cerr << "Summary: left=" << count_left <<
-                            " right=" << count_right <<
-                             " same=" << count_same <<
-                        " different=" << count_different << "\n";
+        std::cerr << "Summary: left=" << differ.count_left <<
+                            " right=" << differ.count_right <<
+                             " same=" << differ.count_same <<
+                        " different=" << differ.count_different << "\n";
     }
 
     show_memory_used();
 
     m_vout << "Done.\n";
 
-    return count_left == 0 && count_right == 0 && count_different == 0;
+    return !differ.found_difference();
 }
 
@@ -23,6 +23,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "command_export.hpp"
 
 #include "exception.hpp"
+#include "pbf_index.hpp"
 #include "util.hpp"
 
 #include "export/export_format_json.hpp"
@@ -38,7 +39,6 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/io/reader_with_progress_bar.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/osm.hpp>
-#include <osmium/relations/manager_util.hpp>
 #include <osmium/util/string.hpp>
 #include <osmium/util/verbose_output.hpp>
 #include <osmium/visitor.hpp>
@@ -601,7 +601,12 @@ bool CommandExport::run() {
     osmium::area::MultipolygonManager<osmium::area::Assembler> mp_manager{assembler_config};
 
     m_vout << "First pass (of two) through input file (reading relations)...\n";
-    osmium::relations::read_relations(m_input_file, mp_manager);
+    read_osm_file(m_input_file, osmium::osm_entity_bits::relation, osmium::io::read_meta::yes, [&](osmium::memory::Buffer& buffer) {
+        for (const auto& relation : buffer.select<osmium::Relation>()) {
+            mp_manager.relation(relation);
+        }
+    });
+    mp_manager.prepare_for_lookup();
     m_vout << "First pass done.\n";
 
     m_vout << "Second pass (of two) through input file...\n";
@@ -631,9 +636,9 @@ bool CommandExport::run() {
             osmium::apply(buffer, export_handler);
         }));
         reader.close();
-        m_vout << "About "
-               << show_mbytes(location_index_pos->used_memory() + location_index_neg->used_memory())
-               << " MBytes used for node location index (in main memory or on disk).\n";
+        const auto mem = location_index_pos->used_memory() + location_index_neg->used_memory();
+        add_index_memory("node locations", mem);
+        m_vout << "About " << show_mbytes(mem) << " MBytes used for node location index (in main memory or on disk).\n";
     }
 
     if (m_stop_on_error) {
@@ -27,12 +27,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "extract/extract_bbox.hpp"
 #include "extract/extract_polygon.hpp"
 #include "extract/geojson_file_parser.hpp"
-#include "extract/osm_file_parser.hpp"
+#include "extract/input_boundaries.hpp"
 #include "extract/poly_file_parser.hpp"
+#include "extract/polygon_cache.hpp"
+#include "extract/strategy_clip.hpp"
 #include "extract/strategy_complete_ways.hpp"
 #include "extract/strategy_complete_ways_with_history.hpp"
 #include "extract/strategy_simple.hpp"
 #include "extract/strategy_smart.hpp"
+#include "extract/strategy_tiles.hpp"
 #include "util.hpp"
 
 #include <osmium/geom/coordinates.hpp>
@@ -42,6 +45,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/io/writer_options.hpp>
 #include <osmium/osm.hpp>
 #include <osmium/osm/box.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/util/progress_bar.hpp>
 #include <osmium/util/string.hpp>
 #include <osmium/util/verbose_output.hpp>
@@ -178,44 +182,53 @@ static bool is_path_rooted(const std::string& path) noexcept {
 }
 #endif
 
-static std::size_t parse_multipolygon_object(const std::string& directory, std::string file_name, std::string file_type, osmium::memory::Buffer* buffer) {
-    assert(buffer);
-
-    if (file_name.empty()) {
-        throw config_error{"Missing 'file_name' in '(multi)polygon' object."};
-    }
+// Make the file name relative to the directory and deduce the file type
+// if it is not set.
+static void resolve_polygon_file(const std::string& directory, std::string* file_name, std::string* file_type) {
+    assert(file_name);
+    assert(file_type);
 
 #ifdef _WIN32
-    const bool is_relative = !is_path_rooted(file_name);
+    const bool is_relative = !is_path_rooted(*file_name);
 #else
-    const bool is_relative = file_name[0] != '/';
+    const bool is_relative = (*file_name)[0] != '/';
 #endif
 
     if (is_relative) {
         // relative file name
-        file_name = directory + file_name;
+        *file_name = directory + *file_name;
     }
 
     // If the file type is not set, try to deduce it from the file name
     // suffix.
-    if (file_type.empty()) {
-        if (ends_with(file_name, ".poly")) {
-            file_type = "poly";
-        } else if (ends_with(file_name, ".json") || ends_with(file_name, ".geojson")) {
-            file_type = "geojson";
+    if (file_type->empty()) {
+        if (ends_with(*file_name, ".poly")) {
+            *file_type = "poly";
+        } else if (ends_with(*file_name, ".json") || ends_with(*file_name, ".geojson")) {
+            *file_type = "geojson";
         } else {
-            const std::string suffix{get_filename_suffix(file_name)};
+            const std::string suffix{get_filename_suffix(*file_name)};
             const osmium::io::File osmfile{"", suffix};
             if (osmfile.format() != osmium::io::file_format::unknown) {
-                file_type = "osm";
+                *file_type = "osm";
             }
         }
     }
+}
+
+static std::size_t parse_multipolygon_object(const std::string& directory, std::string file_name, std::string file_type, PolygonCache* cache, osmium::memory::Buffer* buffer) {
+    assert(cache);
+    assert(buffer);
+
+    if (file_name.empty()) {
+        throw config_error{"Missing 'file_name' in '(multi)polygon' object."};
+    }
+
+    resolve_polygon_file(directory, &file_name, &file_type);
 
     if (file_type == "osm") {
         try {
-            OSMFileParser parser{*buffer, file_name};
-            return parser();
+            return cache->get(file_name, *buffer);
         } catch (const std::system_error& e) {
             throw osmium::io_error{std::string{"While reading file '"} + file_name + "':\n" + e.what()};
         } catch (const osmium::io_error& e) {
@@ -240,15 +253,70 @@ static std::size_t parse_multipolygon_object(const std::string& directory, std::
     throw config_error{std::string{"Unknown file type: '"} + file_type + "' in '(multi)polygon.file_type'"};
 }
 
-static std::size_t parse_multipolygon_object(const std::string& directory, const rapidjson::Value& value, osmium::memory::Buffer* buffer) {
+// Get the relations from the input file which should be used as boundary
+// from a '(multi)polygon' object. Returns false if the object doesn't
+// reference relations.
+static bool get_relation_request(const rapidjson::Value& value, InputBoundaries::request* req) {
+    assert(req);
+
+    const auto json_ids = value.FindMember("relation_id");
+    const auto json_tags = value.FindMember("relation_tags");
+    if (json_ids == value.MemberEnd() && json_tags == value.MemberEnd()) {
+        return false;
+    }
+
+    if (json_ids != value.MemberEnd()) {
+        if (json_ids->value.IsInt64()) {
+            req->ids.push_back(json_ids->value.GetInt64());
+        } else if (json_ids->value.IsArray()) {
+            for (const auto& id : json_ids->value.GetArray()) {
+                if (!id.IsInt64()) {
+                    throw config_error{"Values in 'relation_id' array must be integers."};
+                }
+                req->ids.push_back(id.GetInt64());
+            }
+        } else {
+            throw config_error{"Value of 'relation_id' must be an integer or an array of integers."};
+        }
+    }
+
+    if (json_tags != value.MemberEnd()) {
+        if (json_tags->value.IsString()) {
+            req->tags.emplace_back(json_tags->value.GetString());
+        } else if (json_tags->value.IsArray()) {
+            for (const auto& tag : json_tags->value.GetArray()) {
+                if (!tag.IsString()) {
+                    throw config_error{"Values in 'relation_tags' array must be strings."};
+                }
+                req->tags.emplace_back(tag.GetString());
+            }
+        } else {
+            throw config_error{"Value of 'relation_tags' must be a string or an array of strings."};
+        }
+    }
+
+    if (req->ids.empty() && req->tags.empty()) {
+        throw config_error{"Need at least one relation ID or tag in '(multi)polygon' object."};
+    }
+
+    return true;
+}
+
+static std::size_t parse_multipolygon_object(const std::string& directory, const rapidjson::Value& value, PolygonCache* cache, const InputBoundaries* boundaries, osmium::memory::Buffer* buffer) {
+    assert(boundaries);
     assert(buffer);
 
+    InputBoundaries::request req;
+    if (get_relation_request(value, &req)) {
+        return boundaries->get(req, *buffer);
+    }
+
     const std::string file_name{get_value_as_string(value, "file_name")};
     const std::string file_type{get_value_as_string(value, "file_type")};
-    return parse_multipolygon_object(directory, file_name, file_type, buffer);
+    return parse_multipolygon_object(directory, file_name, file_type, cache, buffer);
 }
 
-static std::size_t parse_polygon(const std::string& directory, const rapidjson::Value& value, osmium::memory::Buffer* buffer) {
+static std::size_t parse_polygon(const std::string& directory, const rapidjson::Value& value, PolygonCache* cache, const InputBoundaries* boundaries, osmium::memory::Buffer* buffer) {
     assert(buffer);
 
     if (value.IsArray()) {
@@ -256,13 +324,13 @@ static std::size_t parse_polygon(const std::string& directory, const rapidjson::
     }
 
     if (value.IsObject()) {
-        return parse_multipolygon_object(directory, value, buffer);
+        return parse_multipolygon_object(directory, value, cache, boundaries, buffer);
     }
 
     throw config_error{"Polygon must be an object or array."};
 }
 
-std::size_t parse_multipolygon(const std::string& directory, const rapidjson::Value& value, osmium::memory::Buffer* buffer) {
+std::size_t parse_multipolygon(const std::string& directory, const rapidjson::Value& value, PolygonCache* cache, const InputBoundaries* boundaries, osmium::memory::Buffer* buffer) {
     assert(buffer);
 
     if (value.IsArray()) {
@@ -270,7 +338,7 @@ std::size_t parse_multipolygon(const std::string& directory, const rapidjson::Va
     }
 
     if (value.IsObject()) {
-        return parse_multipolygon_object(directory, value, buffer);
+        return parse_multipolygon_object(directory, value, cache, boundaries, buffer);
     }
 
     throw config_error{"Multipolygon must be an object or array."};
@@ -305,6 +373,49 @@ void CommandExtract::set_directory(const std::string& directory) {
     }
 }
 
+// Boundaries from OSM files are assembled (or read from the polygon cache)
+// in parallel before the extracts are set up. Boundaries from relations in
+// the input file are assembled in a few passes over the input file. Errors
+// in the config are reported later when the extracts are read.
+void CommandExtract::prefetch_polygons(const rapidjson::Value& extracts) {
+    for (const auto& item : extracts.GetArray()) {
+        if (!item.IsObject()) {
+            continue;
+        }
+        for (const char* geometry : {"polygon", "multipolygon"}) {
+            const auto json_geometry = item.FindMember(geometry);
+            if (json_geometry == item.MemberEnd() || !json_geometry->value.IsObject()) {
+                continue;
+            }
+            try {
+                InputBoundaries::request req;
+                if (get_relation_request(json_geometry->value, &req)) {
+                    m_input_boundaries.add(req);
+                    continue;
+                }
+                std::string file_name{get_value_as_string(json_geometry->value, "file_name")};
+                std::string file_type{get_value_as_string(json_geometry->value, "file_type")};
+                if (!file_name.empty()) {
+                    resolve_polygon_file(m_config_directory, &file_name, &file_type);
+                    if (file_type == "osm") {
+                        m_polygon_cache.prefetch(file_name);
+                    }
+                }
+            } catch (const config_error&) {
+            }
+        }
+    }
+
+    m_polygon_cache.load(static_cast<unsigned int>(osmium::thread::Pool::default_instance().num_threads()));
+
+    if (!m_polygon_cache.directory().empty()) {
+        m_vout << "  Read " << m_polygon_cache.cache_hits() << " polygon(s) from cache, assembled "
+               << m_polygon_cache.cache_misses() << " polygon(s) from OSM files.\n";
+    }
+
+    m_input_boundaries.read(m_input_file, m_vout);
+}
+
 void CommandExtract::parse_config_file() {
     std::ifstream config_file{m_config_file_name};
     rapidjson::IStreamWrapper stream_wrapper{config_file};
@@ -337,6 +448,8 @@ void CommandExtract::parse_config_file() {
         throw config_error{"'extracts' member in top-level object must be array."};
     }
 
+    prefetch_polygons(json_extracts->value);
+
     m_vout << "  Reading extracts from config file...\n";
     int extract_num = 1;
     for (const auto& item : json_extracts->value.GetArray()) {
@@ -370,9 +483,9 @@ void CommandExtract::parse_config_file() {
             if (json_bbox != item.MemberEnd()) {
                 m_extracts.push_back(std::make_unique<ExtractBBox>(output_file, description, parse_bbox(json_bbox->value)));
             } else if (json_polygon != item.MemberEnd()) {
-                m_extracts.push_back(std::make_unique<ExtractPolygon>(output_file, description, m_buffer, parse_polygon(m_config_directory, json_polygon->value, &m_buffer)));
+                m_extracts.push_back(std::make_unique<ExtractPolygon>(output_file, description, m_buffer, parse_polygon(m_config_directory, json_polygon->value, &m_polygon_cache, &m_input_boundaries, &m_buffer)));
             } else if (json_multipolygon != item.MemberEnd()) {
-                m_extracts.push_back(std::make_unique<ExtractPolygon>(output_file, description, m_buffer, parse_multipolygon(m_config_directory, json_multipolygon->value, &m_buffer)));
+                m_extracts.push_back(std::make_unique<ExtractPolygon>(output_file, description, m_buffer, parse_multipolygon(m_config_directory, json_multipolygon->value, &m_polygon_cache, &m_input_boundaries, &m_buffer)));
             } else {
                 throw config_error{"Missing geometry for extract. Need 'bbox', 'polygon', or 'multipolygon'."};
             }
@@ -446,9 +559,34 @@ std::unique_ptr<ExtractStrategy> CommandExtract::make_strategy(const std::string
         return std::make_unique<strategy_smart::Strategy>(m_extracts, m_options);
     }
 
+    if (name == "clip") {
+        if (m_with_history) {
+            throw argument_error{"The 'clip' strategy is not supported for history files."};
+        }
+        return std::make_unique<strategy_clip::Strategy>(m_extracts, m_options);
+    }
+
     throw argument_error{std::string{"Unknown extract strategy: '"} + name + "'."};
 }
 
+// In tiles mode the strategy creates the output files itself, because
+// they are only known after reading the input file.
+std::unique_ptr<ExtractStrategy> CommandExtract::make_tiles_strategy(const osmium::io::Header& header) {
+    strategy_tiles::output_settings settings;
+    settings.directory = m_output_directory;
+    settings.format = m_output_format;
+    settings.header = header;
+    settings.output_overwrite = m_output_overwrite;
+    settings.sync = m_fsync;
+    settings.clean = &m_clean;
+    if (collect_stats()) {
+        settings.write_stats = &stage("write");
+    }
+    settings.set_bounds = m_set_bounds;
+
+    return std::make_unique<strategy_tiles::Strategy>(settings, m_tiles_zoom, m_options);
+}
+
 bool CommandExtract::setup(const std::vector<std::string>& arguments) {
     po::options_description opts_cmd{"COMMAND OPTIONS"};
     opts_cmd.add_options()
@@ -457,7 +595,9 @@ bool CommandExtract::setup(const std::vector<std::string>& arguments) {
     ("directory,d", po::value<std::string>(), "Output directory (default: from config)")
     ("option,S", po::value<std::vector<std::string>>(), "Set strategy option")
     ("polygon,p", po::value<std::string>(), "Polygon file")
+    ("polygon-cache", po::value<std::string>(), "Directory for caching polygons assembled from OSM files")
     ("strategy,s", po::value<std::string>()->default_value("complete_ways"), "Use named extract strategy")
+    ("tiles", po::value<uint32_t>(), "Write all tiles of this zoom level into output directory")
     ("with-history,H", "Input file and output files are history files")
     ("set-bounds", "Sets bounds (bounding box) in header")
     ("clean", po::value<std::vector<std::string>>(), "Clean attribute (version, changeset, timestamp, uid, user)")
@@ -494,14 +634,22 @@ bool CommandExtract::setup(const std::vector<std::string>& arguments) {
 
     m_clean.setup(vm);
 
-    if (vm.count("config") + vm.count("bbox") + vm.count("polygon") > 1) {
-        throw argument_error{"Can only use one of --config/-c, --bbox/-b, or --polygon/-p."};
+    if (vm.count("config") + vm.count("bbox") + vm.count("polygon") + vm.count("tiles") > 1) {
+        throw argument_error{"Can only use one of --config/-c, --bbox/-b, --polygon/-p, or --tiles."};
     }
 
     if (vm.count("with-history")) {
         m_with_history = true;
     }
 
+    if (vm.count("polygon-cache")) {
+        const auto directory = vm["polygon-cache"].as<std::string>();
+        if (!is_existing_directory(directory.c_str())) {
+            throw argument_error{"Polygon cache directory is missing or not accessible: " + directory};
+        }
+        m_polygon_cache = PolygonCache{directory};
+    }
+
     if (vm.count("config")) {
         if (vm.count("directory")) {
             set_directory(vm["directory"].as<std::string>());
@@ -539,7 +687,25 @@ bool CommandExtract::setup(const std::vector<std::string>& arguments) {
         if (m_with_history) {
             m_output_file.set_has_multiple_object_versions(true);
         }
-        m_extracts.push_back(std::make_unique<ExtractPolygon>(m_output_file, "", m_buffer, parse_multipolygon_object("./", vm["polygon"].as<std::string>(), "", &m_buffer)));
+        m_extracts.push_back(std::make_unique<ExtractPolygon>(m_output_file, "", m_buffer, parse_multipolygon_object("./", vm["polygon"].as<std::string>(), "", &m_polygon_cache, &m_buffer)));
+    }
+
+    if (vm.count("tiles")) {
+        m_tiles = true;
+        m_tiles_zoom = vm["tiles"].as<uint32_t>();
+        if (m_tiles_zoom > 30) {
+            throw argument_error{"Zoom level for --tiles must be between 0 and 30."};
+        }
+        if (m_with_history) {
+            throw argument_error{"The --tiles option is not supported for history files."};
+        }
+        if (!vm.count("directory")) {
+            throw argument_error{"Need --directory/-d option when using --tiles."};
+        }
+        set_directory(vm["directory"].as<std::string>());
+        if (vm.count("output")) {
+            warning("Ignoring --output/-o option.\n");
+        }
     }
 
     if (vm.count("option")) {
@@ -556,6 +722,13 @@ bool CommandExtract::setup(const std::vector<std::string>& arguments) {
         m_strategy_name = vm["strategy"].as<std::string>();
     }
 
+    if (m_tiles) {
+        if (!vm["strategy"].defaulted()) {
+            warning("Ignoring --strategy/-s option.\n");
+        }
+        m_strategy_name = "tiles";
+    }
+
     return true;
 }
 
@@ -570,6 +743,7 @@ void CommandExtract::show_arguments() {
     m_vout << "  other options:\n";
     m_vout << "    config file: " << m_config_file_name << '\n';
     m_vout << "    output directory: " << m_output_directory << '\n';
+    m_vout << "    polygon cache directory: " << m_polygon_cache.directory() << '\n';
     m_vout << "    attributes to clean: " << m_clean.to_string() << '\n';
 
     m_vout << '\n';
@@ -618,14 +792,13 @@ bool CommandExtract::run() {
         }
     }
 
-    if (m_extracts.empty()) {
+    if (m_extracts.empty() && !m_tiles) {
         throw config_error{"No extract specified in config file or on the command line."};
     }
 
-    show_extracts();
-
-    m_strategy = make_strategy(m_strategy_name);
-    m_strategy->show_arguments(m_vout);
+    if (!m_tiles) {
+        show_extracts();
+    }
 
     osmium::io::Header header;
     osmium::io::Header input_header;
@@ -642,19 +815,31 @@ bool CommandExtract::run() {
         header.set_has_multiple_object_versions(true);
     }
 
+    m_strategy = m_tiles ? make_tiles_strategy(header) : make_strategy(m_strategy_name);
+    m_strategy->show_arguments(m_vout);
+    if (collect_stats()) {
+        m_strategy->set_run_stats(&run_stats());
+    }
+
     for (const auto& extract : m_extracts) {
         osmium::io::Header file_header{header};
         if (m_set_bounds) {
             file_header.add_box(extract->envelope());
         }
         init_header(file_header, input_header, extract->header_options());
+        if (collect_stats()) {
+            extract->set_write_stats(&stage("write"));
+        }
         extract->open_file(file_header, m_output_overwrite, m_fsync, &m_clean);
     }
 
     m_strategy->run(m_vout, display_progress(), m_input_file);
 
-    for (const auto& extract : m_extracts) {
-        extract->close_file();
+    {
+        const StageTimer timer{stage("write")};
+        for (const auto& extract : m_extracts) {
+            extract->close_file();
+        }
     }
 
     show_memory_used();
@@ -25,12 +25,18 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "cmd.hpp" // IWYU pragma: export
 #include "extract/extract.hpp"
+#include "extract/input_boundaries.hpp"
+#include "extract/polygon_cache.hpp"
 #include "extract/strategy.hpp"
 
+#include <osmium/io/header.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/util/options.hpp>
 
+#include <rapidjson/document.h>
+
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -46,10 +52,15 @@ class CommandExtract : public CommandWithSingleOSMInput, public with_osm_output
     std::string m_output_directory;
     std::string m_strategy_name;
     osmium::memory::Buffer m_buffer{initial_buffer_size, osmium::memory::Buffer::auto_grow::yes};
+    PolygonCache m_polygon_cache;
+    InputBoundaries m_input_boundaries;
     std::unique_ptr<ExtractStrategy> m_strategy;
+    uint32_t m_tiles_zoom = 0;
+    bool m_tiles = false;
     bool m_with_history = false;
     bool m_set_bounds = false;
 
+    void prefetch_polygons(const rapidjson::Value& extracts);
     void parse_config_file();
     void show_extracts();
 
@@ -57,6 +68,8 @@ class CommandExtract : public CommandWithSingleOSMInput, public with_osm_output
 
     std::unique_ptr<ExtractStrategy> make_strategy(const std::string& name);
 
+    std::unique_ptr<ExtractStrategy> make_tiles_strategy(const osmium::io::Header& header);
+
 public:
 
     explicit CommandExtract(const CommandFactory& command_factory) :
@@ -76,7 +89,8 @@ public:
     const char* synopsis() const noexcept override final {
         return "osmium extract --config CONFIG-FILE [OPTIONS] OSM-FILE\n"
                "       osmium extract --bbox LEFT,BOTTOM,RIGHT,TOP [OPTIONS] OSM-FILE\n"
-               "       osmium extract --polygon POLYGON-FILE [OPTIONS] OSM-FILE";
+               "       osmium extract --polygon POLYGON-FILE [OPTIONS] OSM-FILE\n"
+               "       osmium extract --tiles ZOOM --directory DIR [OPTIONS] OSM-FILE";
     }
 
 }; // class CommandExtract
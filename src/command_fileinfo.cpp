@@ -23,18 +23,21 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "command_fileinfo.hpp"
 
 #include "exception.hpp"
+#include "file_stats.hpp"
 #include "util.hpp"
 
 #include <osmium/handler.hpp>
 #include <osmium/io/file.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/io/reader.hpp>
+#include <osmium/memory/buffer.hpp>
 #include <osmium/osm.hpp>
 #include <osmium/osm/box.hpp>
 #include <osmium/osm/crc.hpp>
 #include <osmium/osm/crc_zlib.hpp>
 #include <osmium/osm/metadata_options.hpp>
 #include <osmium/osm/object_comparisons.hpp>
+#include <osmium/thread/pool.hpp>
 #include <osmium/util/file.hpp>
 #include <osmium/util/minmax.hpp>
 #include <osmium/util/progress_bar.hpp>
@@ -46,9 +49,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <boost/program_options.hpp>
 
+#include <zlib.h>
+
 #include <algorithm>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <memory>
@@ -63,6 +71,53 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 /*************************************************************************/
 
+// Maximum number of buffers handed to the worker threads whose statistics
+// have not been merged yet.
+constexpr const std::size_t max_pending_buffers = 20;
+
+/**
+ * CRC32 implementation compatible with osmium::CRC_zlib which also keeps
+ * track of the number of bytes processed. This allows combining the
+ * checksums calculated for consecutive parts of the data into the checksum
+ * of the whole using zlib's crc32_combine().
+ */
+class CRC_zlib_combinable {
+
+    unsigned long m_crc32 = ::crc32(0, nullptr, 0);
+    std::size_t m_length = 0;
+
+public:
+
+    void process_byte(const unsigned char byte) noexcept {
+        m_crc32 = ::crc32(m_crc32, &byte, 1);
+        ++m_length;
+    }
+
+    void process_bytes(const void* buffer, std::size_t byte_count) noexcept {
+        m_crc32 = ::crc32(m_crc32, reinterpret_cast<const unsigned char*>(buffer), static_cast<unsigned int>(byte_count));
+        m_length += byte_count;
+    }
+
+    unsigned long checksum() const noexcept {
+        return m_crc32;
+    }
+
+    // Append the data checksummed by other to the data checksummed by
+    // this object.
+    void combine(const CRC_zlib_combinable& other) noexcept {
+        m_crc32 = ::crc32_combine(m_crc32, other.m_crc32, static_cast<z_off_t>(other.m_length));
+        m_length += other.m_length;
+    }
+
+}; // class CRC_zlib_combinable
+
+/**
+ * Collects the statistics for some consecutive part of the input data.
+ * Statistics for consecutive parts can be combined by calling merge() in
+ * order. This is used to collect the statistics for each buffer on a
+ * worker thread. The ordering of the objects is checked inside the buffer
+ * and, when merging, on the boundaries between buffers.
+ */
 struct InfoHandler : public osmium::handler::Handler {
 
     osmium::Box bounds;
@@ -92,12 +147,15 @@ struct InfoHandler : public osmium::handler::Handler {
     osmium::min_op<osmium::Timestamp> first_timestamp;
     osmium::max_op<osmium::Timestamp> last_timestamp;
 
-    osmium::CRC<osmium::CRC_zlib> crc32;
+    osmium::CRC<CRC_zlib_combinable> crc32;
 
     bool ordered = true;
     bool multiple_versions = false;
     bool calculate_crc = false;
 
+    osmium::item_type first_type = osmium::item_type::undefined;
+    osmium::object_id_type first_id = 0;
+
     osmium::item_type last_type = osmium::item_type::undefined;
     osmium::object_id_type last_id = 0;
 
@@ -105,16 +163,39 @@ struct InfoHandler : public osmium::handler::Handler {
         calculate_crc(with_crc) {
     }
 
-    void changeset(const osmium::Changeset& changeset) {
-        if (last_type == osmium::item_type::changeset) {
-            if (last_id > changeset.id()) {
+    void check_order(const osmium::item_type type, const osmium::object_id_type id) {
+        if (last_type == osmium::item_type::undefined) {
+            first_type = type;
+            first_id = id;
+        } else if (type == osmium::item_type::changeset) {
+            if (last_type == osmium::item_type::changeset && last_id > id) {
                 ordered = false;
             }
-        } else {
-            last_type = osmium::item_type::changeset;
+        } else if (last_type == type) {
+            if (last_id == id) {
+                multiple_versions = true;
+            }
+            if (osmium::id_order{}(id, last_id)) {
+                ordered = false;
+            }
+        } else if (last_type != osmium::item_type::changeset && last_type > type) {
+            ordered = false;
         }
 
-        last_id = changeset.id();
+        last_type = type;
+        last_id = id;
+    }
+
+    void add_buffer(osmium::memory::Buffer& buffer) {
+        ++buffers_count;
+        buffers_size += buffer.committed();
+        buffers_capacity += buffer.capacity();
+        osmium::apply(buffer, *this);
+    }
+
+    void changeset(const osmium::Changeset& changeset) {
+        check_order(osmium::item_type::changeset, changeset.id());
+
         if (calculate_crc) {
             crc32.update(changeset);
         }
@@ -131,19 +212,7 @@ struct InfoHandler : public osmium::handler::Handler {
         metadata_all_objects &= osmium::detect_available_metadata(object);
         metadata_some_objects |= osmium::detect_available_metadata(object);
 
-        if (last_type == object.type()) {
-            if (last_id == object.id()) {
-                multiple_versions = true;
-            }
-            if (osmium::id_order{}(object.id(), last_id)) {
-                ordered = false;
-            }
-        } else if (last_type != osmium::item_type::changeset && last_type > object.type()) {
-            ordered = false;
-        }
-
-        last_type = object.type();
-        last_id = object.id();
+        check_order(object.type(), object.id());
     }
 
     void node(const osmium::Node& node) {
@@ -177,6 +246,74 @@ struct InfoHandler : public osmium::handler::Handler {
         largest_relation_id.update(relation.id());
     }
 
+    // Initialize from statistics read from a sidecar file. Only the
+    // values available there are set.
+    void set_from_stats(const FileStats& stats) {
+        bounds = stats.bounds();
+
+        first_timestamp.update(stats.first_timestamp());
+        last_timestamp.update(stats.last_timestamp());
+
+        changesets = stats.counter(osmium::item_type::changeset).count;
+        nodes      = stats.counter(osmium::item_type::node).count;
+        ways       = stats.counter(osmium::item_type::way).count;
+        relations  = stats.counter(osmium::item_type::relation).count;
+
+        smallest_changeset_id.update(stats.counter(osmium::item_type::changeset).min_id());
+        smallest_node_id.update(stats.counter(osmium::item_type::node).min_id());
+        smallest_way_id.update(stats.counter(osmium::item_type::way).min_id());
+        smallest_relation_id.update(stats.counter(osmium::item_type::relation).min_id());
+
+        largest_changeset_id.update(stats.counter(osmium::item_type::changeset).max_id());
+        largest_node_id.update(stats.counter(osmium::item_type::node).max_id());
+        largest_way_id.update(stats.counter(osmium::item_type::way).max_id());
+        largest_relation_id.update(stats.counter(osmium::item_type::relation).max_id());
+    }
+
+    // Add the statistics of the data directly following the data
+    // collected in this handler.
+    void merge(const InfoHandler& other) {
+        bounds.extend(other.bounds);
+
+        changesets += other.changesets;
+        nodes      += other.nodes;
+        ways       += other.ways;
+        relations  += other.relations;
+
+        buffers_count    += other.buffers_count;
+        buffers_size     += other.buffers_size;
+        buffers_capacity += other.buffers_capacity;
+
+        smallest_changeset_id.update(other.smallest_changeset_id());
+        smallest_node_id.update(other.smallest_node_id());
+        smallest_way_id.update(other.smallest_way_id());
+        smallest_relation_id.update(other.smallest_relation_id());
+
+        largest_changeset_id.update(other.largest_changeset_id());
+        largest_node_id.update(other.largest_node_id());
+        largest_way_id.update(other.largest_way_id());
+        largest_relation_id.update(other.largest_relation_id());
+
+        metadata_all_objects &= other.metadata_all_objects;
+        metadata_some_objects |= other.metadata_some_objects;
+
+        first_timestamp.update(other.first_timestamp());
+        last_timestamp.update(other.last_timestamp());
+
+        if (calculate_crc) {
+            crc32().combine(other.crc32());
+        }
+
+        if (other.last_type != osmium::item_type::undefined) {
+            check_order(other.first_type, other.first_id);
+            last_type = other.last_type;
+            last_id = other.last_id;
+        }
+
+        ordered = ordered && other.ordered;
+        multiple_versions = multiple_versions || other.multiple_versions;
+    }
+
 }; // struct InfoHandler
 
 class Output {
@@ -727,6 +864,7 @@ bool CommandFileinfo::setup(const std::vector<std::string>& arguments) {
     ("json,j", "JSON output")
     ("crc,c", "Calculate CRC")
     ("no-crc", "Do not calculate CRC")
+    ("ignore-stats", "Do not use statistics from sidecar file")
     ("object-type,t", po::value<std::vector<std::string>>(), "Read only objects of given type (node, way, relation, changeset)")
     ;
 
@@ -765,6 +903,10 @@ bool CommandFileinfo::setup(const std::vector<std::string>& arguments) {
         m_json_output = true;
     }
 
+    if (vm.count("ignore-stats")) {
+        m_ignore_stats = true;
+    }
+
     if (vm.count("crc") && vm.count("no-crc")) {
         throw argument_error{"Can not use --crc/-c option and --no-crc at the same time."};
     }
@@ -855,6 +997,38 @@ void CommandFileinfo::show_arguments() {
     show_object_types(m_vout);
     m_vout << "    extended output: " << (m_extended ? "yes\n" : "no\n");
     m_vout << "    calculate CRC: " << (m_calculate_crc ? "yes\n" : "no\n");
+    m_vout << "    use stats file: " << (m_ignore_stats ? "no\n" : "yes\n");
+}
+
+// These are the values available from the sidecar stats file.
+static bool is_available_from_stats(const std::string& get_value) {
+    return get_value == "data.bbox" ||
+           get_value.substr(0, 15) == "data.timestamp." ||
+           get_value.substr(0, 11) == "data.count." ||
+           get_value.substr(0, 11) == "data.minid." ||
+           get_value.substr(0, 11) == "data.maxid.";
+}
+
+bool CommandFileinfo::data_from_stats_file(Output& output) {
+    if (m_ignore_stats || m_get_value.empty() || any_input_is_stdin() ||
+        osm_entity_bits() != osmium::osm_entity_bits::all ||
+        !is_available_from_stats(m_get_value)) {
+        return false;
+    }
+
+    FileStats stats;
+    if (!stats.read(m_input_file.filename())) {
+        m_vout << "No usable stats file found. Reading the whole file.\n";
+        return false;
+    }
+
+    m_vout << "Using data from stats file '" << stats_filename(m_input_file.filename()) << "'.\n";
+
+    InfoHandler info_handler{false};
+    info_handler.set_from_stats(stats);
+    output.data(osmium::io::Header{}, info_handler);
+
+    return true;
 }
 
 bool CommandFileinfo::run() {
@@ -870,21 +1044,50 @@ bool CommandFileinfo::run() {
     output->set_crc(m_calculate_crc);
     output->file(m_input_filename, m_input_file);
 
+    if (data_from_stats_file(*output)) {
+        output->output();
+        m_vout << "Done.\n";
+        return true;
+    }
+
     osmium::io::Reader reader{m_input_file, m_extended ? osm_entity_bits() : osmium::osm_entity_bits::nothing};
     const osmium::io::Header header{reader.header()};
     output->header(header);
 
     if (m_extended) {
+        // The statistics for each buffer are collected on the worker
+        // threads and merged in the order the buffers were read.
         InfoHandler info_handler{m_calculate_crc};
+        std::deque<std::future<InfoHandler>> pending;
+        auto& pool = osmium::thread::Pool::default_instance();
+        const bool with_crc = m_calculate_crc;
+
         osmium::ProgressBar progress_bar{reader.file_size(), display_progress()};
-        while (osmium::memory::Buffer buffer = reader.read()) {
+        auto& process_stage = stage("process");
+        while (osmium::memory::Buffer buffer = read_buffer(reader)) {
             progress_bar.update(reader.offset());
-            ++info_handler.buffers_count;
-            info_handler.buffers_size += buffer.committed();
-            info_handler.buffers_capacity += buffer.capacity();
-            osmium::apply(buffer, info_handler);
+            pending.push_back(pool.submit([buffer = std::move(buffer), with_crc]() mutable {
+                InfoHandler handler{with_crc};
+                handler.add_buffer(buffer);
+                return handler;
+            }));
+            if (pending.size() > max_pending_buffers) {
+                const StageTimer timer{process_stage};
+                info_handler.merge(pending.front().get());
+                pending.pop_front();
+            }
+        }
+        {
+            const StageTimer timer{process_stage};
+            for (auto& future : pending) {
+                info_handler.merge(future.get());
+            }
         }
         progress_bar.done();
+
+        process_stage.bytes_in = info_handler.buffers_size;
+        process_stage.buffers = info_handler.buffers_count;
+        process_stage.objects = info_handler.changesets + info_handler.nodes + info_handler.ways + info_handler.relations;
         output->data(header, info_handler);
     }
 
@@ -28,12 +28,17 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <string>
 #include <vector>
 
+class Output;
+
 class CommandFileinfo : public CommandWithSingleOSMInput {
 
     std::string m_get_value;
     bool m_extended = false;
     bool m_json_output = false;
     bool m_calculate_crc = false;
+    bool m_ignore_stats = false;
+
+    bool data_from_stats_file(Output& output);
 
 public:
 
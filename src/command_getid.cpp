@@ -39,9 +39,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <boost/program_options.hpp>
 
+#include <algorithm>
 #include <cstddef>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <utility>
@@ -219,6 +221,53 @@ osmium::osm_entity_bits::type CommandGetId::get_needed_types() const {
     return types;
 }
 
+// Blocks from the PBF index which might contain objects with the IDs we
+// are looking for.
+std::vector<PBFBlock> CommandGetId::blocks_with_ids(osmium::osm_entity_bits::type types) const {
+    osmium::nwr_array<std::vector<osmium::object_id_type>> ids;
+    for (const auto type : {osmium::item_type::node, osmium::item_type::way, osmium::item_type::relation}) {
+        for (const auto id : m_ids(type)) {
+            ids(type).push_back(static_cast<osmium::object_id_type>(id));
+        }
+    }
+
+    return m_index.find_blocks(types, [&](const PBFBlock& block) {
+        // The set contains only positive IDs.
+        if (block.min_id <= 0) {
+            return true;
+        }
+        for (const auto type : {osmium::item_type::node, osmium::item_type::way, osmium::item_type::relation}) {
+            if (block.types & types & osmium::osm_entity_bits::from_item_type(type)) {
+                const auto it = std::lower_bound(ids(type).cbegin(), ids(type).cend(), block.min_id);
+                if (it != ids(type).cend() && *it <= block.max_id) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    });
+}
+
+// Read the objects of the specified types from the input file. If there
+// is a PBF index for the input file, only the blocks containing objects
+// of those types are read (and only those which might contain the IDs we
+// are looking for, if only_blocks_with_ids is set).
+void CommandGetId::read_input(osmium::osm_entity_bits::type types, bool only_blocks_with_ids,
+                              const std::function<void(osmium::memory::Buffer&)>& func) {
+    if (m_has_index) {
+        PBFBlockReader reader{m_input_file.filename(),
+                              only_blocks_with_ids ? blocks_with_ids(types) : m_index.find_blocks(types),
+                              types,
+                              osmium::io::read_meta::no};
+        while (osmium::memory::Buffer buffer = reader.read()) {
+            func(buffer);
+        }
+        return;
+    }
+
+    read_osm_file(m_input_file, types, osmium::io::read_meta::no, func);
+}
+
 static void print_missing_ids(const char* type, const osmium::index::IdSetDense<osmium::unsigned_object_id_type>& set) {
     if (set.empty()) {
         return;
@@ -242,8 +291,7 @@ bool CommandGetId::find_relations_in_relations() {
     m_vout << "  Reading input file to find relations in relations...\n";
     osmium::index::RelationsMapStash stash;
 
-    osmium::io::Reader reader{m_input_file, osmium::osm_entity_bits::relation, osmium::io::read_meta::no};
-    while (osmium::memory::Buffer buffer = reader.read()) {
+    read_input(osmium::osm_entity_bits::relation, false, [&](osmium::memory::Buffer& buffer) {
         for (const auto& relation : buffer.select<osmium::Relation>()) {
             for (const auto& member : relation.members()) {
                 if (member.type() == osmium::item_type::relation) {
@@ -257,8 +305,7 @@ bool CommandGetId::find_relations_in_relations() {
                 }
             }
         }
-    }
-    reader.close();
+    });
 
     if (stash.empty()) {
         return false;
@@ -275,8 +322,7 @@ bool CommandGetId::find_relations_in_relations() {
 void CommandGetId::find_nodes_and_ways_in_relations() {
     m_vout << "  Reading input file to find nodes/ways in relations...\n";
 
-    osmium::io::Reader reader{m_input_file, osmium::osm_entity_bits::relation, osmium::io::read_meta::no};
-    while (osmium::memory::Buffer buffer = reader.read()) {
+    read_input(osmium::osm_entity_bits::relation, true, [&](osmium::memory::Buffer& buffer) {
         for (const auto& relation : buffer.select<osmium::Relation>()) {
             if (m_ids(osmium::item_type::relation).get(relation.positive_id())) {
                 for (const auto& member : relation.members()) {
@@ -288,22 +334,19 @@ void CommandGetId::find_nodes_and_ways_in_relations() {
                 }
             }
         }
-    }
-    reader.close();
+    });
 }
 
 void CommandGetId::find_nodes_in_ways() {
     m_vout << "  Reading input file to find nodes in ways...\n";
 
-    osmium::io::Reader reader{m_input_file, osmium::osm_entity_bits::way, osmium::io::read_meta::no};
-    while (osmium::memory::Buffer buffer = reader.read()) {
+    read_input(osmium::osm_entity_bits::way, true, [&](osmium::memory::Buffer& buffer) {
         for (const auto& way : buffer.select<osmium::Way>()) {
             if (m_ids(osmium::item_type::way).get(way.positive_id())) {
                 add_nodes(way, m_ids);
             }
         }
-    }
-    reader.close();
+    });
 }
 
 void CommandGetId::find_referenced_objects() {
@@ -331,12 +374,21 @@ void CommandGetId::find_referenced_objects() {
 }
 
 bool CommandGetId::run() {
+    m_has_index = open_pbf_index(m_input_file, m_index);
+    if (m_has_index) {
+        m_vout << "Using block index '" << pbf_index_filename(m_input_file.filename()) << "'.\n";
+    }
+
     if (m_add_referenced_objects) {
         find_referenced_objects();
     }
 
+    // With a block index the reader is only used for the header, the
+    // objects are read from the blocks which might contain them. Local
+    // PBF files without index are read through a memory mapping.
+    const bool use_block_reader = m_has_index || PBFBlockReader::can_map(m_input_file);
     m_vout << "Opening input file...\n";
-    osmium::io::Reader reader{m_input_file, get_needed_types()};
+    osmium::io::Reader reader{m_input_file, use_block_reader ? osmium::osm_entity_bits::nothing : get_needed_types()};
 
     m_vout << "Opening output file...\n";
     osmium::io::Header header{reader.header()};
@@ -344,10 +396,27 @@ bool CommandGetId::run() {
 
     osmium::io::Writer writer{m_output_file, header, m_output_overwrite, m_fsync};
 
+    std::unique_ptr<PBFBlockReader> block_reader;
+    if (m_has_index) {
+        const auto blocks = blocks_with_ids(get_needed_types());
+        m_vout << "Reading " << blocks.size() << " of " << m_index.blocks().size() << " blocks.\n";
+        block_reader = std::make_unique<PBFBlockReader>(m_input_file.filename(), blocks, get_needed_types());
+    } else if (use_block_reader) {
+        block_reader = std::make_unique<PBFBlockReader>(m_input_file, get_needed_types());
+    }
+
+    const auto read = [&]() {
+        return block_reader ? block_reader->read() : reader.read();
+    };
+
+    const auto offset = [&]() {
+        return block_reader ? block_reader->offset() : reader.offset();
+    };
+
     m_vout << "Copying matching objects to output file...\n";
     osmium::ProgressBar progress_bar{reader.file_size(), display_progress()};
-    while (osmium::memory::Buffer buffer = reader.read()) {
-        progress_bar.update(reader.offset());
+    while (osmium::memory::Buffer buffer = read()) {
+        progress_bar.update(offset());
         for (auto& object : buffer.select<osmium::OSMObject>()) {
             if (m_matching_ids(object.type()).get(object.positive_id())) {
                 if (!m_work_with_history) {
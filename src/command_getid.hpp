@@ -24,6 +24,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "cmd.hpp" // IWYU pragma: export
+#include "pbf_index.hpp"
 
 #include <osmium/fwd.hpp>
 #include <osmium/index/id_set.hpp>
@@ -34,6 +35,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/osm/types.hpp>
 
 #include <cstddef>
+#include <functional>
 #include <iosfwd>
 #include <string>
 #include <vector>
@@ -45,6 +47,9 @@ class CommandGetId : public CommandWithSingleOSMInput, public with_osm_output {
 
     osmium::item_type m_default_item_type = osmium::item_type::node;
 
+    PBFIndex m_index;
+    bool m_has_index = false;
+
     bool m_add_referenced_objects = false;
     bool m_work_with_history = false;
     bool m_remove_tags = false;
@@ -53,6 +58,10 @@ class CommandGetId : public CommandWithSingleOSMInput, public with_osm_output {
     osmium::osm_entity_bits::type get_needed_types() const;
     std::size_t count_ids() const noexcept;
 
+    std::vector<PBFBlock> blocks_with_ids(osmium::osm_entity_bits::type types) const;
+    void read_input(osmium::osm_entity_bits::type types, bool only_blocks_with_ids,
+                    const std::function<void(osmium::memory::Buffer&)>& func);
+
     void find_referenced_objects();
 
     void mark_rel_ids(const osmium::index::RelationsMapIndex& rel_in_rel, osmium::unsigned_object_id_type parent_id);
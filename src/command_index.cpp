@@ -0,0 +1,106 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "command_index.hpp"
+
+#include "exception.hpp"
+#include "pbf_index.hpp"
+#include "util.hpp"
+
+#include <osmium/io/file_format.hpp>
+#include <osmium/util/file.hpp>
+#include <osmium/util/progress_bar.hpp>
+#include <osmium/util/verbose_output.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <vector>
+
+bool CommandIndex::setup(const std::vector<std::string>& arguments) {
+    const po::options_description opts_common{add_common_options()};
+    const po::options_description opts_input{add_single_input_options()};
+
+    po::options_description hidden;
+    hidden.add_options()
+    ("input-filename", po::value<std::string>(), "OSM PBF file")
+    ;
+
+    po::options_description desc;
+    desc.add(opts_common).add(opts_input);
+
+    po::options_description parsed_options;
+    parsed_options.add(desc).add(hidden);
+
+    po::positional_options_description positional;
+    positional.add("input-filename", 1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(arguments).options(parsed_options).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (!setup_common(vm, desc)) {
+        return false;
+    }
+    setup_progress(vm);
+    setup_input_file(vm);
+
+    if (m_input_filename.empty() || m_input_filename == "-") {
+        throw argument_error{"Can not create index for data read from STDIN."};
+    }
+
+    if (m_input_file.format() != osmium::io::file_format::pbf) {
+        throw argument_error{"The index command only works on PBF files."};
+    }
+
+    return true;
+}
+
+void CommandIndex::show_arguments() {
+    show_single_input_arguments(m_vout);
+    m_vout << "  other options:\n";
+    m_vout << "    index file: " << pbf_index_filename(m_input_filename) << "\n";
+}
+
+bool CommandIndex::run() {
+    m_vout << "Creating index...\n";
+    PBFIndex index;
+    {
+        const StageTimer timer{stage("read")};
+        osmium::ProgressBar progress_bar{osmium::file_size(m_input_filename), display_progress()};
+        index.create(m_input_filename, &progress_bar);
+        progress_bar.done();
+        stage("read").bytes_in += osmium::file_size(m_input_filename);
+        for (const auto& block : index.blocks()) {
+            stage("read").objects += block.count;
+        }
+    }
+
+    m_vout << "Writing index file...\n";
+    index.write(m_input_filename);
+    m_vout << "Wrote " << index.blocks().size() << " blocks to index file.\n";
+
+    show_memory_used();
+    m_vout << "Done.\n";
+
+    return true;
+}
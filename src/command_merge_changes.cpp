@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "command_merge_changes.hpp"
 
+#include "buffer_compactor.hpp"
 #include "util.hpp"
 
 #include <osmium/io/file.hpp>
@@ -104,20 +105,25 @@ bool CommandMergeChanges::run() {
 
     osmium::ObjectPointerCollection objects;
 
-    // read all input files, keep the buffers around and add pointer
-    // to each object to objects collection.
+    // read all input files, keep the (compacted) buffers around and add
+    // pointer to each object to objects collection.
+    BufferCompactor compactor{[&](osmium::memory::Buffer&& buffer) {
+        osmium::apply(buffer, objects);
+        changes.push_back(std::move(buffer));
+    }};
+
     m_vout << "Reading change file contents...\n";
     osmium::ProgressBar progress_bar{file_size_sum(m_input_files), display_progress()};
     for (const osmium::io::File& change_file : m_input_files) {
         osmium::io::Reader reader{change_file, osmium::osm_entity_bits::object};
         while (osmium::memory::Buffer buffer = reader.read()) {
             progress_bar.update(reader.offset());
-            osmium::apply(buffer, objects);
-            changes.push_back(std::move(buffer));
+            compactor.add(std::move(buffer));
         }
         progress_bar.file_done(reader.file_size());
         reader.close();
     }
+    compactor.flush();
     progress_bar.done();
 
     // Now we sort all objects and write them in order into the
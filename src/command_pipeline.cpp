@@ -0,0 +1,188 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "command_pipeline.hpp"
+
+#include "exception.hpp"
+#include "util.hpp"
+
+#include <osmium/io/header.hpp>
+#include <osmium/io/reader.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/util/progress_bar.hpp>
+#include <osmium/util/verbose_output.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+void CommandPipeline::setup_stages(const std::vector<std::string>& stage_list) {
+    // Each stage has to be given as one (quoted) argument if it has any
+    // options, otherwise the options would be parsed as options of the
+    // pipeline command and rejected. Other arguments of a stage, like
+    // filter expressions, can also be given separately. Stages are
+    // separated by '!', as separate argument or inside a quoted one.
+    std::vector<std::string> words;
+    const auto add_stage = [&]() {
+        if (words.empty()) {
+            throw argument_error{"Empty stage in pipeline."};
+        }
+        m_stages.push_back(create_pipeline_stage(words));
+        words.clear();
+    };
+
+    for (const auto& argument : stage_list) {
+        for (auto& word : po::split_unix(argument)) {
+            if (word == "!") {
+                add_stage();
+            } else {
+                words.push_back(std::move(word));
+            }
+        }
+    }
+    add_stage();
+}
+
+bool CommandPipeline::setup(const std::vector<std::string>& arguments) {
+    po::options_description opts_cmd{"COMMAND OPTIONS"};
+    opts_cmd.add_options()
+    ("write-index", "Write block index to sidecar file (OUTPUT-FILE.idx)")
+    ("spill-size", po::value<std::size_t>(), "MBytes of input a stage keeps in memory before using temporary files (default: 1024)")
+    ;
+
+    const po::options_description opts_common{add_common_options()};
+    const po::options_description opts_input{add_single_input_options()};
+    const po::options_description opts_output{add_output_options()};
+
+    po::options_description hidden;
+    hidden.add_options()
+    ("input-filename", po::value<std::string>(), "OSM input file")
+    ("stage-list", po::value<std::vector<std::string>>(), "Pipeline stages")
+    ;
+
+    po::options_description desc;
+    desc.add(opts_cmd).add(opts_common).add(opts_input).add(opts_output);
+
+    po::options_description parsed_options;
+    parsed_options.add(desc).add(hidden);
+
+    po::positional_options_description positional;
+    positional.add("input-filename", 1);
+    positional.add("stage-list", -1);
+
+    po::variables_map vm;
+    po::store(po::command_line_parser(arguments).options(parsed_options).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (!setup_common(vm, desc)) {
+        return false;
+    }
+    setup_progress(vm);
+    setup_input_file(vm);
+    setup_output_file(vm);
+
+    if (!vm.count("stage-list")) {
+        throw argument_error{"Missing pipeline stages on command line."};
+    }
+
+    if (vm.count("spill-size")) {
+        m_spill_size = vm["spill-size"].as<std::size_t>() * 1024UL * 1024UL;
+    }
+
+    setup_stages(vm["stage-list"].as<std::vector<std::string>>());
+    for (const auto& stage : m_stages) {
+        stage->set_spill_size(m_spill_size);
+    }
+
+    return true;
+}
+
+void CommandPipeline::show_arguments() {
+    show_single_input_arguments(m_vout);
+    show_output_arguments(m_vout);
+
+    m_vout << "  spill size: " << show_mbytes(m_spill_size) << " MBytes\n";
+    m_vout << "  pipeline stages:\n";
+    for (const auto& stage : m_stages) {
+        m_vout << "    " << stage->name() << (stage->holds_input() ? " (keeps input until the end)\n" : "\n");
+        stage->show_arguments(m_vout);
+    }
+}
+
+bool CommandPipeline::run() {
+    m_vout << "Opening input file...\n";
+    osmium::io::Reader reader{m_input_file};
+
+    osmium::io::Header header{reader.header()};
+    setup_header(header);
+    for (const auto& stage : m_stages) {
+        stage->setup_output(m_output_file, header);
+    }
+
+    m_vout << "Opening output file...\n";
+    osmium::io::Writer writer{m_output_file, header, m_output_overwrite, m_fsync};
+
+    // Connect each stage to the next one, the last one to the writer.
+    for (std::size_t n = 0; n + 1 < m_stages.size(); ++n) {
+        PipelineStage* next = m_stages[n + 1].get();
+        m_stages[n]->set_output([next](osmium::memory::Buffer&& buffer) {
+            next->process(std::move(buffer));
+        });
+    }
+    m_stages.back()->set_output([&](osmium::memory::Buffer&& buffer) {
+        write_buffer(writer, std::move(buffer));
+    });
+
+    m_vout << "Running pipeline...\n";
+    osmium::ProgressBar progress_bar{reader.file_size(), display_progress()};
+    while (osmium::memory::Buffer buffer = read_buffer(reader)) {
+        progress_bar.update(reader.offset());
+        m_stages.front()->process(std::move(buffer));
+    }
+    progress_bar.done();
+    reader.close();
+
+    for (const auto& stage : m_stages) {
+        if (stage->holds_input()) {
+            m_vout << "Finishing stage '" << stage->name() << "'...\n";
+        }
+        stage->finish();
+    }
+
+    m_vout << "Closing output file...\n";
+    close_writer(writer);
+    write_output_index();
+
+    for (const auto& stage : m_stages) {
+        if (stage->used_memory() > 0) {
+            add_index_memory(stage->name(), stage->used_memory());
+        }
+    }
+
+    show_memory_used();
+    m_vout << "Done.\n";
+
+    return true;
+}
@@ -141,17 +141,17 @@ static osmium::object_id_type get_start_id(const std::string& s) {
     return id;
 }
 
-void CommandRenumber::set_start_ids(const std::string& str) {
+void set_start_ids(osmium::nwr_array<id_map>& id_maps, const std::string& str) {
     const auto start_ids = osmium::split_string(str, ',');
     if (start_ids.size() == 1) {
         const auto id = get_start_id(start_ids[0]);
-        m_id_map(osmium::item_type::node).set_start_id(id);
-        m_id_map(osmium::item_type::way).set_start_id(id);
-        m_id_map(osmium::item_type::relation).set_start_id(id);
+        id_maps(osmium::item_type::node).set_start_id(id);
+        id_maps(osmium::item_type::way).set_start_id(id);
+        id_maps(osmium::item_type::relation).set_start_id(id);
     } else if (start_ids.size() == 3) {
-        m_id_map(osmium::item_type::node).set_start_id(get_start_id(start_ids[0]));
-        m_id_map(osmium::item_type::way).set_start_id(get_start_id(start_ids[1]));
-        m_id_map(osmium::item_type::relation).set_start_id(get_start_id(start_ids[2]));
+        id_maps(osmium::item_type::node).set_start_id(get_start_id(start_ids[0]));
+        id_maps(osmium::item_type::way).set_start_id(get_start_id(start_ids[1]));
+        id_maps(osmium::item_type::relation).set_start_id(get_start_id(start_ids[2]));
     } else {
         throw argument_error{"The --start-id/s option must be followed by exactly 1 ID or 3 IDs separated by commas"};
     }
@@ -224,7 +224,7 @@ bool CommandRenumber::setup(const std::vector<std::string>& arguments) {
     setup_output_file(vm);
 
     if (vm.count("start-id")) {
-        set_start_ids(vm["start-id"].as<std::string>());
+        set_start_ids(m_id_map, vm["start-id"].as<std::string>());
     }
 
     return true;
@@ -351,7 +351,7 @@ void CommandRenumber::read_start_ids_file() {
         std::string line;
         start_id_file >> line;
         start_id_file.close();
-        set_start_ids(line);
+        set_start_ids(m_id_map, line);
     }
 }
 
@@ -99,6 +99,15 @@ public:
 
 }; // class id_map
 
+/**
+ * Set the start IDs of the ID maps from a string with a single ID used
+ * for all object types or three IDs for nodes, ways, and relations
+ * separated by commas. An ID of 0 means the default of 1.
+ *
+ * @throws argument_error If the string has the wrong number of IDs.
+ */
+void set_start_ids(osmium::nwr_array<id_map>& id_maps, const std::string& str);
+
 class CommandRenumber : public CommandWithSingleOSMInput, public with_osm_output {
 
     std::string m_index_directory;
@@ -112,8 +121,6 @@ class CommandRenumber : public CommandWithSingleOSMInput, public with_osm_output
 
     std::string filename(const char* name) const;
 
-    void set_start_ids(const std::string& str);
-
     void read_start_ids_file();
 
     void read_index(osmium::item_type type);
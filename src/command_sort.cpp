@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "command_sort.hpp"
 
+#include "buffer_compactor.hpp"
 #include "exception.hpp"
 #include "util.hpp"
 
@@ -46,6 +47,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <vector>
 
 bool CommandSort::setup(const std::vector<std::string>& arguments) {
+    po::options_description opts_cmd{"COMMAND OPTIONS"};
+    opts_cmd.add_options()
+    ("write-stats", "Write statistics to sidecar file (OUTPUT-FILE.stats)")
+    ("write-index", "Write block index to sidecar file (OUTPUT-FILE.idx)")
+    ;
+
     const po::options_description opts_common{add_common_options()};
     const po::options_description opts_input{add_multiple_inputs_options()};
     const po::options_description opts_output{add_output_options()};
@@ -57,7 +64,7 @@ bool CommandSort::setup(const std::vector<std::string>& arguments) {
     ;
 
     po::options_description desc;
-    desc.add(opts_common).add(opts_input).add(opts_output);
+    desc.add(opts_cmd).add(opts_common).add(opts_input).add(opts_output);
 
     po::options_description parsed_options;
     parsed_options.add(desc).add(hidden);
@@ -108,23 +115,29 @@ bool CommandSort::run_single_pass() {
     uint64_t buffers_size = 0;
     uint64_t buffers_capacity = 0;
 
+    BufferCompactor compactor{[&](osmium::memory::Buffer&& buffer) {
+        ++buffers_count;
+        buffers_size += buffer.committed();
+        buffers_capacity += buffer.capacity();
+        osmium::apply(buffer, objects);
+        data.push_back(std::move(buffer));
+    }};
+
     m_vout << "Reading contents of input files...\n";
     osmium::ProgressBar progress_bar{file_size_sum(m_input_files), display_progress()};
     for (const std::string& file_name : m_filenames) {
         osmium::io::Reader reader{file_name, osmium::osm_entity_bits::object};
         const osmium::io::Header header{reader.header()};
         bounding_box.extend(header.joined_boxes());
-        while (osmium::memory::Buffer buffer = reader.read()) {
-            ++buffers_count;
-            buffers_size += buffer.committed();
-            buffers_capacity += buffer.capacity();
+        while (osmium::memory::Buffer buffer = read_buffer(reader)) {
             progress_bar.update(reader.offset());
-            osmium::apply(buffer, objects);
-            data.push_back(std::move(buffer));
+            update_output_stats(buffer);
+            compactor.add(std::move(buffer));
         }
         progress_bar.file_done(reader.file_size());
         reader.close();
     }
+    compactor.flush();
     progress_bar.done();
 
     m_vout << "Number of buffers: " << buffers_count << "\n";
@@ -148,14 +161,23 @@ bool CommandSort::run_single_pass() {
     osmium::io::Writer writer{m_output_file, header, m_output_overwrite, m_fsync};
 
     m_vout << "Sorting data...\n";
-    objects.sort(osmium::object_order_type_id_version());
+    {
+        const StageTimer timer{stage("sort")};
+        objects.sort(osmium::object_order_type_id_version());
+    }
 
     m_vout << "Writing out sorted data...\n";
-    auto out = osmium::io::make_output_iterator(writer);
-    std::copy(objects.begin(), objects.end(), out);
+    {
+        const StageTimer timer{stage("write")};
+        stage("write").objects += objects.size();
+        auto out = osmium::io::make_output_iterator(writer);
+        std::copy(objects.begin(), objects.end(), out);
+    }
 
     m_vout << "Closing output file...\n";
-    writer.close();
+    close_writer(writer);
+    write_output_stats();
+    write_output_index();
 
     show_memory_used();
     m_vout << "Done.\n";
@@ -194,23 +216,29 @@ bool CommandSort::run_multi_pass() {
         uint64_t buffers_size = 0;
         uint64_t buffers_capacity = 0;
 
+        BufferCompactor compactor{[&](osmium::memory::Buffer&& buffer) {
+            ++buffers_count;
+            buffers_size += buffer.committed();
+            buffers_capacity += buffer.capacity();
+            osmium::apply(buffer, objects);
+            data.push_back(std::move(buffer));
+        }};
+
         m_vout << "Pass " << pass++ << "...\n";
         m_vout << "Reading contents of input files...\n";
         for (const std::string& file_name : m_filenames) {
             osmium::io::Reader reader{file_name, entity};
             const osmium::io::Header read_header{reader.header()};
             bounding_box.extend(read_header.joined_boxes());
-            while (osmium::memory::Buffer buffer = reader.read()) {
-                ++buffers_count;
-                buffers_size += buffer.committed();
-                buffers_capacity += buffer.capacity();
+            while (osmium::memory::Buffer buffer = read_buffer(reader)) {
                 progress_bar.update(reader.offset());
-                osmium::apply(buffer, objects);
-                data.push_back(std::move(buffer));
+                update_output_stats(buffer);
+                compactor.add(std::move(buffer));
             }
             progress_bar.file_done(reader.file_size());
             reader.close();
         }
+        compactor.flush();
 
         if (m_vout.verbose()) {
             progress_bar.remove();
@@ -228,17 +256,26 @@ bool CommandSort::run_multi_pass() {
         }
 
         m_vout << "Sorting data...\n";
-        objects.sort(osmium::object_order_type_id_version());
+        {
+            const StageTimer timer{stage("sort")};
+            objects.sort(osmium::object_order_type_id_version());
+        }
 
         m_vout << "Writing out sorted data...\n";
-        auto out = osmium::io::make_output_iterator(writer);
-        std::copy(objects.begin(), objects.end(), out);
+        {
+            const StageTimer timer{stage("write")};
+            stage("write").objects += objects.size();
+            auto out = osmium::io::make_output_iterator(writer);
+            std::copy(objects.begin(), objects.end(), out);
+        }
     }
 
     progress_bar.done();
 
     m_vout << "Closing output file...\n";
-    writer.close();
+    close_writer(writer);
+    write_output_stats();
+    write_output_index();
 
     show_memory_used();
     m_vout << "Done.\n";
@@ -23,6 +23,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "command_tags_filter.hpp"
 
 #include "exception.hpp"
+#include "pbf_index.hpp"
 #include "util.hpp"
 
 #include <osmium/index/relations_map.hpp>
@@ -31,59 +32,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/io/writer.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/osm.hpp>
-#include <osmium/tags/taglist.hpp>
 #include <osmium/util/progress_bar.hpp>
 #include <osmium/util/verbose_output.hpp>
 
 #include <boost/program_options.hpp>
 
-#include <fstream>
 #include <string>
 #include <utility>
 #include <vector>
 
-void CommandTagsFilter::add_filter(osmium::osm_entity_bits::type entities, const osmium::TagMatcher& matcher) {
-    if (entities & osmium::osm_entity_bits::node) {
-        m_filters(osmium::item_type::node).add_rule(true, matcher);
-    }
-    if (entities & osmium::osm_entity_bits::way) {
-        m_filters(osmium::item_type::way).add_rule(true, matcher);
-    }
-    if (entities & osmium::osm_entity_bits::relation) {
-        m_filters(osmium::item_type::relation).add_rule(true, matcher);
-    }
-    if (entities & osmium::osm_entity_bits::area) {
-        m_area_filters.add_rule(true, matcher);
-    }
-}
-
-void CommandTagsFilter::parse_and_add_expression(const std::string& expression) {
-    const auto p = get_filter_expression(expression);
-    add_filter(p.first, get_tag_matcher(p.second));
-}
-
-void CommandTagsFilter::read_expressions_file(const std::string& file_name) {
-    m_vout << "Reading expressions file...\n";
-
-    std::ifstream file{file_name};
-    if (!file.is_open()) {
-        throw argument_error{"Could not open file '" + file_name + "'"};
-    }
-
-    for (std::string line; std::getline(file, line);) {
-        const auto pos = line.find_first_of('#');
-        if (pos != std::string::npos) {
-            line.erase(pos);
-        }
-        if (!line.empty()) {
-            if (line.back() == '\r') {
-                line.resize(line.size() - 1);
-            }
-            parse_and_add_expression(line);
-        }
-    }
-}
-
 bool CommandTagsFilter::setup(const std::vector<std::string>& arguments) {
     po::options_description opts_cmd{"COMMAND OPTIONS"};
     opts_cmd.add_options()
@@ -140,12 +97,13 @@ bool CommandTagsFilter::setup(const std::vector<std::string>& arguments) {
 
     if (vm.count("expression-list")) {
         for (const auto& e : vm["expression-list"].as<std::vector<std::string>>()) {
-            parse_and_add_expression(e);
+            m_rules.add_expression(e);
         }
     }
 
     if (vm.count("expressions")) {
-        read_expressions_file(vm["expressions"].as<std::string>());
+        m_vout << "Reading expressions file...\n";
+        m_rules.read_expressions_file(vm["expressions"].as<std::string>());
     }
 
     return true;
@@ -162,9 +120,9 @@ void CommandTagsFilter::show_arguments() {
         m_vout << "    remove tags on non-matching objects: " << yes_no(m_remove_tags);
     }
     m_vout << "  looking for tags...\n";
-    m_vout << "    on nodes: "     << yes_no(!m_filters(osmium::item_type::node).empty());
-    m_vout << "    on ways: "      << yes_no(!m_filters(osmium::item_type::way).empty() || !m_area_filters.empty());
-    m_vout << "    on relations: " << yes_no(!m_filters(osmium::item_type::relation).empty() || !m_area_filters.empty());
+    m_vout << "    on nodes: "     << yes_no(m_rules.has_rules_for(osmium::item_type::node));
+    m_vout << "    on ways: "      << yes_no(m_rules.has_rules_for(osmium::item_type::way));
+    m_vout << "    on relations: " << yes_no(m_rules.has_rules_for(osmium::item_type::relation));
 }
 
 osmium::osm_entity_bits::type CommandTagsFilter::get_needed_types() const {
@@ -174,13 +132,13 @@ osmium::osm_entity_bits::type CommandTagsFilter::get_needed_types() const {
 
     osmium::osm_entity_bits::type types = osmium::osm_entity_bits::nothing;
 
-    if (!m_referenced_ids(osmium::item_type::node).empty() || !m_filters(osmium::item_type::node).empty()) {
+    if (!m_referenced_ids(osmium::item_type::node).empty() || m_rules.has_rules_for(osmium::item_type::node)) {
         types |= osmium::osm_entity_bits::node;
     }
-    if (!m_referenced_ids(osmium::item_type::way).empty() || !m_filters(osmium::item_type::way).empty() || !m_area_filters.empty()) {
+    if (!m_referenced_ids(osmium::item_type::way).empty() || m_rules.has_rules_for(osmium::item_type::way)) {
         types |= osmium::osm_entity_bits::way;
     }
-    if (!m_referenced_ids(osmium::item_type::relation).empty() || !m_filters(osmium::item_type::relation).empty() || !m_area_filters.empty()) {
+    if (!m_referenced_ids(osmium::item_type::relation).empty() || m_rules.has_rules_for(osmium::item_type::relation)) {
         types |= osmium::osm_entity_bits::relation;
     }
 
@@ -199,64 +157,15 @@ void CommandTagsFilter::add_members(const osmium::Relation& relation) {
     }
 }
 
-bool CommandTagsFilter::matches_node(const osmium::Node& node) const noexcept {
-    return osmium::tags::match_any_of(node.tags(), m_filters(osmium::item_type::node));
-}
-
-bool CommandTagsFilter::matches_way(const osmium::Way& way) const noexcept {
-    return osmium::tags::match_any_of(way.tags(), m_filters(osmium::item_type::way)) ||
-           (way.nodes().size() >= 4 &&
-            way.is_closed() &&
-               osmium::tags::match_any_of(way.tags(), m_area_filters));
-}
-
-static bool is_multipolygon(const osmium::Relation& relation) noexcept {
-    const char* type = relation.tags().get_value_by_key("type");
-    if (type == nullptr) {
-        return false;
-    }
-
-    return !std::strcmp(type, "multipolygon") || !std::strcmp(type, "boundary");
-}
-
-bool CommandTagsFilter::matches_relation(const osmium::Relation& relation) const noexcept {
-    return osmium::tags::match_any_of(relation.tags(), m_filters(osmium::item_type::relation)) ||
-           (is_multipolygon(relation) &&
-               osmium::tags::match_any_of(relation.tags(), m_area_filters));
-}
-
-bool CommandTagsFilter::matches_object(const osmium::OSMObject& object) const noexcept {
-    switch (object.type()) {
-        case osmium::item_type::node:
-            return matches_node(static_cast<const osmium::Node&>(object));
-        case osmium::item_type::way:
-            return matches_way(static_cast<const osmium::Way&>(object));
-        case osmium::item_type::relation:
-            return matches_relation(static_cast<const osmium::Relation&>(object));
-        default:
-            break;
-    }
-    return false;
-}
-
-void CommandTagsFilter::mark_rel_ids(const osmium::index::RelationsMapIndex& rel_in_rel, osmium::unsigned_object_id_type parent_id) {
-    rel_in_rel.for_each(parent_id, [&](osmium::unsigned_object_id_type member_id) {
-        if (m_referenced_ids(osmium::item_type::relation).check_and_set(member_id)) {
-            mark_rel_ids(rel_in_rel, member_id);
-        }
-    });
-}
-
 bool CommandTagsFilter::find_relations_in_relations() {
     m_vout << "  Reading input file to find relations in relations...\n";
     osmium::index::RelationsMapStash stash;
 
     ++m_count_passes;
-    osmium::io::Reader reader{m_input_file, osmium::osm_entity_bits::relation};
-    while (osmium::memory::Buffer buffer = reader.read()) {
+    read_osm_file(m_input_file, osmium::osm_entity_bits::relation, osmium::io::read_meta::no, [&](osmium::memory::Buffer& buffer) {
         for (const auto& relation : buffer.select<osmium::Relation>()) {
             stash.add_members(relation);
-            if (matches_relation(relation) != m_invert_match) {
+            if (m_rules.matches_relation(relation) != m_invert_match) {
                 m_matching_ids(osmium::item_type::relation).set(relation.positive_id());
                 for (const auto& member : relation.members()) {
                     if (member.type() == osmium::item_type::node) {
@@ -267,8 +176,7 @@ bool CommandTagsFilter::find_relations_in_relations() {
                 }
             }
         }
-    }
-    reader.close();
+    });
 
     if (stash.empty()) {
         return false;
@@ -276,7 +184,7 @@ bool CommandTagsFilter::find_relations_in_relations() {
 
     const auto rel_in_rel = stash.build_parent_to_member_index();
     for (const auto id : m_matching_ids(osmium::item_type::relation)) {
-        mark_rel_ids(rel_in_rel, id);
+        mark_rel_ids(rel_in_rel, m_referenced_ids(osmium::item_type::relation), id);
     }
 
     return true;
@@ -286,8 +194,7 @@ void CommandTagsFilter::find_nodes_and_ways_in_relations() {
     m_vout << "  Reading input file to find nodes/ways in relations...\n";
 
     ++m_count_passes;
-    osmium::io::Reader reader{m_input_file, osmium::osm_entity_bits::relation};
-    while (osmium::memory::Buffer buffer = reader.read()) {
+    read_osm_file(m_input_file, osmium::osm_entity_bits::relation, osmium::io::read_meta::no, [&](osmium::memory::Buffer& buffer) {
         for (const auto& relation : buffer.select<osmium::Relation>()) {
             if (m_referenced_ids(osmium::item_type::relation).get(relation.positive_id())) {
                 for (const auto& member : relation.members()) {
@@ -299,31 +206,28 @@ void CommandTagsFilter::find_nodes_and_ways_in_relations() {
                 }
             }
         }
-    }
-    reader.close();
+    });
 }
 
 void CommandTagsFilter::find_nodes_in_ways() {
     m_vout << "  Reading input file to find nodes in ways...\n";
 
     ++m_count_passes;
-    osmium::io::Reader reader{m_input_file, osmium::osm_entity_bits::way};
-    while (osmium::memory::Buffer buffer = reader.read()) {
+    read_osm_file(m_input_file, osmium::osm_entity_bits::way, osmium::io::read_meta::no, [&](osmium::memory::Buffer& buffer) {
         for (const auto& way : buffer.select<osmium::Way>()) {
-            if (matches_way(way) != m_invert_match) {
+            if (m_rules.matches_way(way) != m_invert_match) {
                 m_matching_ids(osmium::item_type::way).set(way.positive_id());
                 add_nodes(way);
             } else if (m_referenced_ids(osmium::item_type::way).get(way.positive_id())) {
                 add_nodes(way);
             }
         }
-    }
-    reader.close();
+    });
 }
 
 void CommandTagsFilter::find_referenced_objects() {
     m_vout << "Following references...\n";
-    bool todo = !m_filters(osmium::item_type::relation).empty() || !m_area_filters.empty() || m_invert_match;
+    bool todo = m_rules.has_rules_for(osmium::item_type::relation) || m_invert_match;
     if (todo) {
         todo = find_relations_in_relations();
     }
@@ -332,13 +236,14 @@ void CommandTagsFilter::find_referenced_objects() {
         find_nodes_and_ways_in_relations();
     }
 
-    if (!m_referenced_ids(osmium::item_type::way).empty() || !m_filters(osmium::item_type::way).empty() || !m_area_filters.empty()) {
+    if (!m_referenced_ids(osmium::item_type::way).empty() || m_rules.has_rules_for(osmium::item_type::way)) {
         find_nodes_in_ways();
     }
     m_vout << "Done following references.\n";
 }
 
-void CommandTagsFilter::copy_matching_objects(osmium::io::Reader& reader, osmium::io::Writer& writer) {
+template <typename TReader>
+void CommandTagsFilter::copy_matching_objects(TReader& reader, osmium::io::Writer& writer) {
     m_vout << "Copying matching objects to output file...\n";
     ++m_count_passes;
     osmium::ProgressBar progress_bar{reader.file_size(), display_progress()};
@@ -347,7 +252,7 @@ void CommandTagsFilter::copy_matching_objects(osmium::io::Reader& reader, osmium
         for (auto& object : buffer.select<osmium::OSMObject>()) {
             if (m_matching_ids(object.type()).get(object.positive_id())) {
                 writer(object);
-            } else if ((!m_add_referenced_objects || object.type() == osmium::item_type::node) && matches_object(object) != m_invert_match) {
+            } else if ((!m_add_referenced_objects || object.type() == osmium::item_type::node) && m_rules.matches_object(object) != m_invert_match) {
                 writer(object);
             } else if (m_referenced_ids(object.type()).get(object.positive_id())) {
                 if (m_remove_tags) {
@@ -381,9 +286,13 @@ bool CommandTagsFilter::run() {
         find_referenced_objects();
 
         m_vout << "Opening input file...\n";
-        osmium::io::Reader reader{m_input_file, get_needed_types()};
-
-        copy_matching_objects(reader, writer);
+        if (PBFBlockReader::can_map(m_input_file)) {
+            PBFBlockReader reader{m_input_file, get_needed_types()};
+            copy_matching_objects(reader, writer);
+        } else {
+            osmium::io::Reader reader{m_input_file, get_needed_types()};
+            copy_matching_objects(reader, writer);
+        }
     } else {
         m_vout << "Opening input file...\n";
         osmium::io::Reader reader{m_input_file, get_needed_types()};
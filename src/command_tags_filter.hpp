@@ -24,6 +24,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "cmd.hpp" // IWYU pragma: export
+#include "tags_filter_rules.hpp"
 
 #include <osmium/fwd.hpp>
 #include <osmium/index/id_set.hpp>
@@ -34,15 +35,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/item_type.hpp>
 #include <osmium/osm/types.hpp>
-#include <osmium/tags/tags_filter.hpp>
 
 #include <string>
 #include <vector>
 
 class CommandTagsFilter : public CommandWithSingleOSMInput, public with_osm_output {
 
-    osmium::nwr_array<osmium::TagsFilter> m_filters;
-    osmium::TagsFilter m_area_filters;
+    TagsFilterRules m_rules;
 
     osmium::nwr_array<osmium::index::IdSetDense<osmium::unsigned_object_id_type>> m_matching_ids;
     osmium::nwr_array<osmium::index::IdSetDense<osmium::unsigned_object_id_type>> m_referenced_ids;
@@ -59,21 +58,12 @@ class CommandTagsFilter : public CommandWithSingleOSMInput, public with_osm_outp
     void add_nodes(const osmium::Way& way);
     void add_members(const osmium::Relation& relation);
 
-    bool matches_node(const osmium::Node& node) const noexcept;
-    bool matches_way(const osmium::Way& way) const noexcept;
-    bool matches_relation(const osmium::Relation& relation) const noexcept;
-    bool matches_object(const osmium::OSMObject& object) const noexcept;
-
-    void mark_rel_ids(const osmium::index::RelationsMapIndex& rel_in_rel, osmium::unsigned_object_id_type parent_id);
     bool find_relations_in_relations();
     void find_nodes_and_ways_in_relations();
     void find_nodes_in_ways();
 
-    void add_filter(osmium::osm_entity_bits::type entities, const osmium::TagMatcher& matcher);
-    void parse_and_add_expression(const std::string& expression);
-    void read_expressions_file(const std::string& file_name);
-
-    void copy_matching_objects(osmium::io::Reader& reader, osmium::io::Writer& writer);
+    template <typename TReader>
+    void copy_matching_objects(TReader& reader, osmium::io::Writer& writer);
 
 public:
 
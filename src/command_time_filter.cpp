@@ -25,28 +25,188 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "exception.hpp"
 #include "util.hpp"
 
-#include <osmium/diff_iterator.hpp>
 #include <osmium/io/file.hpp>
 #include <osmium/io/header.hpp>
-#include <osmium/io/input_iterator.hpp>
-#include <osmium/io/output_iterator.hpp>
 #include <osmium/io/reader_with_progress_bar.hpp>
 #include <osmium/io/writer.hpp>
+#include <osmium/memory/buffer.hpp>
 #include <osmium/osm/diff_object.hpp>
 #include <osmium/osm/entity_bits.hpp>
 #include <osmium/osm/object.hpp>
 #include <osmium/osm/timestamp.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/util/string.hpp>
 #include <osmium/util/verbose_output.hpp>
 
 #include <boost/program_options.hpp>
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <ctime>
+#include <deque>
+#include <future>
+#include <limits>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
+static osmium::Timestamp parse_timestamp(const std::string& str) {
+    try {
+        return osmium::Timestamp{str};
+    } catch (const std::invalid_argument&) {
+        throw argument_error{"Wrong format for timestamp '" + str + "' (use YYYY-MM-DDThh:mm:ssZ)."};
+    }
+}
+
+// Add count units to the timestamp. Units are hours (h), days (d), weeks
+// (w), months (m), and years (y). Returns osmium::end_of_time() if the
+// result is outside the range of timestamps.
+static osmium::Timestamp add_step(const osmium::Timestamp& timestamp, uint64_t count, char unit) {
+    constexpr const int64_t max_seconds = std::numeric_limits<uint32_t>::max();
+    int64_t seconds = 0;
+    switch (unit) {
+        case 'h':
+            seconds = 60 * 60;
+            break;
+        case 'd':
+            seconds = 60 * 60 * 24;
+            break;
+        case 'w':
+            seconds = 60 * 60 * 24 * 7;
+            break;
+        case 'm':
+        case 'y': {
+            // Calendar arithmetic on the ISO string: "YYYY-MM-DDThh:mm:ssZ"
+            if (count > 12 * 10000) {
+                return osmium::end_of_time();
+            }
+            std::string iso = timestamp.to_iso();
+            int64_t year = std::stoi(iso.substr(0, 4));
+            int64_t month = std::stoi(iso.substr(5, 2)) - 1;
+            if (unit == 'y') {
+                year += static_cast<int64_t>(count);
+            } else {
+                month += static_cast<int64_t>(count);
+                year += month / 12;
+                month %= 12;
+            }
+            if (year > 2105) {
+                return osmium::end_of_time();
+            }
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "%04d-%02d", static_cast<int>(year), static_cast<int>(month + 1));
+            iso.replace(0, 7, buffer);
+            return osmium::Timestamp{iso};
+        }
+        default:
+            throw argument_error{std::string{"Unknown unit '"} + unit + "' for snapshot step (use h, d, w, m, or y)."};
+    }
+
+    if (count > static_cast<uint64_t>(max_seconds / seconds)) {
+        return osmium::end_of_time();
+    }
+    const int64_t result = static_cast<int64_t>(timestamp.seconds_since_epoch()) + static_cast<int64_t>(count) * seconds;
+    if (result >= max_seconds) {
+        return osmium::end_of_time();
+    }
+    return osmium::Timestamp{static_cast<uint32_t>(result)};
+}
+
+// Get file name for a snapshot by replacing {} in the pattern with the
+// timestamp in the form YYYYMMDDThhmmssZ.
+static std::string snapshot_filename(const std::string& pattern, const osmium::Timestamp& timestamp) {
+    const auto pos = pattern.find("{}");
+    if (pos == std::string::npos) {
+        return pattern;
+    }
+
+    std::string ts = timestamp.to_iso();
+    ts.erase(std::remove_if(ts.begin(), ts.end(), [](char c) {
+        return c == '-' || c == ':';
+    }), ts.end());
+
+    std::string filename{pattern};
+    filename.replace(pos, 2, ts);
+    return filename;
+}
+
+void CommandTimeFilter::setup_snapshots(const po::variables_map& vm) {
+    if (vm.count("time-from")) {
+        throw argument_error{"Can not use --snapshot or --snapshot-range together with TIME arguments."};
+    }
+
+    if (vm.count("snapshot")) {
+        for (const auto& list : vm["snapshot"].as<std::vector<std::string>>()) {
+            for (const auto& ts : osmium::split_string(list, ',', true)) {
+                m_snapshots.push_back(parse_timestamp(ts));
+            }
+        }
+    }
+
+    if (vm.count("snapshot-range")) {
+        const auto range = osmium::split_string(vm["snapshot-range"].as<std::string>(), ',');
+        if (range.size() != 3) {
+            throw argument_error{"Use --snapshot-range=FROM,TO,STEP."};
+        }
+        const auto from = parse_timestamp(range[0]);
+        const auto to = parse_timestamp(range[1]);
+        if (from > to) {
+            throw argument_error{"Second timestamp in --snapshot-range is before first one."};
+        }
+
+        const auto& step = range[2];
+        std::size_t pos = 0;
+        uint64_t count = 0;
+        try {
+            count = std::stoull(step, &pos);
+        } catch (const std::logic_error&) {
+            pos = 0;
+        }
+        if (count == 0 || pos + 1 != step.size()) {
+            throw argument_error{"Step in --snapshot-range must be a positive number followed by a unit (h, d, w, m, or y)."};
+        }
+        if ((step[pos] == 'm' || step[pos] == 'y') && from.to_iso().substr(8, 2) > "28") {
+            throw argument_error{"Snapshots with a step in months or years must start on one of the first 28 days of a month."};
+        }
+
+        for (auto ts = from; ts <= to;) {
+            m_snapshots.push_back(ts);
+            const auto next = add_step(ts, count, step[pos]);
+            if (next <= ts) {
+                break;
+            }
+            ts = next;
+        }
+    }
+
+    std::sort(m_snapshots.begin(), m_snapshots.end());
+    m_snapshots.erase(std::unique(m_snapshots.begin(), m_snapshots.end()), m_snapshots.end());
+
+    if (m_snapshots.empty()) {
+        throw argument_error{"No snapshots given."};
+    }
+
+    const auto& pattern = m_output_file.filename();
+    if (m_snapshots.size() > 1 && pattern.find("{}") == std::string::npos) {
+        throw argument_error{"The output file name must contain '{}' which is replaced by the\n"
+                             "timestamp when writing more than one snapshot."};
+    }
+
+    m_from = m_snapshots.front();
+    m_to = m_from;
+}
+
 bool CommandTimeFilter::setup(const std::vector<std::string>& arguments) {
+    po::options_description opts_cmd{"COMMAND OPTIONS"};
+    opts_cmd.add_options()
+    ("snapshot", po::value<std::vector<std::string>>(), "Write snapshot at this point in time (can be given multiple times)")
+    ("snapshot-range", po::value<std::string>(), "Write snapshots from FROM to TO every STEP (FROM,TO,STEP)")
+    ;
+
     const po::options_description opts_common{add_common_options()};
     const po::options_description opts_input{add_single_input_options()};
     const po::options_description opts_output{add_output_options()};
@@ -59,7 +219,7 @@ bool CommandTimeFilter::setup(const std::vector<std::string>& arguments) {
     ;
 
     po::options_description desc;
-    desc.add(opts_common).add(opts_input).add(opts_output);
+    desc.add(opts_cmd).add(opts_common).add(opts_input).add(opts_output);
 
     po::options_description parsed_options;
     parsed_options.add(desc).add(hidden);
@@ -83,7 +243,9 @@ bool CommandTimeFilter::setup(const std::vector<std::string>& arguments) {
     m_from = osmium::Timestamp{std::time(nullptr)};
     m_to = m_from;
 
-    if (vm.count("time-from")) {
+    if (vm.count("snapshot") || vm.count("snapshot-range")) {
+        setup_snapshots(vm);
+    } else if (vm.count("time-from")) {
         const auto ts = vm["time-from"].as<std::string>();
         try {
             m_from = osmium::Timestamp{ts};
@@ -106,6 +268,19 @@ bool CommandTimeFilter::setup(const std::vector<std::string>& arguments) {
         throw argument_error{"Second timestamp is before first one."};
     }
 
+    if (m_from == m_to && m_snapshots.empty()) {
+        m_snapshots.push_back(m_from);
+    }
+
+    if (m_snapshots.empty()) {
+        m_output_files.push_back(m_output_file);
+    }
+
+    for (const auto& timestamp : m_snapshots) {
+        m_output_files.emplace_back(snapshot_filename(m_output_file.filename(), timestamp), m_output_format);
+        m_output_files.back().check();
+    }
+
     if (m_from == m_to) { // point in time
         if (m_output_file.has_multiple_object_versions()) {
             warning("You are writing to a file marked as having multiple object versions,\n"
@@ -125,45 +300,168 @@ void CommandTimeFilter::show_arguments() {
     show_single_input_arguments(m_vout);
     show_output_arguments(m_vout);
     m_vout << "  other options:\n";
-    m_vout << "    Filtering from time " << m_from.to_iso() << " to " << m_to.to_iso() << "\n";
+    if (m_snapshots.size() > 1) {
+        m_vout << "    Writing snapshots:\n";
+        for (std::size_t n = 0; n < m_snapshots.size(); ++n) {
+            m_vout << "      " << m_snapshots[n].to_iso() << " to " << m_output_files[n].filename() << "\n";
+        }
+    } else {
+        m_vout << "    Filtering from time " << m_from.to_iso() << " to " << m_to.to_iso() << "\n";
+    }
 }
 
+namespace {
+
+    // Maximum number of chunks handed to the worker threads which haven't
+    // been written out yet.
+    constexpr const std::size_t max_pending_chunks = 20;
+
+    /**
+     * Objects from one or more buffers. All versions of an object are
+     * always in the same chunk.
+     */
+    struct HistoryChunk {
+        std::vector<osmium::OSMObject*> objects;
+        std::vector<std::shared_ptr<osmium::memory::Buffer>> buffers;
+    };
+
+    bool same_object(const osmium::OSMObject& a, const osmium::OSMObject& b) noexcept {
+        return a.type() == b.type() && a.id() == b.id();
+    }
+
+    /**
+     * Filter all objects in the chunk. Returns one buffer for each
+     * snapshot or, if there are no snapshots, a single buffer with the
+     * objects in the time range from-to.
+     */
+    std::vector<osmium::memory::Buffer> filter_chunk(const HistoryChunk& chunk,
+                                                     const std::vector<osmium::Timestamp>& snapshots,
+                                                     const osmium::Timestamp& from,
+                                                     const osmium::Timestamp& to) {
+        std::vector<osmium::memory::Buffer> buffers;
+        const auto num_buffers = snapshots.empty() ? 1 : snapshots.size();
+        for (std::size_t i = 0; i < num_buffers; ++i) {
+            buffers.emplace_back(chunk.buffers.front()->committed(), osmium::memory::Buffer::auto_grow::yes);
+        }
+
+        const auto& objects = chunk.objects;
+        for (std::size_t n = 0; n < objects.size(); ++n) {
+            // Neighbours belonging to a different object are replaced by
+            // the object itself, so the first and last versions of each
+            // object are recognized as such.
+            const auto& prev = (n == 0 || !same_object(*objects[n - 1], *objects[n])) ? *objects[n] : *objects[n - 1];
+            const auto& next = (n + 1 == objects.size() || !same_object(*objects[n + 1], *objects[n])) ? *objects[n] : *objects[n + 1];
+            const osmium::DiffObject diff{prev, *objects[n], next};
+            if (snapshots.empty()) {
+                if (diff.is_between(from, to)) {
+                    buffers[0].add_item(*objects[n]);
+                    buffers[0].commit();
+                }
+            } else {
+                for (std::size_t i = 0; i < snapshots.size(); ++i) {
+                    if (diff.is_visible_at(snapshots[i])) {
+                        buffers[i].add_item(*objects[n]);
+                        buffers[i].commit();
+                    }
+                }
+            }
+        }
+
+        return buffers;
+    }
+
+} // anonymous namespace
+
 bool CommandTimeFilter::run() {
     m_vout << "Opening input file...\n";
     osmium::io::ReaderWithProgressBar reader{display_progress(), m_input_file, osmium::osm_entity_bits::object};
 
-    m_vout << "Opening output file...\n";
+    m_vout << "Opening output file" << (m_output_files.size() > 1 ? "s" : "") << "...\n";
     osmium::io::Header header{reader.header()};
     setup_header(header);
 
-    osmium::io::Writer writer{m_output_file, header, m_output_overwrite, m_fsync};
+    std::vector<std::unique_ptr<osmium::io::Writer>> writers;
+    for (const auto& file : m_output_files) {
+        writers.push_back(std::make_unique<osmium::io::Writer>(file, header, m_output_overwrite, m_fsync));
+    }
 
     m_vout << "Filter data while copying it from input to output...\n";
-    auto input = osmium::io::make_input_iterator_range<osmium::OSMObject>(reader);
-    auto diff_begin = osmium::make_diff_iterator(input.begin(), input.end());
-    auto diff_end   = osmium::make_diff_iterator(input.end(), input.end());
-    auto out = osmium::io::make_output_iterator(writer);
-
-    if (m_from == m_to) {
-        std::copy_if(
-            diff_begin,
-            diff_end,
-            out,
-            [this](const osmium::DiffObject& d) {
-                return d.is_visible_at(m_from);
-            });
-    } else {
-        std::copy_if(
-            diff_begin,
-            diff_end,
-            out,
-            [this](const osmium::DiffObject& d) {
-                return d.is_between(m_from, m_to);
-            });
+
+    // The input is split into chunks at object boundaries. The versions
+    // of the last object in a buffer might continue in the next buffer,
+    // so they are held back and become part of the next chunk.
+    auto& pool = osmium::thread::Pool::default_instance();
+    std::deque<std::future<std::vector<osmium::memory::Buffer>>> pending;
+    HistoryChunk chunk;
+
+    const auto write_next_result = [&]() {
+        auto buffers = pending.front().get();
+        pending.pop_front();
+        for (std::size_t n = 0; n < buffers.size(); ++n) {
+            (*writers[n])(std::move(buffers[n]));
+        }
+    };
+
+    const auto submit = [&](HistoryChunk&& c) {
+        pending.push_back(pool.submit([c = std::move(c), this]() {
+            return filter_chunk(c, m_snapshots, m_from, m_to);
+        }));
+        if (pending.size() >= max_pending_chunks) {
+            write_next_result();
+        }
+    };
+
+    while (true) {
+        auto buffer = std::make_shared<osmium::memory::Buffer>(reader.read());
+        if (!*buffer) {
+            break;
+        }
+
+        for (auto& object : buffer->select<osmium::OSMObject>()) {
+            chunk.objects.push_back(&object);
+        }
+        chunk.buffers.push_back(buffer);
+
+        if (chunk.objects.empty()) {
+            continue;
+        }
+
+        const auto& last = *chunk.objects.back();
+        const auto split = std::find_if(chunk.objects.cbegin(), chunk.objects.cend(), [&last](const osmium::OSMObject* object) {
+            return same_object(*object, last);
+        });
+
+        if (split == chunk.objects.cbegin()) {
+            continue;
+        }
+
+        // The held back versions are in the buffer containing the first
+        // of them and in all buffers after it.
+        const auto* first = reinterpret_cast<const unsigned char*>(*split);
+        const auto keep = std::find_if(chunk.buffers.cbegin(), chunk.buffers.cend(), [first](const std::shared_ptr<osmium::memory::Buffer>& b) {
+            return first >= b->data() && first < b->data() + b->committed();
+        });
+
+        HistoryChunk rest;
+        rest.objects.assign(split, chunk.objects.cend());
+        rest.buffers.assign(keep, chunk.buffers.cend());
+        chunk.objects.erase(split, chunk.objects.cend());
+        submit(std::move(chunk));
+        chunk = std::move(rest);
+    }
+
+    if (!chunk.objects.empty()) {
+        submit(std::move(chunk));
     }
 
-    m_vout << "Closing output file...\n";
-    writer.close();
+    while (!pending.empty()) {
+        write_next_result();
+    }
+
+    m_vout << "Closing output file" << (writers.size() > 1 ? "s" : "") << "...\n";
+    for (auto& writer : writers) {
+        writer->close();
+    }
 
     m_vout << "Closing input file...\n";
     reader.close();
@@ -173,4 +471,3 @@ bool CommandTimeFilter::run() {
 
     return true;
 }
-
@@ -25,6 +25,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "cmd.hpp" // IWYU pragma: export
 
+#include <osmium/io/file.hpp>
 #include <osmium/osm/timestamp.hpp>
 
 #include <string>
@@ -35,6 +36,15 @@ class CommandTimeFilter : public CommandWithSingleOSMInput, public with_osm_outp
     osmium::Timestamp m_from;
     osmium::Timestamp m_to;
 
+    // Points in time for which snapshots should be written. Empty if a
+    // time range is filtered.
+    std::vector<osmium::Timestamp> m_snapshots;
+
+    // One output file for each snapshot or a single one for a time range.
+    std::vector<osmium::io::File> m_output_files;
+
+    void setup_snapshots(const po::variables_map& vm);
+
 public:
 
     explicit CommandTimeFilter(const CommandFactory& command_factory) :
@@ -47,13 +57,23 @@ public:
 
     bool run() override final;
 
+    const std::vector<osmium::Timestamp>& snapshots() const noexcept {
+        return m_snapshots;
+    }
+
+    const std::vector<osmium::io::File>& output_files() const noexcept {
+        return m_output_files;
+    }
+
     const char* name() const noexcept override final {
         return "time-filter";
     }
 
     const char* synopsis() const noexcept override final {
         return "osmium time-filter [OPTIONS] OSM-HISTORY-FILE [TIME]\n"
-               "       osmium time-filter [OPTIONS] OSM-HISTORY-FILE FROM-TIME TO-TIME";
+               "       osmium time-filter [OPTIONS] OSM-HISTORY-FILE FROM-TIME TO-TIME\n"
+               "       osmium time-filter [OPTIONS] --snapshot=TIME... OSM-HISTORY-FILE\n"
+               "       osmium time-filter [OPTIONS] --snapshot-range=FROM,TO,STEP OSM-HISTORY-FILE";
     }
 
 }; // class CommandTimeFilter
@@ -5,6 +5,7 @@
 #include "command_apply_changes.hpp"
 #include "command_cat.hpp"
 #include "command_changeset_filter.hpp"
+#include "command_changeset_index.hpp"
 #include "command_check_refs.hpp"
 #include "command_create_locations_index.hpp"
 #include "command_derive_changes.hpp"
@@ -15,8 +16,10 @@
 #include "command_getid.hpp"
 #include "command_getparents.hpp"
 #include "command_help.hpp"
+#include "command_index.hpp"
 #include "command_merge.hpp"
 #include "command_merge_changes.hpp"
+#include "command_pipeline.hpp"
 #include "command_query_locations_index.hpp"
 #include "command_removeid.hpp"
 #include "command_renumber.hpp"
@@ -43,6 +46,10 @@ void register_commands(CommandFactory& cmd_factory) {
         return std::make_unique<CommandChangesetFilter>(cmd_factory);
     });
 
+    cmd_factory.register_command("changeset-index", "Create index for OSM changeset file", [&]() {
+        return std::make_unique<CommandChangesetIndex>(cmd_factory);
+    });
+
     cmd_factory.register_command("check-refs", "Check referential integrity of an OSM file", [&]() {
         return std::make_unique<CommandCheckRefs>(cmd_factory);
     });
@@ -83,6 +90,10 @@ void register_commands(CommandFactory& cmd_factory) {
         return std::make_unique<CommandHelp>(cmd_factory);
     });
 
+    cmd_factory.register_command("index", "Create block index for OSM PBF file", [&]() {
+        return std::make_unique<CommandIndex>(cmd_factory);
+    });
+
     cmd_factory.register_command("merge-changes", "Merge several OSM change files into one", [&]() {
         return std::make_unique<CommandMergeChanges>(cmd_factory);
     });
@@ -90,6 +101,10 @@ void register_commands(CommandFactory& cmd_factory) {
         return std::make_unique<CommandMerge>(cmd_factory);
     });
 
+    cmd_factory.register_command("pipeline", "Run several processing stages without intermediate files", [&]() {
+        return std::make_unique<CommandPipeline>(cmd_factory);
+    });
+
     cmd_factory.register_command("query-locations-index", "Query node locations index on disk", [&]() {
         return std::make_unique<CommandQueryLocationsIndex>(cmd_factory);
     });
@@ -0,0 +1,138 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "external_sort.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <system_error>
+
+namespace {
+
+    // Number of pairs read from each run at once while merging.
+    constexpr const std::size_t run_read_size = 64UL * 1024UL;
+
+    class RunReader {
+
+        std::FILE* m_file;
+        std::vector<ExternalIdPairs::value_type> m_data;
+        std::size_t m_pos = 0;
+
+    public:
+
+        explicit RunReader(std::FILE* file) :
+            m_file(file) {
+            std::rewind(m_file);
+            fill();
+        }
+
+        void fill() {
+            m_data.resize(run_read_size);
+            const auto count = std::fread(m_data.data(), sizeof(ExternalIdPairs::value_type), m_data.size(), m_file);
+            if (count < m_data.size() && std::ferror(m_file)) {
+                throw std::system_error{errno, std::system_category(), "Read error on temporary file"};
+            }
+            m_data.resize(count);
+            m_pos = 0;
+        }
+
+        bool empty() const noexcept {
+            return m_pos == m_data.size();
+        }
+
+        const ExternalIdPairs::value_type& front() const noexcept {
+            return m_data[m_pos];
+        }
+
+        void pop() {
+            ++m_pos;
+            if (empty()) {
+                fill();
+            }
+        }
+
+    }; // class RunReader
+
+} // anonymous namespace
+
+void ExternalIdPairs::write_run() {
+    std::sort(m_data.begin(), m_data.end());
+
+    file_ptr file{std::tmpfile()};
+    if (!file) {
+        throw std::system_error{errno, std::system_category(), "Could not create temporary file"};
+    }
+
+    if (std::fwrite(m_data.data(), sizeof(value_type), m_data.size(), file.get()) != m_data.size() ||
+        std::fflush(file.get()) != 0) {
+        throw std::system_error{errno, std::system_category(), "Write error on temporary file"};
+    }
+
+    m_runs.push_back(std::move(file));
+    m_written += m_data.size();
+    m_data.clear();
+}
+
+void ExternalIdPairs::for_each_sorted(const std::function<void(const value_type&)>& func) {
+    if (m_runs.empty()) {
+        std::sort(m_data.begin(), m_data.end());
+        for (const auto& value : m_data) {
+            func(value);
+        }
+    } else {
+        if (!m_data.empty()) {
+            write_run();
+        }
+        std::vector<value_type>{}.swap(m_data);
+
+        std::vector<RunReader> readers;
+        readers.reserve(m_runs.size());
+        for (const auto& run : m_runs) {
+            readers.emplace_back(run.get());
+        }
+
+        using queue_entry = std::pair<value_type, std::size_t>;
+        std::priority_queue<queue_entry, std::vector<queue_entry>, std::greater<queue_entry>> queue;
+        for (std::size_t n = 0; n < readers.size(); ++n) {
+            if (!readers[n].empty()) {
+                queue.emplace(readers[n].front(), n);
+            }
+        }
+
+        while (!queue.empty()) {
+            const auto n = queue.top().second;
+            func(queue.top().first);
+            queue.pop();
+            readers[n].pop();
+            if (!readers[n].empty()) {
+                queue.emplace(readers[n].front(), n);
+            }
+        }
+    }
+
+    m_data.clear();
+    m_runs.clear();
+    m_size = 0;
+}
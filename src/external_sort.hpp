@@ -0,0 +1,108 @@
+#ifndef EXTERNAL_SORT_HPP
+#define EXTERNAL_SORT_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * Collects pairs of object IDs and hands them out in sorted order. At
+ * most max_in_memory pairs are kept in memory. If there are more, they
+ * are sorted and written as a run to a temporary file. All runs are
+ * merged when the pairs are read back, so memory use stays bounded
+ * however many pairs there are.
+ */
+class ExternalIdPairs {
+
+public:
+
+    using value_type = std::pair<osmium::object_id_type, osmium::object_id_type>;
+
+private:
+
+    struct file_closer {
+        void operator()(std::FILE* file) const noexcept {
+            std::fclose(file);
+        }
+    };
+
+    using file_ptr = std::unique_ptr<std::FILE, file_closer>;
+
+    std::vector<value_type> m_data;
+    std::vector<file_ptr> m_runs;
+    std::size_t m_max_in_memory;
+    uint64_t m_size = 0;
+    uint64_t m_written = 0;
+
+    void write_run();
+
+public:
+
+    explicit ExternalIdPairs(std::size_t max_in_memory) :
+        m_max_in_memory(max_in_memory) {
+    }
+
+    void push_back(const value_type& value) {
+        if (m_data.size() >= m_max_in_memory) {
+            write_run();
+        }
+        m_data.push_back(value);
+        ++m_size;
+    }
+
+    // Number of pairs added.
+    uint64_t size() const noexcept {
+        return m_size;
+    }
+
+    bool empty() const noexcept {
+        return m_size == 0;
+    }
+
+    // Memory used for pairs not yet written out.
+    std::size_t used_memory() const noexcept {
+        return m_data.capacity() * sizeof(value_type);
+    }
+
+    // Bytes written to temporary files.
+    uint64_t used_disk() const noexcept {
+        return m_written * sizeof(value_type);
+    }
+
+    /**
+     * Call func for all pairs in sorted order. Can only be called once,
+     * afterwards the object is empty.
+     */
+    void for_each_sorted(const std::function<void(const value_type&)>& func);
+
+}; // class ExternalIdPairs
+
+#endif // EXTERNAL_SORT_HPP
@@ -22,32 +22,50 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "extract.hpp"
 
+#include "../buffer_pool.hpp"
+
 #include <osmium/io/writer_options.hpp>
 
+#include <algorithm>
 #include <memory>
 #include <sstream>
 #include <string>
 
 void Extract::open_file(const osmium::io::Header& header, osmium::io::overwrite output_overwrite, osmium::io::fsync sync, OptionClean const* clean) {
-    m_clean = clean;
+    if (clean) {
+        clean->apply_to(m_output_file);
+    }
     m_writer = std::make_unique<osmium::io::Writer>(m_output_file, header, output_overwrite, sync);
 }
 
+void Extract::flush_buffer() {
+    if (m_write_stats) {
+        m_write_stats->bytes_in += m_buffer.committed();
+        m_write_stats->add_buffer(m_buffer);
+    }
+    (*m_writer)(std::move(m_buffer));
+}
+
 void Extract::close_file() {
     if (m_writer) {
         if (m_buffer.committed() > 0) {
-            m_clean->apply_to(m_buffer);
-            (*m_writer)(std::move(m_buffer));
+            flush_buffer();
+        }
+        const auto bytes_written = m_writer->close();
+        if (m_write_stats) {
+            m_write_stats->bytes_out += bytes_written;
         }
-        m_writer->close();
     }
 }
 
 void Extract::write(const osmium::memory::Item& item) {
     if (m_buffer.capacity() - m_buffer.committed() < item.padded_size()) {
-        m_clean->apply_to(m_buffer);
-        (*m_writer)(std::move(m_buffer));
-        m_buffer = osmium::memory::Buffer{buffer_size, osmium::memory::Buffer::auto_grow::no};
+        flush_buffer();
+        // Buffers from the pool might not grow, so make sure the item
+        // fits into the one we get.
+        const std::size_t item_size = item.padded_size();
+        const std::size_t min_size = std::max(std::min(m_buffer_size, static_cast<std::size_t>(min_buffer_size)), item_size);
+        m_buffer = BufferPool::instance().get(std::max(m_buffer_size, item_size), min_size);
     }
     m_buffer.push_back(item);
 }
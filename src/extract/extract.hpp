@@ -24,6 +24,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "../option_clean.hpp"
+#include "../stage_stats.hpp"
 
 #include <osmium/io/file.hpp>
 #include <osmium/io/header.hpp>
@@ -40,22 +41,34 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 class Extract {
 
-    static constexpr const std::size_t buffer_size = 10UL * 1024UL * 1024UL;
+public:
+
+    static constexpr const std::size_t default_buffer_size = 10UL * 1024UL * 1024UL;
+
+private:
+
+    // Smaller buffers from the buffer pool are fine, too.
+    static constexpr const std::size_t min_buffer_size = 1UL * 1024UL * 1024UL;
 
     osmium::io::File m_output_file;
     std::string m_description;
     std::vector<std::string> m_header_options;
     osmium::Box m_envelope;
-    osmium::memory::Buffer m_buffer{buffer_size, osmium::memory::Buffer::auto_grow::no};
+    std::size_t m_buffer_size;
+    osmium::memory::Buffer m_buffer;
     std::unique_ptr<osmium::io::Writer> m_writer;
-    const OptionClean* m_clean = nullptr;
+    StageStats* m_write_stats = nullptr;
+
+    void flush_buffer();
 
 public:
 
-    Extract(const osmium::io::File& output_file, const std::string& description, const osmium::Box& envelope) :
+    Extract(const osmium::io::File& output_file, const std::string& description, const osmium::Box& envelope, std::size_t buffer_size = default_buffer_size) :
         m_output_file(output_file),
         m_description(description),
         m_envelope(envelope),
+        m_buffer_size(buffer_size),
+        m_buffer(buffer_size, osmium::memory::Buffer::auto_grow::no),
         m_writer(nullptr) {
     }
 
@@ -93,6 +106,12 @@ public:
         return *m_writer;
     }
 
+    // Account for the data written in this stage. Must be set before
+    // calling open_file().
+    void set_write_stats(StageStats* stats) noexcept {
+        m_write_stats = stats;
+    }
+
     void open_file(const osmium::io::Header& header, osmium::io::overwrite output_overwrite, osmium::io::fsync sync, OptionClean const* clean);
 
     void close_file();
@@ -103,6 +122,12 @@ public:
 
     virtual bool contains(const osmium::Location& location) const noexcept = 0;
 
+    // Add the locations where the segment a-b crosses or touches the
+    // boundary of the extract to crossings. Where it runs along the
+    // boundary, the corners on it are added. They are not ordered and may
+    // contain duplicates.
+    virtual void boundary_crossings(const osmium::Location& a, const osmium::Location& b, std::vector<osmium::Location>* crossings) const = 0;
+
     virtual const char* geometry_type() const noexcept = 0;
 
     virtual std::string geometry_as_text() const = 0;
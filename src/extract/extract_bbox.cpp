@@ -21,15 +21,34 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "extract_bbox.hpp"
+#include "geometry_util.hpp"
 
 #include <osmium/osm/location.hpp>
 
 #include <string>
+#include <utility>
+#include <vector>
 
 bool ExtractBBox::contains(const osmium::Location& location) const noexcept {
     return location.valid() && envelope().contains(location);
 }
 
+void ExtractBBox::boundary_crossings(const osmium::Location& a, const osmium::Location& b, std::vector<osmium::Location>* crossings) const {
+    const osmium::Location bl = envelope().bottom_left();
+    const osmium::Location tr = envelope().top_right();
+    const osmium::Location br{tr.x(), bl.y()};
+    const osmium::Location tl{bl.x(), tr.y()};
+
+    osmium::Location location;
+    for (const auto& edge : {std::make_pair(bl, br), std::make_pair(br, tr), std::make_pair(tr, tl), std::make_pair(tl, bl)}) {
+        if (segment_intersection(a, b, edge.first, edge.second, &location)) {
+            crossings->push_back(location);
+        } else if (on_segment(edge.first, a, b)) {
+            crossings->push_back(edge.first);
+        }
+    }
+}
+
 const char* ExtractBBox::geometry_type() const noexcept {
     return "bbox";
 }
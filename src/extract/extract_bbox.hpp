@@ -29,12 +29,14 @@ class ExtractBBox : public Extract {
 
 public:
 
-    ExtractBBox(const osmium::io::File& output_file, const std::string& description, const osmium::Box& box) :
-        Extract(output_file, description, box) {
+    ExtractBBox(const osmium::io::File& output_file, const std::string& description, const osmium::Box& box, std::size_t buffer_size = default_buffer_size) :
+        Extract(output_file, description, box, buffer_size) {
     }
 
     bool contains(const osmium::Location& location) const noexcept override final;
 
+    void boundary_crossings(const osmium::Location& a, const osmium::Location& b, std::vector<osmium::Location>* crossings) const override final;
+
     const char* geometry_type() const noexcept override final;
 
     std::string geometry_as_text() const override final;
@@ -0,0 +1,101 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "extract_index.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Maximum number of cells in each direction
+constexpr const uint32_t max_side = 1024;
+
+ExtractIndex::ExtractIndex(const std::vector<osmium::Box>& envelopes) :
+    m_envelopes(envelopes) {
+    for (const auto& envelope : m_envelopes) {
+        m_envelope.extend(envelope);
+    }
+
+    // Use a grid with about four cells for each extract.
+    m_side = static_cast<uint32_t>(std::ceil(2.0 * std::sqrt(static_cast<double>(m_envelopes.size()))));
+    m_side = std::max(1U, std::min(max_side, m_side));
+
+    const std::size_t num_cells = static_cast<std::size_t>(m_side) * m_side;
+    m_offsets.resize(num_cells + 1, 0);
+
+    if (!m_envelope.valid()) {
+        return;
+    }
+
+    m_cell_width  = (static_cast<int64_t>(m_envelope.top_right().x()) - m_envelope.bottom_left().x()) / m_side + 1;
+    m_cell_height = (static_cast<int64_t>(m_envelope.top_right().y()) - m_envelope.bottom_left().y()) / m_side + 1;
+
+    // Count the entries in each cell first, then fill them in.
+    std::vector<std::size_t> fill(num_cells, 0);
+    for (int step = 0; step < 2; ++step) {
+        for (std::size_t n = 0; n < m_envelopes.size(); ++n) {
+            const auto& envelope = m_envelopes[n];
+            const uint32_t col_min = column(envelope.bottom_left().x());
+            const uint32_t col_max = column(envelope.top_right().x());
+            const uint32_t row_min = row(envelope.bottom_left().y());
+            const uint32_t row_max = row(envelope.top_right().y());
+
+            const std::size_t cells = static_cast<std::size_t>(col_max - col_min + 1) * (row_max - row_min + 1);
+            if (cells * 4 > num_cells && num_cells > 1) {
+                if (step == 0) {
+                    m_large.push_back(n);
+                }
+                continue;
+            }
+
+            for (auto r = row_min; r <= row_max; ++r) {
+                for (auto c = col_min; c <= col_max; ++c) {
+                    const std::size_t cell = r * static_cast<std::size_t>(m_side) + c;
+                    if (step == 0) {
+                        ++m_offsets[cell + 1];
+                    } else {
+                        m_entries[m_offsets[cell] + fill[cell]++] = n;
+                    }
+                }
+            }
+        }
+
+        if (step == 0) {
+            for (std::size_t cell = 0; cell < num_cells; ++cell) {
+                m_offsets[cell + 1] += m_offsets[cell];
+            }
+            m_entries.resize(m_offsets.back());
+        }
+    }
+}
+
+uint32_t ExtractIndex::column(int32_t x) const noexcept {
+    const auto c = (static_cast<int64_t>(x) - m_envelope.bottom_left().x()) / m_cell_width;
+    return static_cast<uint32_t>(std::max(int64_t{0}, std::min(static_cast<int64_t>(m_side) - 1, c)));
+}
+
+uint32_t ExtractIndex::row(int32_t y) const noexcept {
+    const auto r = (static_cast<int64_t>(y) - m_envelope.bottom_left().y()) / m_cell_height;
+    return static_cast<uint32_t>(std::max(int64_t{0}, std::min(static_cast<int64_t>(m_side) - 1, r)));
+}
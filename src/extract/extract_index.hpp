@@ -0,0 +1,92 @@
+#ifndef EXTRACT_EXTRACT_INDEX_HPP
+#define EXTRACT_EXTRACT_INDEX_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/location.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * Uniform grid over the envelopes of all extracts. It is used to find the
+ * extracts whose envelope contains a location without testing all of
+ * them. For bounding box extracts this is the exact answer, for polygon
+ * extracts the location still has to be checked against the polygon.
+ */
+class ExtractIndex {
+
+    std::vector<osmium::Box> m_envelopes;
+
+    // Envelope of all extracts
+    osmium::Box m_envelope;
+
+    int64_t m_cell_width = 1;
+    int64_t m_cell_height = 1;
+    uint32_t m_side = 1;
+
+    // Extracts in each cell, cell n has the entries from m_offsets[n] to
+    // m_offsets[n + 1].
+    std::vector<std::size_t> m_offsets;
+    std::vector<std::size_t> m_entries;
+
+    // Extracts covering a large part of the grid are not put into the
+    // cells but always checked.
+    std::vector<std::size_t> m_large;
+
+    uint32_t column(int32_t x) const noexcept;
+
+    uint32_t row(int32_t y) const noexcept;
+
+public:
+
+    explicit ExtractIndex(const std::vector<osmium::Box>& envelopes);
+
+    // Call func with the index of each extract whose envelope contains the
+    // location.
+    template <typename TFunc>
+    void for_each(const osmium::Location& location, TFunc&& func) const {
+        if (!location.valid() || !m_envelope.contains(location)) {
+            return;
+        }
+
+        const std::size_t cell = row(location.y()) * static_cast<std::size_t>(m_side) + column(location.x());
+        for (auto n = m_offsets[cell]; n < m_offsets[cell + 1]; ++n) {
+            if (m_envelopes[m_entries[n]].contains(location)) {
+                std::forward<TFunc>(func)(m_entries[n]);
+            }
+        }
+
+        for (const auto n : m_large) {
+            if (m_envelopes[n].contains(location)) {
+                std::forward<TFunc>(func)(n);
+            }
+        }
+    }
+
+}; // class ExtractIndex
+
+#endif // EXTRACT_EXTRACT_INDEX_HPP
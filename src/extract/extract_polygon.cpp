@@ -21,6 +21,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "extract_polygon.hpp"
+#include "geometry_util.hpp"
 
 #include "../exception.hpp"
 
@@ -151,6 +152,30 @@ bool ExtractPolygon::contains(const osmium::Location& location) const noexcept {
     return inside;
 }
 
+// Only the bands overlapping the y-range of the segment a-b have to be
+// checked for crossings.
+void ExtractPolygon::boundary_crossings(const osmium::Location& a, const osmium::Location& b, std::vector<osmium::Location>* crossings) const {
+    const std::pair<int32_t, int32_t> mm = std::minmax(a.y(), b.y());
+    if (mm.second < y_min() || mm.first > y_max()) {
+        return;
+    }
+
+    const std::size_t band_min = (std::max(mm.first, y_min()) - y_min()) / m_dy;
+    const std::size_t band_max = (std::min(mm.second, y_max()) - y_min()) / m_dy;
+    assert(band_min < m_bands.size() && band_max < m_bands.size());
+
+    osmium::Location location;
+    for (auto band = band_min; band <= band_max; ++band) {
+        for (const auto& segment : m_bands[band]) {
+            if (segment_intersection(a, b, segment.first(), segment.second(), &location)) {
+                crossings->push_back(location);
+            } else if (on_segment(segment.first(), a, b)) {
+                crossings->push_back(segment.first());
+            }
+        }
+    }
+}
+
 const char* ExtractPolygon::geometry_type() const noexcept {
     return "polygon";
 }
@@ -54,6 +54,8 @@ public:
 
     bool contains(const osmium::Location& location) const noexcept override final;
 
+    void boundary_crossings(const osmium::Location& a, const osmium::Location& b, std::vector<osmium::Location>* crossings) const override final;
+
     const char* geometry_type() const noexcept override final;
 
     std::string geometry_as_text() const override final;
@@ -1,6 +1,11 @@
 
 #include "geometry_util.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
 double calculate_double_area(const std::vector<osmium::Location>& coordinates) {
     assert(coordinates.size() > 1);
 
@@ -31,3 +36,46 @@ double calculate_double_area(const std::vector<osmium::geom::Coordinates>& coord
     return total;
 }
 
+
+bool segment_intersection(const osmium::Location& a1, const osmium::Location& a2,
+                          const osmium::Location& b1, const osmium::Location& b2,
+                          osmium::Location* location) {
+    assert(location);
+
+    const double ax = static_cast<double>(a2.x()) - a1.x();
+    const double ay = static_cast<double>(a2.y()) - a1.y();
+    const double bx = static_cast<double>(b2.x()) - b1.x();
+    const double by = static_cast<double>(b2.y()) - b1.y();
+
+    const double d = ax * by - ay * bx;
+    if (d == 0.0) {
+        return false;
+    }
+
+    const double cx = static_cast<double>(b1.x()) - a1.x();
+    const double cy = static_cast<double>(b1.y()) - a1.y();
+
+    const double t = (cx * by - cy * bx) / d;
+    const double u = (cx * ay - cy * ax) / d;
+    if (t < 0.0 || t > 1.0 || u < 0.0 || u > 1.0) {
+        return false;
+    }
+
+    *location = osmium::Location{static_cast<int32_t>(std::lround(a1.x() + t * ax)),
+                                 static_cast<int32_t>(std::lround(a1.y() + t * ay))};
+    return true;
+}
+
+bool on_segment(const osmium::Location& location, const osmium::Location& a, const osmium::Location& b) noexcept {
+    const int64_t ax = static_cast<int64_t>(b.x()) - a.x();
+    const int64_t ay = static_cast<int64_t>(b.y()) - a.y();
+    const int64_t lx = static_cast<int64_t>(location.x()) - a.x();
+    const int64_t ly = static_cast<int64_t>(location.y()) - a.y();
+
+    if (ax * ly != ay * lx) {
+        return false;
+    }
+
+    return std::min(a.x(), b.x()) <= location.x() && location.x() <= std::max(a.x(), b.x()) &&
+           std::min(a.y(), b.y()) <= location.y() && location.y() <= std::max(a.y(), b.y());
+}
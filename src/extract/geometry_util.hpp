@@ -24,6 +24,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include <osmium/geom/coordinates.hpp>
+#include <osmium/osm/location.hpp>
 
 #include <vector>
 
@@ -37,4 +38,16 @@ bool is_ccw(T& coordinates) {
     return calculate_double_area(coordinates) > 0;
 }
 
+/**
+ * Calculate the intersection of the segments a1-a2 and b1-b2. Returns
+ * false if they don't intersect or are parallel, otherwise sets the
+ * location of the intersection.
+ */
+bool segment_intersection(const osmium::Location& a1, const osmium::Location& a2,
+                          const osmium::Location& b1, const osmium::Location& b2,
+                          osmium::Location* location);
+
+/// Is the location on the segment a-b (including its end points)?
+bool on_segment(const osmium::Location& location, const osmium::Location& a, const osmium::Location& b) noexcept;
+
 #endif // EXTRACT_GEOMETRY_UTIL_HPP
@@ -0,0 +1,245 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "input_boundaries.hpp"
+
+#include "../exception.hpp"
+#include "../pbf_index.hpp"
+#include "../util.hpp"
+
+#include <osmium/area/assembler.hpp>
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/index/map/sparse_mem_array.hpp>
+#include <osmium/osm/area.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+std::string InputBoundaries::request::key() const {
+    std::string result{"ids:"};
+    for (const auto id : ids) {
+        result += std::to_string(id);
+        result += ',';
+    }
+    result += " tags:";
+    for (const auto& tag : tags) {
+        result += tag;
+        result += ',';
+    }
+    return result;
+}
+
+void InputBoundaries::add(const request& req) {
+    const auto key = req.key();
+    if (m_entries.count(key)) {
+        return;
+    }
+
+    entry e;
+    e.req = req;
+    for (const auto& tag : req.tags) {
+        e.matchers.push_back(get_tag_matcher(tag));
+    }
+    m_entries.emplace(key, std::move(e));
+}
+
+bool InputBoundaries::matches(const entry& e, const osmium::Relation& relation) const {
+    if (std::find(e.req.ids.cbegin(), e.req.ids.cend(), relation.id()) != e.req.ids.cend()) {
+        return true;
+    }
+
+    if (e.matchers.empty()) {
+        return false;
+    }
+
+    return std::all_of(e.matchers.cbegin(), e.matchers.cend(), [&](const osmium::TagMatcher& matcher) {
+        return matcher(relation.tags());
+    });
+}
+
+void InputBoundaries::read_relations(const osmium::io::File& file) {
+    read_osm_file(file, osmium::osm_entity_bits::relation, osmium::io::read_meta::no, [&](osmium::memory::Buffer& buffer) {
+        for (const auto& relation : buffer.select<osmium::Relation>()) {
+            bool stored = false;
+            std::size_t offset = 0;
+            for (auto& e : m_entries) {
+                if (!matches(e.second, relation)) {
+                    continue;
+                }
+                if (!stored) {
+                    m_relations.add_item(relation);
+                    offset = m_relations.commit();
+                    stored = true;
+                    for (const auto& member : relation.members()) {
+                        if (member.type() == osmium::item_type::way) {
+                            m_way_ids.set(member.positive_ref());
+                        }
+                    }
+                }
+                e.second.relation_offsets.push_back(offset);
+            }
+        }
+    });
+}
+
+void InputBoundaries::read_ways(const osmium::io::File& file) {
+    read_osm_file(file, osmium::osm_entity_bits::way, osmium::io::read_meta::no, [&](osmium::memory::Buffer& buffer) {
+        for (const auto& way : buffer.select<osmium::Way>()) {
+            if (!m_way_ids.get(way.positive_id())) {
+                continue;
+            }
+            m_ways.add_item(way);
+            m_way_offsets[way.id()] = m_ways.commit();
+            for (const auto& node_ref : way.nodes()) {
+                m_node_ids.set(node_ref.positive_ref());
+            }
+        }
+    });
+}
+
+void InputBoundaries::read_node_locations(const osmium::io::File& file) {
+    osmium::index::map::SparseMemArray<osmium::unsigned_object_id_type, osmium::Location> index;
+
+    read_osm_file(file, osmium::osm_entity_bits::node, osmium::io::read_meta::no, [&](osmium::memory::Buffer& buffer) {
+        for (const auto& node : buffer.select<osmium::Node>()) {
+            if (m_node_ids.get(node.positive_id())) {
+                index.set(node.positive_id(), node.location());
+            }
+        }
+    });
+    index.sort();
+
+    for (auto& way : m_ways.select<osmium::Way>()) {
+        for (auto& node_ref : way.nodes()) {
+            node_ref.set_location(index.get_noexcept(node_ref.positive_ref()));
+        }
+    }
+}
+
+void InputBoundaries::assemble(entry& e) {
+    if (e.relation_offsets.empty()) {
+        throw config_error{"No matching relation found in input file."};
+    }
+
+    const osmium::area::Assembler::config_type assembler_config;
+    osmium::area::Assembler assembler{assembler_config};
+
+    bool has_ring = false;
+    {
+        osmium::builder::AreaBuilder builder{m_areas};
+        for (const auto offset : e.relation_offsets) {
+            const auto& relation = m_relations.get<osmium::Relation>(offset);
+
+            std::vector<const osmium::Way*> ways;
+            for (const auto& member : relation.members()) {
+                if (member.type() != osmium::item_type::way) {
+                    continue;
+                }
+                const auto it = m_way_offsets.find(member.ref());
+                if (it == m_way_offsets.end()) {
+                    throw config_error{"Missing way " + std::to_string(member.ref()) +
+                                       " of boundary relation " + std::to_string(relation.id()) + " in input file."};
+                }
+                const auto& way = m_ways.get<osmium::Way>(it->second);
+                for (const auto& node_ref : way.nodes()) {
+                    if (!node_ref.location().valid()) {
+                        throw config_error{"Missing or invalid node " + std::to_string(node_ref.ref()) +
+                                           " in boundary relation " + std::to_string(relation.id()) + " in input file."};
+                    }
+                }
+                ways.push_back(&way);
+            }
+
+            osmium::memory::Buffer out{1024, osmium::memory::Buffer::auto_grow::yes};
+            if (!assembler(relation, ways, out)) {
+                throw config_error{"Could not assemble (multi)polygon from boundary relation " +
+                                   std::to_string(relation.id()) + " in input file."};
+            }
+            for (const auto& area : out.select<osmium::Area>()) {
+                for (const auto& item : area) {
+                    if (item.type() == osmium::item_type::outer_ring ||
+                        item.type() == osmium::item_type::inner_ring) {
+                        builder.add_item(item);
+                        has_ring = true;
+                    }
+                }
+            }
+        }
+    }
+
+    if (!has_ring) {
+        m_areas.rollback();
+        throw config_error{"No (multi)polygon could be assembled from relations in input file."};
+    }
+
+    e.area_offset = m_areas.commit();
+}
+
+void InputBoundaries::read(const osmium::io::File& file, osmium::VerboseOutput& vout) {
+    if (m_entries.empty()) {
+        return;
+    }
+
+    if (file.filename().empty() || file.filename() == "-") {
+        throw config_error{"Can not use boundary relations from input file when reading from STDIN."};
+    }
+
+    vout << "  Reading boundary relations from input file...\n";
+    read_relations(file);
+
+    vout << "  Reading ways of boundary relations from input file...\n";
+    read_ways(file);
+
+    vout << "  Reading node locations of boundary relations from input file...\n";
+    read_node_locations(file);
+
+    for (auto& e : m_entries) {
+        try {
+            assemble(e.second);
+        } catch (...) {
+            m_areas.rollback();
+            e.second.error = std::current_exception();
+        }
+    }
+
+    vout << "  Assembled (multi)polygons from " << m_relations.select<osmium::Relation>().size() << " relation(s).\n";
+}
+
+std::size_t InputBoundaries::get(const request& req, osmium::memory::Buffer& buffer) const {
+    const auto it = m_entries.find(req.key());
+    if (it == m_entries.end()) {
+        throw config_error{"Boundary relations have not been read from input file."};
+    }
+
+    if (it->second.error) {
+        std::rethrow_exception(it->second.error);
+    }
+
+    buffer.add_item(m_areas.get<osmium::Area>(it->second.area_offset));
+    return buffer.commit();
+}
@@ -0,0 +1,110 @@
+#ifndef EXTRACT_INPUT_BOUNDARIES_HPP
+#define EXTRACT_INPUT_BOUNDARIES_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/index/id_set.hpp>
+#include <osmium/io/file.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/tags/matcher.hpp>
+#include <osmium/util/verbose_output.hpp>
+
+#include <cstddef>
+#include <exception>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Assembles (multi)polygons for extracts from boundary or multipolygon
+ * relations in the input file itself. Relations are selected by ID or by
+ * tags, all relations selected for one extract are merged into one
+ * (multi)polygon.
+ *
+ * All requests are added first, then read() makes three passes over the
+ * input file: one over the relations, one over the member ways of the
+ * selected relations, and one over the nodes of those ways.
+ */
+class InputBoundaries {
+
+public:
+
+    // Relations matching either one of the IDs or all the tag matchers.
+    struct request {
+        std::vector<osmium::object_id_type> ids;
+        std::vector<std::string> tags;
+
+        // Unique key describing this request.
+        std::string key() const;
+    };
+
+private:
+
+    struct entry {
+        request req;
+        std::vector<osmium::TagMatcher> matchers;
+        std::vector<std::size_t> relation_offsets;
+        std::size_t area_offset = 0;
+        std::exception_ptr error;
+    };
+
+    std::map<std::string, entry> m_entries;
+
+    osmium::memory::Buffer m_relations{1024UL * 1024UL, osmium::memory::Buffer::auto_grow::yes};
+    osmium::memory::Buffer m_ways{1024UL * 1024UL, osmium::memory::Buffer::auto_grow::yes};
+    osmium::memory::Buffer m_areas{1024UL * 1024UL, osmium::memory::Buffer::auto_grow::yes};
+
+    std::map<osmium::object_id_type, std::size_t> m_way_offsets;
+
+    osmium::index::IdSetDense<osmium::unsigned_object_id_type> m_way_ids;
+    osmium::index::IdSetDense<osmium::unsigned_object_id_type> m_node_ids;
+
+    bool matches(const entry& e, const osmium::Relation& relation) const;
+
+    void read_relations(const osmium::io::File& file);
+    void read_ways(const osmium::io::File& file);
+    void read_node_locations(const osmium::io::File& file);
+    void assemble(entry& e);
+
+public:
+
+    bool empty() const noexcept {
+        return m_entries.empty();
+    }
+
+    // Add a request. Requests with the same key are only handled once.
+    void add(const request& req);
+
+    // Read the input file and assemble the (multi)polygons.
+    void read(const osmium::io::File& file, osmium::VerboseOutput& vout);
+
+    // Add an area with all rings assembled for the request to the buffer
+    // and return its offset. Errors from assembling the (multi)polygon
+    // are thrown here.
+    std::size_t get(const request& req, osmium::memory::Buffer& buffer) const;
+
+}; // class InputBoundaries
+
+#endif // EXTRACT_INPUT_BOUNDARIES_HPP
@@ -0,0 +1,61 @@
+#ifndef EXTRACT_LOCATION_INDEX_HPP
+#define EXTRACT_LOCATION_INDEX_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/index/map/flex_mem.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+/**
+ * Index of node locations. Nodes with positive and negative ids are
+ * kept in separate maps indexed by the absolute value of the id, so
+ * node -5 does not overwrite node 5.
+ */
+class LocationIndex {
+
+    using map_type = osmium::index::map::FlexMem<osmium::unsigned_object_id_type, osmium::Location>;
+
+    map_type m_positive;
+    map_type m_negative;
+
+public:
+
+    void set(osmium::object_id_type id, const osmium::Location& location) {
+        if (id >= 0) {
+            m_positive.set(static_cast<osmium::unsigned_object_id_type>(id), location);
+        } else {
+            m_negative.set(static_cast<osmium::unsigned_object_id_type>(-id), location);
+        }
+    }
+
+    osmium::Location get_noexcept(osmium::object_id_type id) const noexcept {
+        if (id >= 0) {
+            return m_positive.get_noexcept(static_cast<osmium::unsigned_object_id_type>(id));
+        }
+        return m_negative.get_noexcept(static_cast<osmium::unsigned_object_id_type>(-id));
+    }
+
+}; // class LocationIndex
+
+#endif // EXTRACT_LOCATION_INDEX_HPP
@@ -0,0 +1,340 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "polygon_cache.hpp"
+
+#include "osm_file_parser.hpp"
+#include "../util.hpp"
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/osm/area.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/node_ref_list.hpp>
+#include <osmium/util/file.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+    const char magic[8] = {'O', 'S', 'M', 'P', 'O', 'L', 'Y', 'C'};
+    constexpr const uint32_t format_version = 2;
+
+    // Used to detect a cache file written on a machine with different
+    // byte order.
+    constexpr const uint32_t byte_order_mark = 0x01020304;
+
+    constexpr const std::size_t initial_buffer_size = 10UL * 1024UL;
+
+    template <typename T>
+    void append(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T)); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    }
+
+    // Reads values from the contents of a cache file. Returns false once
+    // the data is used up, a broken cache file is simply ignored.
+    class CacheReader {
+
+        const std::string& m_data;
+        std::size_t m_pos = 0;
+
+    public:
+
+        explicit CacheReader(const std::string& data) noexcept :
+            m_data(data) {
+        }
+
+        template <typename T>
+        bool get(T* value) noexcept {
+            if (m_pos + sizeof(T) > m_data.size()) {
+                return false;
+            }
+            std::memcpy(value, m_data.data() + m_pos, sizeof(T));
+            m_pos += sizeof(T);
+            return true;
+        }
+
+        bool get_string(std::string* value, std::size_t size) {
+            if (m_pos + size > m_data.size()) {
+                return false;
+            }
+            value->assign(m_data.data() + m_pos, size);
+            m_pos += size;
+            return true;
+        }
+
+        bool at_end() const noexcept {
+            return m_pos == m_data.size();
+        }
+
+    }; // class CacheReader
+
+    // Header of a cache file identifying the OSM file it was created from.
+    std::string cache_header(const std::string& file_name) {
+        std::string out{magic, sizeof(magic)};
+        append(out, format_version);
+        append(out, byte_order_mark);
+        append(out, static_cast<uint64_t>(osmium::file_size(file_name)));
+        append(out, file_mtime(file_name));
+        append(out, static_cast<uint32_t>(file_name.size()));
+        out += file_name;
+        return out;
+    }
+
+    bool read_cache(const std::string& cache_file_name, const std::string& file_name, osmium::memory::Buffer& buffer) {
+        std::ifstream file{cache_file_name, std::ios::binary};
+        if (!file) {
+            return false;
+        }
+
+        const std::string data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+
+        const auto header = cache_header(file_name);
+        if (data.size() < header.size() || data.compare(0, header.size(), header) != 0) {
+            return false;
+        }
+
+        const std::string rings = data.substr(header.size());
+        CacheReader reader{rings};
+
+        uint32_t num_rings = 0;
+        if (!reader.get(&num_rings) || num_rings == 0) {
+            return false;
+        }
+
+        std::vector<std::pair<uint32_t, std::vector<osmium::Location>>> ring_data(num_rings);
+        for (auto& ring : ring_data) {
+            uint32_t num_locations = 0;
+            if (!reader.get(&ring.first) || !reader.get(&num_locations)) {
+                return false;
+            }
+            for (uint32_t i = 0; i < num_locations; ++i) {
+                int32_t x = 0;
+                int32_t y = 0;
+                if (!reader.get(&x) || !reader.get(&y)) {
+                    return false;
+                }
+                ring.second.emplace_back(x, y);
+            }
+        }
+
+        if (!reader.at_end()) {
+            return false;
+        }
+
+        {
+            osmium::builder::AreaBuilder builder{buffer};
+            for (const auto& ring : ring_data) {
+                if (ring.first == static_cast<uint32_t>(osmium::item_type::outer_ring)) {
+                    osmium::builder::OuterRingBuilder ring_builder{builder};
+                    for (const auto& location : ring.second) {
+                        ring_builder.add_node_ref(0, location);
+                    }
+                } else {
+                    osmium::builder::InnerRingBuilder ring_builder{builder};
+                    for (const auto& location : ring.second) {
+                        ring_builder.add_node_ref(0, location);
+                    }
+                }
+            }
+        }
+
+        buffer.commit();
+        return true;
+    }
+
+    // Used to make the names of temporary files unique within the process.
+    std::atomic<unsigned int> tmp_file_counter{0};
+
+    // Write the cache file. Returns false if that didn't work.
+    bool write_cache(const std::string& cache_file_name, const std::string& file_name, const osmium::Area& area) {
+        std::string out{cache_header(file_name)};
+
+        const auto num_rings = std::count_if(area.cbegin(), area.cend(), [](const osmium::memory::Item& item) {
+            return item.type() == osmium::item_type::outer_ring ||
+                   item.type() == osmium::item_type::inner_ring;
+        });
+        append(out, static_cast<uint32_t>(num_rings));
+
+        for (const auto& item : area) {
+            if (item.type() != osmium::item_type::outer_ring &&
+                item.type() != osmium::item_type::inner_ring) {
+                continue;
+            }
+            const auto& ring = static_cast<const osmium::NodeRefList&>(item);
+            append(out, static_cast<uint32_t>(item.type()));
+            append(out, static_cast<uint32_t>(ring.size()));
+            for (const auto& node_ref : ring) {
+                append(out, node_ref.location().x());
+                append(out, node_ref.location().y());
+            }
+        }
+
+        // Write to a temporary file first, so other runs never see a
+        // partially written cache file. The name contains the process ID
+        // and a counter, so concurrent runs don't write to the same file.
+        const std::string tmp_file_name{cache_file_name + "." + std::to_string(process_id()) +
+                                        "." + std::to_string(tmp_file_counter++) + ".tmp"};
+        {
+            std::ofstream file{tmp_file_name, std::ios::binary};
+            if (!file || !file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+                file.close();
+                std::remove(tmp_file_name.c_str());
+                return false;
+            }
+        }
+
+        if (std::rename(tmp_file_name.c_str(), cache_file_name.c_str()) != 0) {
+            std::remove(tmp_file_name.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+} // anonymous namespace
+
+std::string polygon_cache_filename(const std::string& directory, const std::string& file_name) {
+    // 64 bit FNV-1a hash of the file name
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c : file_name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+
+    std::ostringstream out;
+    out << directory;
+    if (!directory.empty() && directory.back() != '/') {
+        out << '/';
+    }
+    out << std::hex << std::setw(16) << std::setfill('0') << hash << ".polycache";
+    return out.str();
+}
+
+PolygonCache::PolygonCache(std::string directory) :
+    m_directory(std::move(directory)) {
+}
+
+bool PolygonCache::load_file(const std::string& file_name, osmium::memory::Buffer& buffer) const {
+    if (m_directory.empty()) {
+        OSMFileParser parser{buffer, file_name};
+        parser();
+        return false;
+    }
+
+    const auto cache_file_name = polygon_cache_filename(m_directory, file_name);
+    if (read_cache(cache_file_name, file_name, buffer)) {
+        return true;
+    }
+
+    OSMFileParser parser{buffer, file_name};
+    const auto offset = parser();
+    if (!write_cache(cache_file_name, file_name, buffer.get<osmium::Area>(offset))) {
+        warning("Can not write polygon cache file '" + cache_file_name + "'. Continuing without cache.\n");
+    }
+
+    return false;
+}
+
+void PolygonCache::load_entry(const std::string& file_name, entry& e) const {
+    try {
+        e.buffer = osmium::memory::Buffer{initial_buffer_size, osmium::memory::Buffer::auto_grow::yes};
+        e.from_cache = load_file(file_name, e.buffer);
+    } catch (...) {
+        e.error = std::current_exception();
+    }
+    e.loaded = true;
+}
+
+void PolygonCache::count(const entry& e) noexcept {
+    if (m_directory.empty() || e.error) {
+        return;
+    }
+    if (e.from_cache) {
+        ++m_cache_hits;
+    } else {
+        ++m_cache_misses;
+    }
+}
+
+void PolygonCache::prefetch(const std::string& file_name) {
+    m_entries.emplace(file_name, entry{});
+}
+
+void PolygonCache::load(unsigned int num_threads) {
+    std::vector<std::pair<const std::string, entry>*> todo;
+    for (auto& e : m_entries) {
+        if (!e.second.loaded) {
+            todo.push_back(&e);
+        }
+    }
+
+    // The files are read with their own osmium::io::Reader each, which
+    // use the thread pool. So the loading is done on separate threads,
+    // not in the thread pool.
+    std::atomic<std::size_t> next{0};
+    std::vector<std::future<void>> workers;
+    const auto num_workers = std::min(static_cast<std::size_t>(std::max(num_threads, 1U)), todo.size());
+    for (std::size_t i = 0; i < num_workers; ++i) {
+        workers.push_back(std::async(std::launch::async, [&]() {
+            for (std::size_t n = next++; n < todo.size(); n = next++) {
+                load_entry(todo[n]->first, todo[n]->second);
+            }
+        }));
+    }
+
+    for (auto& worker : workers) {
+        worker.get();
+    }
+
+    for (const auto* e : todo) {
+        count(e->second);
+    }
+}
+
+std::size_t PolygonCache::get(const std::string& file_name, osmium::memory::Buffer& buffer) {
+    auto& e = m_entries[file_name];
+    if (!e.loaded) {
+        load_entry(file_name, e);
+        count(e);
+    }
+
+    if (e.error) {
+        std::rethrow_exception(e.error);
+    }
+
+    buffer.add_item(*e.buffer.select<osmium::Area>().begin());
+    return buffer.commit();
+}
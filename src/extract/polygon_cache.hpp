@@ -0,0 +1,100 @@
+#ifndef EXTRACT_POLYGON_CACHE_HPP
+#define EXTRACT_POLYGON_CACHE_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+
+#include <cstddef>
+#include <exception>
+#include <map>
+#include <string>
+
+/**
+ * Assembles (multi)polygons from OSM files for the extract command.
+ *
+ * If a cache directory is set, the rings of the assembled polygons are
+ * stored there in a compact binary form together with the size and
+ * mtime (in nanoseconds) of the OSM file. Later runs read the rings from
+ * the cache instead of assembling them again as long as the OSM file is
+ * unchanged. If the cache file can't be written, a warning is shown and
+ * the polygon is used uncached.
+ *
+ * Files registered with prefetch() are loaded in parallel by load().
+ */
+class PolygonCache {
+
+    struct entry {
+        osmium::memory::Buffer buffer;
+        std::exception_ptr error;
+        bool loaded = false;
+        bool from_cache = false;
+    };
+
+    std::string m_directory;
+    std::map<std::string, entry> m_entries;
+    std::size_t m_cache_hits = 0;
+    std::size_t m_cache_misses = 0;
+
+    // Get polygon from cache or assemble it from the OSM file. Returns
+    // true if it was found in the cache.
+    bool load_file(const std::string& file_name, osmium::memory::Buffer& buffer) const;
+
+    void load_entry(const std::string& file_name, entry& e) const;
+
+    void count(const entry& e) noexcept;
+
+public:
+
+    explicit PolygonCache(std::string directory = "");
+
+    const std::string& directory() const noexcept {
+        return m_directory;
+    }
+
+    // Number of polygons read from and written to the cache.
+    std::size_t cache_hits() const noexcept {
+        return m_cache_hits;
+    }
+
+    std::size_t cache_misses() const noexcept {
+        return m_cache_misses;
+    }
+
+    // Remember the file to be loaded by the next call to load().
+    void prefetch(const std::string& file_name);
+
+    // Load all files registered with prefetch() using the specified
+    // number of threads.
+    void load(unsigned int num_threads);
+
+    // Add an area with all rings from the OSM file to the buffer and
+    // return its offset. Errors from loading the file are thrown here.
+    std::size_t get(const std::string& file_name, osmium::memory::Buffer& buffer);
+
+}; // class PolygonCache
+
+// Name of the file in the cache directory for the specified OSM file.
+std::string polygon_cache_filename(const std::string& directory, const std::string& file_name);
+
+#endif // EXTRACT_POLYGON_CACHE_HPP
@@ -24,12 +24,17 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "extract.hpp"
+#include "extract_index.hpp"
+#include "../buffer_pool.hpp"
+#include "../pbf_index.hpp"
+#include "../stage_stats.hpp"
 
 #include <osmium/io/file.hpp>
 #include <osmium/io/reader.hpp>
 #include <osmium/io/writer.hpp>
 #include <osmium/memory/buffer.hpp>
 #include <osmium/memory/item.hpp>
+#include <osmium/osm/box.hpp>
 #include <osmium/osm/node.hpp>
 #include <osmium/osm/object.hpp>
 #include <osmium/osm/relation.hpp>
@@ -39,7 +44,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/util/verbose_output.hpp>
 
 #include <cassert>
+#include <cstddef>
 #include <memory>
+#include <string>
+#include <vector>
 
 template <typename T>
 class ExtractData : public T {
@@ -53,10 +61,18 @@ public:
         m_extract_ptr(&extract) {
     }
 
+    const osmium::Box& envelope() const noexcept {
+        return m_extract_ptr->envelope();
+    }
+
     bool contains(const osmium::Location& location) const noexcept {
         return m_extract_ptr->contains(location);
     }
 
+    void boundary_crossings(const osmium::Location& a, const osmium::Location& b, std::vector<osmium::Location>* crossings) const {
+        m_extract_ptr->boundary_crossings(a, b, crossings);
+    }
+
     void write(const osmium::memory::Item& item) {
         m_extract_ptr->write(item);
     }
@@ -70,12 +86,30 @@ public:
 
 class ExtractStrategy {
 
+    RunStats* m_run_stats = nullptr;
+    unsigned int m_pass = 0;
+
 public:
 
     ExtractStrategy() = default;
 
     virtual ~ExtractStrategy() = default;
 
+    // Collect statistics for each pass in these run statistics.
+    void set_run_stats(RunStats* run_stats) noexcept {
+        m_run_stats = run_stats;
+    }
+
+    // Get the statistics for the next pass over the input file or
+    // nullptr if no statistics are collected.
+    StageStats* next_pass_stats() {
+        ++m_pass;
+        if (!m_run_stats) {
+            return nullptr;
+        }
+        return &m_run_stats->stage(("pass" + std::to_string(m_pass)).c_str());
+    }
+
     virtual const char* name() const noexcept = 0;
 
     virtual void show_arguments(osmium::VerboseOutput& /*vout*/) {
@@ -89,17 +123,46 @@ public:
 template <typename TStrategy, typename TChild>
 class Pass {
 
+    // With fewer extracts checking all of them is fast enough.
+    static constexpr const std::size_t min_extracts_for_index = 8;
+
     TStrategy* m_strategy;
+    std::unique_ptr<ExtractIndex> m_index;
+
+    void build_index() {
+        if (!TChild::only_nodes_inside || extracts().size() < min_extracts_for_index) {
+            return;
+        }
 
-    void run_impl(osmium::ProgressBar& progress_bar, osmium::io::Reader& reader) {
+        std::vector<osmium::Box> envelopes;
+        envelopes.reserve(extracts().size());
+        for (const auto& e : extracts()) {
+            envelopes.push_back(e.envelope());
+        }
+        m_index = std::make_unique<ExtractIndex>(envelopes);
+    }
+
+    template <typename TReader>
+    void run_impl(osmium::ProgressBar& progress_bar, TReader& reader, StageStats* stats) {
+        build_index();
         while (osmium::memory::Buffer buffer = reader.read()) {
             progress_bar.update(reader.offset());
+            if (stats) {
+                stats->add_buffer(buffer);
+            }
             for (const auto& object : buffer) {
                 switch (object.type()) {
                     case osmium::item_type::node:
                         self().node(static_cast<const osmium::Node&>(object));
-                        for (auto& e : extracts()) {
-                            self().enode(&e, static_cast<const osmium::Node&>(object));
+                        if (m_index) {
+                            const auto& node = static_cast<const osmium::Node&>(object);
+                            m_index->for_each(node.location(), [&](std::size_t n) {
+                                self().enode(&extracts()[n], node);
+                            });
+                        } else {
+                            for (auto& e : extracts()) {
+                                self().enode(&e, static_cast<const osmium::Node&>(object));
+                            }
                         }
                         break;
                     case osmium::item_type::way:
@@ -118,6 +181,7 @@ class Pass {
                         break;
                 }
             }
+            BufferPool::instance().put(std::move(buffer));
         }
     }
 
@@ -125,6 +189,11 @@ protected:
 
     using extract_data = typename TStrategy::extract_data;
 
+    // Set this to true in derived classes if enode() only does something
+    // for nodes inside the extract. It is then only called for extracts
+    // whose envelope contains the node.
+    static constexpr const bool only_nodes_inside = false;
+
     TStrategy& strategy() {
         return *m_strategy;
     }
@@ -162,11 +231,36 @@ public:
         assert(strategy);
     }
 
+    template <typename TReader>
+    void run_with(osmium::ProgressBar& progress_bar, TReader& reader, StageStats* stats) {
+        if (!stats) {
+            run_impl(progress_bar, reader, nullptr);
+            reader.close();
+        } else {
+            const StageTimer timer{*stats};
+            run_impl(progress_bar, reader, stats);
+            stats->bytes_in += reader.offset();
+            reader.close();
+        }
+
+        // The input buffers in the pool are not needed any more, don't
+        // keep them around while the next pass or other work is done.
+        BufferPool::instance().clear();
+    }
+
+    // Local PBF files are read through a memory mapping, everything else
+    // through the usual osmium::io::Reader.
     template <typename... Args>
-    void run(osmium::ProgressBar& progress_bar, Args... args) {
-        osmium::io::Reader reader{std::forward<Args>(args)...};
-        run_impl(progress_bar, reader);
-        reader.close();
+    void run(osmium::ProgressBar& progress_bar, const osmium::io::File& file, Args... args) {
+        StageStats* stats = m_strategy->next_pass_stats();
+        if (PBFBlockReader::can_map(file)) {
+            PBFBlockReader reader{file, std::forward<Args>(args)...};
+            run_with(progress_bar, reader, stats);
+            return;
+        }
+
+        osmium::io::Reader reader{file, std::forward<Args>(args)...};
+        run_with(progress_bar, reader, stats);
     }
 
 }; // class Pass
@@ -0,0 +1,378 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "strategy_clip.hpp"
+
+#include "../util.hpp"
+
+#include <osmium/builder/attr.hpp>
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/handler/check_order.hpp>
+#include <osmium/io/error.hpp>
+#include <osmium/io/file.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/util/file.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+
+namespace strategy_clip {
+
+    Strategy::Strategy(const std::vector<std::unique_ptr<Extract>>& extracts, const osmium::Options& options) {
+        m_extracts.reserve(extracts.size());
+        for (const auto& extract : extracts) {
+            m_extracts.emplace_back(*extract);
+        }
+
+        for (const auto& option : options) {
+            warning(std::string{"Ignoring unknown option '"} + option.first + "' for 'clip' strategy.\n");
+        }
+    }
+
+    const char* Strategy::name() const noexcept {
+        return "clip";
+    }
+
+    static int64_t squared_distance(const osmium::Location& a, const osmium::Location& b) noexcept {
+        const int64_t dx = static_cast<int64_t>(b.x()) - a.x();
+        const int64_t dy = static_cast<int64_t>(b.y()) - a.y();
+        return dx * dx + dy * dy;
+    }
+
+    way_node Strategy::boundary_node(extract_data* e, const osmium::Location& location) {
+        const auto result = e->boundary_nodes.emplace(location, 0);
+        if (result.second) {
+            result.first->second = m_min_node_id - static_cast<osmium::object_id_type>(e->boundary_nodes.size());
+        }
+        return way_node{result.first->second, location, result.second};
+    }
+
+    static osmium::Location middle(const osmium::Location& a, const osmium::Location& b) noexcept {
+        return osmium::Location{static_cast<int32_t>((static_cast<int64_t>(a.x()) + b.x()) / 2),
+                                static_cast<int32_t>((static_cast<int64_t>(a.y()) + b.y()) / 2)};
+    }
+
+    /**
+     * Cut the way into the parts inside the extract. Returns true if the
+     * way is completely inside, in that case it can be used unchanged.
+     * Otherwise the parts are returned in "parts", each crossing of the
+     * boundary adds a node, unless there already is one at that location.
+     *
+     * The segments of the way are split where they touch the boundary.
+     * Each of these pieces is either completely inside or outside the
+     * extract (or on the boundary), so testing its middle tells which.
+     * Ways only touching the boundary or running along it are not cut.
+     *
+     * If a closed way starts inside the extract, its first and last part
+     * are joined. Parts of closed ways are not closed along the boundary.
+     */
+    bool Strategy::clip(extract_data* e, const osmium::Way& way, std::vector<way_part>* parts) {
+        parts->clear();
+
+        way_part part;
+        bool all_inside = true;
+
+        const auto finish_part = [&]() {
+            if (part.size() >= 2) {
+                parts->push_back(std::move(part));
+            }
+            part.clear();
+        };
+
+        // Nodes on the boundary are added with is_new set and get their
+        // ids below, once it is clear the way has to be cut.
+        way_node last{0, osmium::Location{}, false};
+        const auto add_piece = [&](const way_node& next) {
+            if (last.location.valid() && next.location.valid() && e->contains(middle(last.location, next.location))) {
+                if (part.empty()) {
+                    part.push_back(last);
+                }
+                part.push_back(next);
+            } else {
+                if (last.location.valid()) {
+                    all_inside = false;
+                }
+                finish_part();
+            }
+            last = next;
+        };
+
+        for (const auto& node_ref : way.nodes()) {
+            const osmium::Location location = m_location_index.get_noexcept(node_ref.ref());
+            if (!e->contains(location)) {
+                all_inside = false;
+            }
+
+            if (last.location.valid() && location.valid()) {
+                const osmium::Location start = last.location;
+                m_crossings.clear();
+                e->boundary_crossings(start, location, &m_crossings);
+                std::sort(m_crossings.begin(), m_crossings.end(), [&start](const osmium::Location& a, const osmium::Location& b) {
+                    return squared_distance(start, a) < squared_distance(start, b);
+                });
+                m_crossings.erase(std::unique(m_crossings.begin(), m_crossings.end()), m_crossings.end());
+
+                for (const auto& crossing : m_crossings) {
+                    if (crossing != start && crossing != location) {
+                        add_piece(way_node{0, crossing, true});
+                    }
+                }
+            }
+
+            add_piece(way_node{node_ref.ref(), location, false});
+        }
+        finish_part();
+
+        if (all_inside) {
+            return true;
+        }
+
+        // The last part of a closed way ends where the first part starts.
+        if (way.is_closed() && parts->size() > 1 &&
+            !parts->front().front().is_new && parts->front().front().id == way.nodes().front().ref() &&
+            !parts->back().back().is_new && parts->back().back().id == way.nodes().back().ref()) {
+            way_part& last_part = parts->back();
+            last_part.insert(last_part.end(), std::next(parts->front().begin()), parts->front().end());
+            parts->front() = std::move(last_part);
+            parts->pop_back();
+        }
+
+        for (auto& p : *parts) {
+            for (auto& wn : p) {
+                if (wn.is_new) {
+                    wn = boundary_node(e, wn.location);
+                }
+            }
+        }
+
+        return false;
+    }
+
+    class Pass1 : public Pass<Strategy, Pass1> {
+
+        osmium::handler::CheckOrder m_check_order;
+        osmium::memory::Buffer m_buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+        std::vector<way_part> m_parts;
+
+    public:
+
+        static constexpr const bool only_nodes_inside = true;
+
+        explicit Pass1(Strategy* strategy) :
+            Pass(strategy) {
+        }
+
+        void node(const osmium::Node& node) {
+            m_check_order.node(node);
+            strategy().m_location_index.set(node.id(), node.location());
+            strategy().m_min_node_id = std::min(strategy().m_min_node_id, node.id());
+        }
+
+        void enode(extract_data* e, const osmium::Node& node) {
+            if (e->contains(node.location())) {
+                e->write(node);
+                e->node_ids.set(node.positive_id());
+            }
+        }
+
+        void way(const osmium::Way& way) {
+            m_check_order.way(way);
+            strategy().m_min_way_id = std::min(strategy().m_min_way_id, way.id());
+        }
+
+        // The ways are only written in the second pass, here we only
+        // write the new nodes on the boundary, so that all nodes come
+        // before the ways in the output. Each of them is written only
+        // once, even if several ways cross the boundary there.
+        void eway(extract_data* e, const osmium::Way& way) {
+            if (strategy().clip(e, way, &m_parts)) {
+                return;
+            }
+
+            for (const auto& part : m_parts) {
+                for (const auto& wn : part) {
+                    if (wn.is_new) {
+                        using namespace osmium::builder::attr; // NOLINT(google-build-using-namespace)
+                        osmium::builder::add_node(m_buffer, _id(wn.id), _location(wn.location));
+                        e->write(m_buffer.get<osmium::Node>(0));
+                        m_buffer.clear();
+                    }
+                }
+            }
+        }
+
+    }; // class Pass1
+
+    class Pass2 : public Pass<Strategy, Pass2> {
+
+        osmium::handler::CheckOrder m_check_order;
+        osmium::memory::Buffer m_buffer{1024, osmium::memory::Buffer::auto_grow::yes};
+        std::vector<way_part> m_parts;
+
+        void write_part(extract_data* e, const osmium::Way& way, osmium::object_id_type id, const way_part& part) {
+            {
+                osmium::builder::WayBuilder builder{m_buffer};
+                builder.set_id(id)
+                       .set_version(way.version())
+                       .set_changeset(way.changeset())
+                       .set_timestamp(way.timestamp())
+                       .set_uid(way.uid())
+                       .set_visible(way.visible());
+                builder.set_user(way.user());
+                builder.add_item(way.tags());
+
+                osmium::builder::WayNodeListBuilder wnl_builder{builder};
+                for (const auto& wn : part) {
+                    wnl_builder.add_node_ref(wn.id);
+                }
+            }
+            m_buffer.commit();
+            e->write(m_buffer.get<osmium::Way>(0));
+            m_buffer.clear();
+        }
+
+        void write_relation(extract_data* e, const osmium::Relation& relation) {
+            {
+                osmium::builder::RelationBuilder builder{m_buffer};
+                builder.set_id(relation.id())
+                       .set_version(relation.version())
+                       .set_changeset(relation.changeset())
+                       .set_timestamp(relation.timestamp())
+                       .set_uid(relation.uid())
+                       .set_visible(relation.visible());
+                builder.set_user(relation.user());
+                builder.add_item(relation.tags());
+
+                osmium::builder::RelationMemberListBuilder rml_builder{builder};
+                for (const auto& member : relation.members()) {
+                    rml_builder.add_member(member.type(), member.ref(), member.role());
+                    if (member.type() != osmium::item_type::way) {
+                        continue;
+                    }
+                    const auto it = e->extra_parts.find(member.ref());
+                    if (it != e->extra_parts.end()) {
+                        for (const auto id : it->second) {
+                            rml_builder.add_member(osmium::item_type::way, id, member.role());
+                        }
+                    }
+                }
+            }
+            m_buffer.commit();
+            e->write(m_buffer.get<osmium::Relation>(0));
+            m_buffer.clear();
+        }
+
+    public:
+
+        explicit Pass2(Strategy* strategy) :
+            Pass(strategy) {
+        }
+
+        void way(const osmium::Way& way) {
+            m_check_order.way(way);
+        }
+
+        // Ways completely inside the extract are written unchanged. Of
+        // the ways cut into pieces the first part keeps the id of the
+        // way, all further parts get new negative ids which are
+        // remembered for the relations.
+        void eway(extract_data* e, const osmium::Way& way) {
+            if (strategy().clip(e, way, &m_parts)) {
+                e->write(way);
+                e->way_ids.set(way.positive_id());
+                return;
+            }
+
+            if (m_parts.empty()) {
+                return;
+            }
+
+            e->way_ids.set(way.positive_id());
+            write_part(e, way, way.id(), m_parts.front());
+            for (auto it = std::next(m_parts.begin()); it != m_parts.end(); ++it) {
+                const auto id = strategy().new_way_id(e);
+                e->extra_parts[way.id()].push_back(id);
+                write_part(e, way, id, *it);
+            }
+        }
+
+        void relation(const osmium::Relation& relation) {
+            m_check_order.relation(relation);
+        }
+
+        // Relations with members in the extract are written. If they
+        // have ways cut into several pieces as members, all parts of
+        // those ways are added as members with the same role.
+        void erelation(extract_data* e, const osmium::Relation& relation) {
+            bool in_extract = false;
+            bool has_cut_ways = false;
+            for (const auto& member : relation.members()) {
+                if ((member.type() == osmium::item_type::node && e->node_ids.get(member.positive_ref())) ||
+                    (member.type() == osmium::item_type::way && e->way_ids.get(member.positive_ref()))) {
+                    in_extract = true;
+                }
+                if (member.type() == osmium::item_type::way && e->extra_parts.count(member.ref()) > 0) {
+                    has_cut_ways = true;
+                }
+            }
+
+            if (!in_extract) {
+                return;
+            }
+
+            if (!has_cut_ways) {
+                e->write(relation);
+                return;
+            }
+
+            write_relation(e, relation);
+        }
+
+    }; // class Pass2
+
+    void Strategy::run(osmium::VerboseOutput& vout, bool display_progress, const osmium::io::File& input_file) {
+        if (input_file.filename().empty()) {
+            throw osmium::io_error{"Can not read from STDIN when using 'clip' strategy."};
+        }
+
+        vout << "Running 'clip' strategy in two passes...\n";
+        const std::size_t file_size = osmium::file_size(input_file.filename());
+        osmium::ProgressBar progress_bar{file_size * 2, display_progress};
+
+        vout << "First pass (of two)...\n";
+        Pass1 pass1{this};
+        pass1.run(progress_bar, input_file, osmium::osm_entity_bits::node | osmium::osm_entity_bits::way);
+        progress_bar.file_done(file_size);
+
+        progress_bar.remove();
+        vout << "Second pass (of two)...\n";
+        Pass2 pass2{this};
+        pass2.run(progress_bar, input_file, osmium::osm_entity_bits::way | osmium::osm_entity_bits::relation);
+
+        progress_bar.done();
+    }
+
+} // namespace strategy_clip
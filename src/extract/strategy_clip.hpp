@@ -0,0 +1,107 @@
+#ifndef EXTRACT_STRATEGY_CLIP_HPP
+#define EXTRACT_STRATEGY_CLIP_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "location_index.hpp"
+#include "strategy.hpp"
+
+#include <osmium/index/id_set.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace strategy_clip {
+
+    struct Data {
+        osmium::index::IdSetDense<osmium::unsigned_object_id_type> node_ids;
+        osmium::index::IdSetDense<osmium::unsigned_object_id_type> way_ids;
+
+        // Ids of the nodes created where ways cross the boundary indexed
+        // by their location, all ways crossing at the same location
+        // share one node.
+        std::map<osmium::Location, osmium::object_id_type> boundary_nodes;
+
+        // Number of additional parts of ways cut into several pieces,
+        // used for the new ids.
+        osmium::object_id_type new_ways = 0;
+
+        // Ids of the additional parts of ways cut into several pieces
+        // indexed by the id of the way.
+        std::map<osmium::object_id_type, std::vector<osmium::object_id_type>> extra_parts;
+    };
+
+    // A node in a clipped way, either from the input or created where
+    // the way crosses the boundary of the extract. In the parts returned
+    // by Strategy::clip() the flag is_new is only set the first time a
+    // node on the boundary is used.
+    struct way_node {
+        osmium::object_id_type id;
+        osmium::Location location;
+        bool is_new;
+    };
+
+    using way_part = std::vector<way_node>;
+
+    class Strategy : public ExtractStrategy {
+
+        template<typename S, typename T> friend class ::Pass;
+        friend class Pass1;
+        friend class Pass2;
+
+        using extract_data = ExtractData<Data>;
+        std::vector<extract_data> m_extracts;
+
+        LocationIndex m_location_index;
+
+        // Smallest node and way ids in the input (or 0), new objects get
+        // ids below those.
+        osmium::object_id_type m_min_node_id = 0;
+        osmium::object_id_type m_min_way_id = 0;
+
+        std::vector<osmium::Location> m_crossings;
+
+        way_node boundary_node(extract_data* e, const osmium::Location& location);
+
+        osmium::object_id_type new_way_id(extract_data* e) const noexcept {
+            return m_min_way_id - ++e->new_ways;
+        }
+
+        bool clip(extract_data* e, const osmium::Way& way, std::vector<way_part>* parts);
+
+    public:
+
+        explicit Strategy(const std::vector<std::unique_ptr<Extract>>& extracts, const osmium::Options& /*options*/);
+
+        const char* name() const noexcept override final;
+
+        void run(osmium::VerboseOutput& vout, bool display_progress, const osmium::io::File& input_file) override final;
+
+    }; // class Strategy
+
+} // namespace strategy_clip
+
+#endif // EXTRACT_STRATEGY_CLIP_HPP
@@ -66,6 +66,8 @@ namespace strategy_complete_ways {
 
     public:
 
+        static constexpr const bool only_nodes_inside = true;
+
         explicit Pass1(Strategy* strategy) :
             Pass(strategy) {
         }
@@ -55,6 +55,8 @@ namespace strategy_complete_ways_with_history {
 
     public:
 
+        static constexpr const bool only_nodes_inside = true;
+
         explicit Pass1(Strategy* strategy) :
             Pass(strategy) {
         }
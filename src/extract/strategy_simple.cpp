@@ -49,6 +49,8 @@ namespace strategy_simple {
 
     public:
 
+        static constexpr const bool only_nodes_inside = true;
+
         explicit Pass1(Strategy* strategy) :
             Pass(strategy) {
         }
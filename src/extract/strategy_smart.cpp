@@ -134,6 +134,8 @@ namespace strategy_smart {
 
     public:
 
+        static constexpr const bool only_nodes_inside = true;
+
         explicit Pass1(Strategy* strategy) :
             Pass(strategy) {
         }
@@ -0,0 +1,454 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "strategy_tiles.hpp"
+#include "extract_bbox.hpp"
+
+#include "../exception.hpp"
+#include "../util.hpp"
+
+#include <osmium/geom/mercator_projection.hpp>
+#include <osmium/geom/tile.hpp>
+#include <osmium/geom/util.hpp>
+#include <osmium/handler/check_order.hpp>
+#include <osmium/io/error.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/object_comparisons.hpp>
+#include <osmium/util/file.hpp>
+#include <osmium/util/string.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <system_error>
+#include <unordered_set>
+#include <utility>
+
+namespace strategy_tiles {
+
+    // Tiles are written with smaller buffers than normal extracts,
+    // because most of them only contain little data.
+    constexpr const std::size_t output_buffer_size = 1024UL * 1024UL;
+
+    // Initial size of the buffers collecting the data of each tile.
+    constexpr const std::size_t initial_tile_buffer_size = 16UL * 1024UL;
+
+    // Marks nodes without a valid location, tile x and y are always
+    // smaller than this.
+    constexpr const tile_key no_tile = ~tile_key{0};
+
+    Strategy::Strategy(const output_settings& settings, uint32_t zoom, const osmium::Options& options) :
+        m_settings(settings),
+        m_zoom(zoom) {
+        if (m_settings.directory.empty() || m_settings.directory.back() != '/') {
+            m_settings.directory += '/';
+        }
+
+        if (m_settings.format.empty()) {
+            m_settings.format = "pbf";
+        }
+        m_suffix = osmium::io::as_string(osmium::io::File{"", m_settings.format}.format());
+
+        for (const auto& option : options) {
+            if (option.first == "buffer-size") {
+                const auto mbytes = osmium::detail::str_to_int<std::size_t>(option.second.c_str());
+                if (mbytes == 0 && option.second != "0") {
+                    throw argument_error{"Option 'buffer-size' for 'tiles' strategy must be a number."};
+                }
+                m_max_buffered = mbytes * 1024UL * 1024UL;
+            } else if (option.first != "relations") {
+                warning(std::string{"Ignoring unknown option '"} + option.first + "' for 'tiles' strategy.\n");
+            }
+        }
+
+        if (options.is_false("relations")) {
+            m_with_relations = false;
+        }
+    }
+
+    Strategy::~Strategy() {
+        if (!m_spill_file_name.empty()) {
+            m_spill_file.close();
+            std::remove(m_spill_file_name.c_str());
+        }
+    }
+
+    const char* Strategy::name() const noexcept {
+        return "tiles";
+    }
+
+    void Strategy::show_arguments(osmium::VerboseOutput& vout) {
+        vout << "Additional strategy options:\n";
+        vout << "  - zoom level: " << m_zoom << '\n';
+        vout << "  - output: " << m_settings.directory << m_zoom << "/X/Y." << m_suffix << '\n';
+        vout << "  - [buffer-size] MBytes of tile data kept in memory: " << (m_max_buffered / (1024UL * 1024UL)) << '\n';
+        vout << "  - [relations] write relations: " << yes_no(m_with_relations);
+        vout << '\n';
+    }
+
+    // The tile is calculated directly from the location. Locations north
+    // or south of the area covered by the Mercator projection end up in
+    // the top or bottom row of tiles, locations on the antimeridian at
+    // 180 degrees east in the rightmost column.
+    tile_key Strategy::key(const osmium::Location& location) const {
+        assert(location.valid());
+        constexpr const double max_lat = osmium::geom::MERCATOR_MAX_LAT;
+        osmium::Location clamped{location};
+        clamped.set_lat(std::max(-max_lat, std::min(max_lat, location.lat_without_check())));
+
+        const osmium::geom::Tile tile{m_zoom, clamped};
+        const uint32_t max_xy = osmium::geom::num_tiles_in_zoom(m_zoom) - 1;
+        return (static_cast<tile_key>(std::min(tile.x, max_xy)) << 32U) | std::min(tile.y, max_xy);
+    }
+
+    tile_data* Strategy::data(tile_key key) {
+        const auto it = std::lower_bound(m_tiles.cbegin(), m_tiles.cend(), key);
+        if (it == m_tiles.cend() || *it != key) {
+            return nullptr;
+        }
+        return &m_tile_data[static_cast<std::size_t>(it - m_tiles.cbegin())];
+    }
+
+    // The memory used is the capacity of the tile buffers, which can be
+    // much more than the size of the objects in them.
+    void Strategy::add(tile_data* tile, const osmium::memory::Item& item) {
+        if (!tile->buffer) {
+            tile->buffer = osmium::memory::Buffer{initial_tile_buffer_size, osmium::memory::Buffer::auto_grow::yes};
+            m_buffered += tile->buffer.capacity();
+            m_in_memory.push_back(tile);
+        }
+        const auto capacity = tile->buffer.capacity();
+        tile->buffer.push_back(item);
+        m_buffered += tile->buffer.capacity() - capacity;
+        if (m_buffered > m_max_buffered) {
+            spill();
+        }
+    }
+
+    // Append the data of the tiles with the largest buffers to the
+    // temporary file until at most half of the memory allowed is used.
+    // Only the tiles with data in memory are looked at and each call
+    // frees a lot of memory, so this is cheap even for small limits.
+    // Only this one file is open, regardless of the number of tiles.
+    void Strategy::spill() {
+        if (m_spill_file_name.empty()) {
+            m_spill_file_name = m_settings.directory + std::to_string(m_zoom) + "/tiles." + std::to_string(process_id()) + ".tmp";
+            m_spill_file.open(m_spill_file_name, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!m_spill_file) {
+                throw std::system_error{errno, std::system_category(), "Could not create temporary file '" + m_spill_file_name + "'"};
+            }
+        }
+
+        std::sort(m_in_memory.begin(), m_in_memory.end(), [](const tile_data* a, const tile_data* b) {
+            return a->buffer.capacity() > b->buffer.capacity();
+        });
+
+        auto it = m_in_memory.begin();
+        for (; it != m_in_memory.end() && m_buffered > m_max_buffered / 2; ++it) {
+            auto& buffer = (*it)->buffer;
+            m_spill_file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.committed()));
+            if (!m_spill_file) {
+                throw std::system_error{errno, std::system_category(), "Write error on temporary file '" + m_spill_file_name + "'"};
+            }
+            (*it)->blocks.push_back(spill_block{m_spill_size, buffer.committed()});
+            m_spill_size += static_cast<std::streamoff>(buffer.committed());
+            m_buffered -= buffer.capacity();
+            buffer = osmium::memory::Buffer{};
+        }
+        m_in_memory.erase(m_in_memory.begin(), it);
+    }
+
+    static osmium::Box tile_envelope(uint32_t zoom, uint32_t x, uint32_t y) {
+        const double n = osmium::geom::num_tiles_in_zoom(zoom);
+        const auto lon = [n](uint32_t tx) {
+            return tx * 360.0 / n - 180.0;
+        };
+        const auto lat = [n](uint32_t ty) {
+            return osmium::geom::rad_to_deg(std::atan(std::sinh(osmium::geom::PI * (1.0 - 2.0 * ty / n))));
+        };
+        return osmium::Box{lon(x), lat(y + 1), lon(x + 1), lat(y)};
+    }
+
+    // The tiles are written one after the other, first the data from
+    // the temporary file, then the data still in memory.
+    void Strategy::write_tiles(osmium::VerboseOutput& vout) {
+        vout << "Writing " << m_tiles.size() << " tiles...\n";
+
+        if (!m_spill_file_name.empty()) {
+            vout << "  (" << show_mbytes(static_cast<std::size_t>(m_spill_size)) << " MBytes from temporary file)\n";
+            m_spill_file.flush();
+        }
+
+        const std::string zoom_directory{m_settings.directory + std::to_string(m_zoom)};
+        uint32_t last_x = 0;
+        bool first = true;
+        for (std::size_t n = 0; n < m_tiles.size(); ++n) {
+            const auto x = static_cast<uint32_t>(m_tiles[n] >> 32U);
+            const auto y = static_cast<uint32_t>(m_tiles[n] & 0xffffffffU);
+
+            const std::string directory{zoom_directory + '/' + std::to_string(x)};
+            if (first || x != last_x) {
+                create_directory(directory);
+                last_x = x;
+                first = false;
+            }
+
+            const osmium::io::File file{directory + '/' + std::to_string(y) + '.' + m_suffix, m_settings.format};
+            ExtractBBox extract{file, "", tile_envelope(m_zoom, x, y), output_buffer_size};
+
+            osmium::io::Header header{m_settings.header};
+            if (m_settings.set_bounds) {
+                header.add_box(extract.envelope());
+            }
+            extract.set_write_stats(m_settings.write_stats);
+            extract.open_file(header, m_settings.output_overwrite, m_settings.sync, m_settings.clean);
+
+            auto& tile = m_tile_data[n];
+            for (const auto& block : tile.blocks) {
+                osmium::memory::Buffer buffer{block.size, osmium::memory::Buffer::auto_grow::no};
+                m_spill_file.seekg(block.offset);
+                m_spill_file.read(reinterpret_cast<char*>(buffer.reserve_space(block.size)), static_cast<std::streamsize>(block.size));
+                if (!m_spill_file) {
+                    throw std::system_error{errno, std::system_category(), "Read error on temporary file '" + m_spill_file_name + "'"};
+                }
+                buffer.commit();
+                for (const auto& item : buffer) {
+                    extract.write(item);
+                }
+            }
+            if (tile.buffer) {
+                for (const auto& item : tile.buffer) {
+                    extract.write(item);
+                }
+            }
+            tile = tile_data{};
+
+            extract.close_file();
+        }
+    }
+
+    // Find the range of entries for the object with the given id in a
+    // vector of id_tile sorted in input order.
+    static std::pair<std::vector<id_tile>::const_iterator, std::vector<id_tile>::const_iterator>
+    find_tiles(const std::vector<id_tile>& tiles, osmium::object_id_type id) {
+        return std::equal_range(tiles.cbegin(), tiles.cend(), id_tile{id, 0}, [](const id_tile& a, const id_tile& b) {
+            return osmium::id_order{}(a.id, b.id);
+        });
+    }
+
+    class Pass1 : public Pass<Strategy, Pass1> {
+
+        osmium::handler::CheckOrder m_check_order;
+        std::unordered_set<tile_key> m_tiles;
+        std::vector<tile_key> m_node_keys;
+        std::vector<tile_key> m_object_tiles;
+        tile_key m_last_tile = no_tile;
+
+        void sort_object_tiles() {
+            std::sort(m_object_tiles.begin(), m_object_tiles.end());
+            m_object_tiles.erase(std::unique(m_object_tiles.begin(), m_object_tiles.end()), m_object_tiles.end());
+        }
+
+    public:
+
+        explicit Pass1(Strategy* strategy) :
+            Pass(strategy) {
+        }
+
+        std::vector<tile_key> tiles() const {
+            std::vector<tile_key> tiles{m_tiles.cbegin(), m_tiles.cend()};
+            std::sort(tiles.begin(), tiles.end());
+            return tiles;
+        }
+
+        // Neighbouring nodes are often in the same tile, so the set of
+        // tiles only has to be updated when the tile changes.
+        void node(const osmium::Node& node) {
+            m_check_order.node(node);
+            if (!node.location().valid()) {
+                return;
+            }
+            strategy().m_location_index.set(node.id(), node.location());
+
+            const tile_key tile = strategy().key(node.location());
+            if (tile != m_last_tile) {
+                m_tiles.insert(tile);
+                m_last_tile = tile;
+            }
+        }
+
+        // A way is in all tiles containing any of its nodes. All its
+        // nodes are added to those tiles, too.
+        void way(const osmium::Way& way) {
+            m_check_order.way(way);
+
+            m_node_keys.clear();
+            m_object_tiles.clear();
+            for (const auto& node_ref : way.nodes()) {
+                const auto location = strategy().m_location_index.get_noexcept(node_ref.ref());
+                if (location.valid()) {
+                    m_node_keys.push_back(strategy().key(location));
+                    m_object_tiles.push_back(m_node_keys.back());
+                } else {
+                    m_node_keys.push_back(no_tile);
+                }
+            }
+            sort_object_tiles();
+
+            for (const auto tile : m_object_tiles) {
+                strategy().m_way_tiles.push_back(id_tile{way.id(), tile});
+            }
+
+            auto key_it = m_node_keys.cbegin();
+            for (const auto& node_ref : way.nodes()) {
+                for (const auto tile : m_object_tiles) {
+                    if (tile != *key_it) {
+                        strategy().m_node_tiles.push_back(id_tile{node_ref.ref(), tile});
+                    }
+                }
+                ++key_it;
+            }
+        }
+
+        // A relation is in all tiles containing any of its member nodes
+        // or ways.
+        void relation(const osmium::Relation& relation) {
+            m_check_order.relation(relation);
+
+            m_object_tiles.clear();
+            for (const auto& member : relation.members()) {
+                if (member.type() == osmium::item_type::node) {
+                    const auto location = strategy().m_location_index.get_noexcept(member.ref());
+                    if (location.valid()) {
+                        m_object_tiles.push_back(strategy().key(location));
+                    }
+                } else if (member.type() == osmium::item_type::way) {
+                    const auto range = find_tiles(strategy().m_way_tiles, member.ref());
+                    for (auto it = range.first; it != range.second; ++it) {
+                        m_object_tiles.push_back(it->tile);
+                    }
+                }
+            }
+            sort_object_tiles();
+
+            for (const auto tile : m_object_tiles) {
+                strategy().m_relation_tiles.push_back(id_tile{relation.id(), tile});
+            }
+        }
+
+    }; // class Pass1
+
+    class Pass2 : public Pass<Strategy, Pass2> {
+
+        std::vector<id_tile>::const_iterator m_node_it;
+        std::vector<id_tile>::const_iterator m_way_it;
+        std::vector<id_tile>::const_iterator m_relation_it;
+
+        // The objects come in the same order as the entries in the id_tile
+        // vectors, so we only have to move forward through them.
+        void write_to_tiles(std::vector<id_tile>::const_iterator* it, const std::vector<id_tile>& tiles, const osmium::OSMObject& object) {
+            while (*it != tiles.cend() && osmium::id_order{}((*it)->id, object.id())) {
+                ++*it;
+            }
+            for (; *it != tiles.cend() && (*it)->id == object.id(); ++*it) {
+                auto* const tile = strategy().data((*it)->tile);
+                if (tile) {
+                    strategy().add(tile, object);
+                }
+            }
+        }
+
+    public:
+
+        explicit Pass2(Strategy* strategy) :
+            Pass(strategy),
+            m_node_it(strategy->m_node_tiles.cbegin()),
+            m_way_it(strategy->m_way_tiles.cbegin()),
+            m_relation_it(strategy->m_relation_tiles.cbegin()) {
+        }
+
+        void node(const osmium::Node& node) {
+            if (node.location().valid()) {
+                auto* const tile = strategy().data(strategy().key(node.location()));
+                if (tile) {
+                    strategy().add(tile, node);
+                }
+            }
+            write_to_tiles(&m_node_it, strategy().m_node_tiles, node);
+        }
+
+        void way(const osmium::Way& way) {
+            write_to_tiles(&m_way_it, strategy().m_way_tiles, way);
+        }
+
+        void relation(const osmium::Relation& relation) {
+            write_to_tiles(&m_relation_it, strategy().m_relation_tiles, relation);
+        }
+
+    }; // class Pass2
+
+    void Strategy::run(osmium::VerboseOutput& vout, bool display_progress, const osmium::io::File& input_file) {
+        if (input_file.filename().empty()) {
+            throw osmium::io_error{"Can not read from STDIN when using 'tiles' strategy."};
+        }
+
+        const auto read_types = m_with_relations ? osmium::osm_entity_bits::nwr
+                                                 : (osmium::osm_entity_bits::node | osmium::osm_entity_bits::way);
+
+        vout << "Running 'tiles' strategy in two passes...\n";
+        const std::size_t file_size = osmium::file_size(input_file.filename());
+        osmium::ProgressBar progress_bar{file_size * 2, display_progress};
+
+        vout << "First pass (of two) finding tiles for all objects...\n";
+        {
+            Pass1 pass1{this};
+            pass1.run(progress_bar, input_file, read_types, osmium::io::read_meta::no);
+            m_tiles = pass1.tiles();
+        }
+        progress_bar.file_done(file_size);
+
+        std::sort(m_node_tiles.begin(), m_node_tiles.end(), [](const id_tile& a, const id_tile& b) {
+            return osmium::id_order{}(a.id, b.id) || (a.id == b.id && a.tile < b.tile);
+        });
+        m_node_tiles.erase(std::unique(m_node_tiles.begin(), m_node_tiles.end(), [](const id_tile& a, const id_tile& b) {
+            return a.id == b.id && a.tile == b.tile;
+        }), m_node_tiles.end());
+
+        create_directory(m_settings.directory + std::to_string(m_zoom));
+        m_tile_data.resize(m_tiles.size());
+
+        progress_bar.remove();
+        vout << "Second pass (of two) collecting data for " << m_tiles.size() << " tiles...\n";
+        {
+            Pass2 pass2{this};
+            pass2.run(progress_bar, input_file, read_types);
+        }
+        progress_bar.done();
+
+        write_tiles(vout);
+    }
+
+} // namespace strategy_tiles
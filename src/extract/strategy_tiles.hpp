@@ -0,0 +1,150 @@
+#ifndef EXTRACT_STRATEGY_TILES_HPP
+#define EXTRACT_STRATEGY_TILES_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "location_index.hpp"
+#include "strategy.hpp"
+#include "../option_clean.hpp"
+
+#include <osmium/io/file.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/io/writer_options.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/memory/item.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace strategy_tiles {
+
+    // This strategy doesn't use the per-extract loops, the tiles an
+    // object is in are calculated from its location.
+    struct Data {
+    };
+
+    // Tile x and y packed into one number, so that sorting by it sorts
+    // the tiles by x and then y.
+    using tile_key = uint64_t;
+
+    // An object in a tile. Vectors of these sorted in input order are
+    // the sparse ID sets of all tiles.
+    struct id_tile {
+        osmium::object_id_type id;
+        tile_key tile;
+    };
+
+    // Part of the data of a tile written to the temporary file.
+    struct spill_block {
+        std::streamoff offset;
+        std::size_t size;
+    };
+
+    // The data of a tile collected while reading the input. It is in
+    // memory or, if there was too much data, partly in the temporary
+    // file.
+    struct tile_data {
+        osmium::memory::Buffer buffer;
+        std::vector<spill_block> blocks;
+    };
+
+    // Where and how the tiles are written.
+    struct output_settings {
+        std::string directory;
+        std::string format;
+        osmium::io::Header header;
+        osmium::io::overwrite output_overwrite = osmium::io::overwrite::no;
+        osmium::io::fsync sync = osmium::io::fsync::no;
+        const OptionClean* clean = nullptr;
+        StageStats* write_stats = nullptr;
+        bool set_bounds = false;
+    };
+
+    class Strategy : public ExtractStrategy {
+
+        template<typename S, typename T> friend class ::Pass;
+        friend class Pass1;
+        friend class Pass2;
+
+        using extract_data = ExtractData<Data>;
+        std::vector<extract_data> m_extracts; // always empty
+
+        output_settings m_settings;
+        std::string m_suffix;
+        uint32_t m_zoom;
+        std::size_t m_max_buffered = 512UL * 1024UL * 1024UL;
+        bool m_with_relations = true;
+
+        LocationIndex m_location_index;
+
+        // All tiles containing nodes, sorted
+        std::vector<tile_key> m_tiles;
+
+        std::vector<id_tile> m_node_tiles; // nodes of ways outside the tile
+        std::vector<id_tile> m_way_tiles;
+        std::vector<id_tile> m_relation_tiles;
+
+        // Data for each tile in m_tiles
+        std::vector<tile_data> m_tile_data;
+
+        // Tiles with data in m_tile_data buffers and the memory used by them
+        std::vector<tile_data*> m_in_memory;
+        std::size_t m_buffered = 0;
+
+        // Temporary file for tile data not fitting into memory
+        std::string m_spill_file_name;
+        std::fstream m_spill_file;
+        std::streamoff m_spill_size = 0;
+
+        tile_key key(const osmium::Location& location) const;
+
+        tile_data* data(tile_key key);
+
+        void add(tile_data* tile, const osmium::memory::Item& item);
+
+        void spill();
+
+        void write_tiles(osmium::VerboseOutput& vout);
+
+    public:
+
+        Strategy(const output_settings& settings, uint32_t zoom, const osmium::Options& options);
+
+        ~Strategy() override;
+
+        const char* name() const noexcept override final;
+
+        void show_arguments(osmium::VerboseOutput& vout) override final;
+
+        void run(osmium::VerboseOutput& vout, bool display_progress, const osmium::io::File& input_file) override final;
+
+    }; // class Strategy
+
+} // namespace strategy_tiles
+
+#endif // EXTRACT_STRATEGY_TILES_HPP
@@ -0,0 +1,246 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "file_stats.hpp"
+
+#include "util.hpp"
+
+#include <osmium/osm.hpp>
+#include <osmium/util/file.hpp>
+#include <osmium/visitor.hpp>
+
+#include <rapidjson/document.h>
+#include <rapidjson/istreamwrapper.h>
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+
+#include <cstdint>
+#include <fstream>
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+    const char* const counter_names[] = {"changesets", "nodes", "ways", "relations"};
+
+    int64_t get_int(const rapidjson::Value& object, const char* key) {
+        const auto it = object.FindMember(key);
+        if (it == object.MemberEnd() || !it->value.IsInt64()) {
+            throw std::runtime_error{std::string{"Missing or invalid '"} + key + "' in stats file"};
+        }
+        return it->value.GetInt64();
+    }
+
+    const rapidjson::Value& get_object(const rapidjson::Value& object, const char* key) {
+        const auto it = object.FindMember(key);
+        if (it == object.MemberEnd() || !it->value.IsObject()) {
+            throw std::runtime_error{std::string{"Missing or invalid '"} + key + "' in stats file"};
+        }
+        return it->value;
+    }
+
+} // anonymous namespace
+
+std::string stats_filename(const std::string& osm_filename) {
+    return osm_filename + ".stats";
+}
+
+std::size_t FileStats::index(osmium::item_type type) noexcept {
+    switch (type) {
+        case osmium::item_type::node:
+            return 1;
+        case osmium::item_type::way:
+            return 2;
+        case osmium::item_type::relation:
+            return 3;
+        default:
+            break;
+    }
+    return 0;
+}
+
+void FileStats::changeset(const osmium::Changeset& changeset) {
+    m_counters[0].update(changeset.id());
+}
+
+void FileStats::osm_object(const osmium::OSMObject& object) {
+    m_first_timestamp.update(object.timestamp());
+    m_last_timestamp.update(object.timestamp());
+}
+
+void FileStats::node(const osmium::Node& node) {
+    m_bounds.extend(node.location());
+    m_counters[1].update(node.id());
+}
+
+void FileStats::way(const osmium::Way& way) {
+    m_counters[2].update(way.id());
+}
+
+void FileStats::relation(const osmium::Relation& relation) {
+    m_counters[3].update(relation.id());
+}
+
+void FileStats::update(osmium::memory::Buffer& buffer) {
+    osmium::apply(buffer, *this);
+}
+
+void FileStats::write(const std::string& osm_filename) const {
+    std::ofstream file{stats_filename(osm_filename)};
+    if (!file) {
+        throw std::runtime_error{"Can not open stats file '" + stats_filename(osm_filename) + "'"};
+    }
+
+    rapidjson::OStreamWrapper stream_wrapper{file};
+    rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer{stream_wrapper};
+
+    writer.StartObject();
+
+    writer.String("file");
+    writer.StartObject();
+    writer.String("size");
+    writer.Int64(static_cast<int64_t>(osmium::file_size(osm_filename)));
+    writer.String("mtime");
+    writer.Int64(file_mtime(osm_filename));
+    writer.EndObject();
+
+    writer.String("data");
+    writer.StartObject();
+
+    if (m_bounds) {
+        writer.String("bbox");
+        writer.StartArray();
+        writer.Double(m_bounds.bottom_left().lon());
+        writer.Double(m_bounds.bottom_left().lat());
+        writer.Double(m_bounds.top_right().lon());
+        writer.Double(m_bounds.top_right().lat());
+        writer.EndArray();
+    }
+
+    if (first_timestamp() != osmium::end_of_time()) {
+        writer.String("timestamp");
+        writer.StartObject();
+        std::string s = first_timestamp().to_iso();
+        writer.String("first");
+        writer.String(s.c_str());
+        s = last_timestamp().to_iso();
+        writer.String("last");
+        writer.String(s.c_str());
+        writer.EndObject();
+    }
+
+    writer.String("count");
+    writer.StartObject();
+    for (std::size_t i = 0; i < m_counters.size(); ++i) {
+        writer.String(counter_names[i]);
+        writer.Int64(static_cast<int64_t>(m_counters[i].count));
+    }
+    writer.EndObject();
+
+    // Smallest and largest IDs are only written for object types that
+    // actually appear in the file.
+    writer.String("minid");
+    writer.StartObject();
+    for (std::size_t i = 0; i < m_counters.size(); ++i) {
+        if (m_counters[i].count > 0) {
+            writer.String(counter_names[i]);
+            writer.Int64(m_counters[i].min_id());
+        }
+    }
+    writer.EndObject();
+
+    writer.String("maxid");
+    writer.StartObject();
+    for (std::size_t i = 0; i < m_counters.size(); ++i) {
+        if (m_counters[i].count > 0) {
+            writer.String(counter_names[i]);
+            writer.Int64(m_counters[i].max_id());
+        }
+    }
+    writer.EndObject();
+
+    writer.EndObject();
+    writer.EndObject();
+
+    file << '\n';
+}
+
+bool FileStats::read(const std::string& osm_filename) {
+    std::ifstream file{stats_filename(osm_filename)};
+    if (!file) {
+        return false;
+    }
+
+    rapidjson::IStreamWrapper stream_wrapper{file};
+    rapidjson::Document doc;
+    if (doc.ParseStream(stream_wrapper).HasParseError() || !doc.IsObject()) {
+        return false;
+    }
+
+    try {
+        const auto& file_info = get_object(doc, "file");
+        if (get_int(file_info, "size") != static_cast<int64_t>(osmium::file_size(osm_filename)) ||
+            get_int(file_info, "mtime") != file_mtime(osm_filename)) {
+            return false;
+        }
+
+        const auto& data = get_object(doc, "data");
+
+        const auto bbox = data.FindMember("bbox");
+        if (bbox != data.MemberEnd()) {
+            const auto& a = bbox->value;
+            if (!a.IsArray() || a.Size() != 4 ||
+                !a[0].IsNumber() || !a[1].IsNumber() || !a[2].IsNumber() || !a[3].IsNumber()) {
+                return false;
+            }
+            m_bounds = osmium::Box{a[0].GetDouble(), a[1].GetDouble(), a[2].GetDouble(), a[3].GetDouble()};
+        }
+
+        const auto timestamp = data.FindMember("timestamp");
+        if (timestamp != data.MemberEnd()) {
+            const auto first = timestamp->value.FindMember("first");
+            const auto last = timestamp->value.FindMember("last");
+            if (first == timestamp->value.MemberEnd() || !first->value.IsString() ||
+                last == timestamp->value.MemberEnd() || !last->value.IsString()) {
+                return false;
+            }
+            m_first_timestamp.update(osmium::Timestamp{first->value.GetString()});
+            m_last_timestamp.update(osmium::Timestamp{last->value.GetString()});
+        }
+
+        const auto& count = get_object(data, "count");
+        const auto& minid = get_object(data, "minid");
+        const auto& maxid = get_object(data, "maxid");
+        for (std::size_t i = 0; i < m_counters.size(); ++i) {
+            m_counters[i].count = static_cast<uint64_t>(get_int(count, counter_names[i]));
+            if (m_counters[i].count > 0) {
+                m_counters[i].min_id.update(get_int(minid, counter_names[i]));
+                m_counters[i].max_id.update(get_int(maxid, counter_names[i]));
+            }
+        }
+    } catch (const std::exception&) { // invalid stats file, ignore it
+        return false;
+    }
+
+    return true;
+}
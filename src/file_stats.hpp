@@ -0,0 +1,111 @@
+#ifndef FILE_STATS_HPP
+#define FILE_STATS_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/handler.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/timestamp.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/util/minmax.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+/**
+ * Count and ID range of the objects of one type.
+ */
+struct FileStatsCounter {
+
+    uint64_t count = 0;
+    osmium::min_op<osmium::object_id_type> min_id{};
+    osmium::max_op<osmium::object_id_type> max_id{};
+
+    void update(osmium::object_id_type id) noexcept {
+        ++count;
+        min_id.update(id);
+        max_id.update(id);
+    }
+
+}; // struct FileStatsCounter
+
+/**
+ * Statistics about the contents of an OSM file that can be stored in a
+ * sidecar file next to it. The sidecar file has the name of the OSM file
+ * with ".stats" appended. The "fileinfo" command can answer some queries
+ * from the sidecar file without reading the whole OSM file.
+ */
+class FileStats : public osmium::handler::Handler {
+
+    osmium::Box m_bounds;
+    osmium::min_op<osmium::Timestamp> m_first_timestamp;
+    osmium::max_op<osmium::Timestamp> m_last_timestamp;
+
+    // indexed by item type: changeset, node, way, relation
+    std::array<FileStatsCounter, 4> m_counters;
+
+    static std::size_t index(osmium::item_type type) noexcept;
+
+public:
+
+    const osmium::Box& bounds() const noexcept {
+        return m_bounds;
+    }
+
+    osmium::Timestamp first_timestamp() const noexcept {
+        return m_first_timestamp();
+    }
+
+    osmium::Timestamp last_timestamp() const noexcept {
+        return m_last_timestamp();
+    }
+
+    const FileStatsCounter& counter(osmium::item_type type) const noexcept {
+        return m_counters[index(type)];
+    }
+
+    void changeset(const osmium::Changeset& changeset);
+    void osm_object(const osmium::OSMObject& object);
+    void node(const osmium::Node& node);
+    void way(const osmium::Way& way);
+    void relation(const osmium::Relation& relation);
+
+    void update(osmium::memory::Buffer& buffer);
+
+    // Write statistics to the sidecar file of the OSM file with the
+    // given name. The OSM file must be complete at this point.
+    void write(const std::string& osm_filename) const;
+
+    // Read statistics from the sidecar file of the OSM file with the
+    // given name. Returns false if there is no sidecar file or if it
+    // doesn't match the OSM file.
+    bool read(const std::string& osm_filename);
+
+}; // class FileStats
+
+std::string stats_filename(const std::string& osm_filename);
+
+#endif // FILE_STATS_HPP
@@ -0,0 +1,136 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "id_range.hpp"
+
+#include <osmium/io/reader.hpp>
+#include <osmium/thread/pool.hpp>
+
+#include <zlib.h>
+
+#include <utility>
+
+namespace {
+
+    // Maximum number of buffers handed to the worker threads which
+    // haven't been split into ranges yet.
+    constexpr const std::size_t max_pending_buffers = 20;
+
+    std::vector<IdRange> split_buffer(const std::shared_ptr<osmium::memory::Buffer>& buffer, unsigned int range_bits) {
+        std::vector<IdRange> ranges;
+
+        for (auto& object : buffer->select<osmium::OSMObject>()) {
+            const IdRangeKey key{object, range_bits};
+            if (ranges.empty() || !(ranges.back().key() == key)) {
+                ranges.emplace_back(key, buffer);
+            }
+            ranges.back().add(object);
+        }
+
+        return ranges;
+    }
+
+} // anonymous namespace
+
+IdRange::IdRange() :
+    m_crc32(::crc32(0, nullptr, 0)),
+    m_adler32(::adler32(0, nullptr, 0)) {
+}
+
+IdRange::IdRange(const IdRangeKey& key, std::shared_ptr<osmium::memory::Buffer> buffer) :
+    m_key(key),
+    m_buffers({std::move(buffer)}),
+    m_crc32(::crc32(0, nullptr, 0)),
+    m_adler32(::adler32(0, nullptr, 0)) {
+}
+
+void IdRange::add(osmium::OSMObject& object) {
+    m_objects.push_back(&object);
+    m_crc32 = ::crc32(m_crc32, object.data(), object.byte_size());
+    m_adler32 = ::adler32(m_adler32, object.data(), object.byte_size());
+    m_length += object.byte_size();
+}
+
+void IdRange::append(IdRange&& other) {
+    m_objects.insert(m_objects.end(), other.m_objects.cbegin(), other.m_objects.cend());
+    for (auto& buffer : other.m_buffers) {
+        if (m_buffers.empty() || m_buffers.back() != buffer) {
+            m_buffers.push_back(std::move(buffer));
+        }
+    }
+    m_crc32 = ::crc32_combine(m_crc32, other.m_crc32, static_cast<z_off_t>(other.m_length));
+    m_adler32 = ::adler32_combine(m_adler32, other.m_adler32, static_cast<z_off_t>(other.m_length));
+    m_length += other.m_length;
+}
+
+bool IdRangeReader::fetch() {
+    auto& pool = osmium::thread::Pool::default_instance();
+    const auto range_bits = m_range_bits;
+
+    while (!m_eof && m_pending.size() < max_pending_buffers) {
+        auto buffer = std::make_shared<osmium::memory::Buffer>(m_reader.read());
+        if (!*buffer) {
+            m_eof = true;
+            break;
+        }
+        m_pending.push_back(pool.submit([buffer, range_bits]() {
+            return split_buffer(buffer, range_bits);
+        }));
+    }
+
+    if (m_pending.empty()) {
+        return false;
+    }
+
+    for (auto& range : m_pending.front().get()) {
+        m_ranges.push_back(std::move(range));
+    }
+    m_pending.pop_front();
+
+    return true;
+}
+
+IdRange IdRangeReader::next() {
+    while (true) {
+        if (m_ranges.empty()) {
+            if (!fetch()) {
+                IdRange range{std::move(m_current)};
+                m_current = IdRange{};
+                return range;
+            }
+            continue;
+        }
+
+        IdRange front{std::move(m_ranges.front())};
+        m_ranges.pop_front();
+
+        if (m_current.empty()) {
+            m_current = std::move(front);
+        } else if (front.key() == m_current.key()) {
+            m_current.append(std::move(front));
+        } else {
+            IdRange range{std::move(m_current)};
+            m_current = std::move(front);
+            return range;
+        }
+    }
+}
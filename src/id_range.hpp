@@ -0,0 +1,156 @@
+#ifndef ID_RANGE_HPP
+#define ID_RANGE_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/object.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+namespace osmium {
+    namespace io {
+        class Reader;
+    } // namespace io
+} // namespace osmium
+
+/**
+ * Identifies a range of IDs of one object type. The order of the keys is
+ * the same as the usual order of objects in OSM files (by type, then
+ * negative IDs before positive IDs, then by absolute value of the ID).
+ */
+struct IdRangeKey {
+
+    osmium::item_type type = osmium::item_type::undefined;
+    bool positive = false;
+    osmium::unsigned_object_id_type index = 0;
+
+    IdRangeKey() noexcept = default;
+
+    IdRangeKey(const osmium::OSMObject& object, unsigned int range_bits) noexcept :
+        type(object.type()),
+        positive(object.id() > 0),
+        index(object.positive_id() >> range_bits) {
+    }
+
+    friend bool operator==(const IdRangeKey& lhs, const IdRangeKey& rhs) noexcept {
+        return lhs.type == rhs.type && lhs.positive == rhs.positive && lhs.index == rhs.index;
+    }
+
+    friend bool operator<(const IdRangeKey& lhs, const IdRangeKey& rhs) noexcept {
+        return std::tie(lhs.type, lhs.positive, lhs.index) < std::tie(rhs.type, rhs.positive, rhs.index);
+    }
+
+}; // struct IdRangeKey
+
+/**
+ * All objects from an OSM file in one ID range together with checksums
+ * (CRC32 and Adler-32) over their binary representation. If the
+ * checksums of two ranges are the same, the ranges contain the same
+ * objects and don't have to be compared object by object.
+ *
+ * The range keeps the buffers the objects are in alive.
+ */
+class IdRange {
+
+    IdRangeKey m_key;
+    std::vector<osmium::OSMObject*> m_objects;
+    std::vector<std::shared_ptr<osmium::memory::Buffer>> m_buffers;
+    unsigned long m_crc32;
+    unsigned long m_adler32;
+    uint64_t m_length = 0;
+
+public:
+
+    IdRange();
+
+    IdRange(const IdRangeKey& key, std::shared_ptr<osmium::memory::Buffer> buffer);
+
+    const IdRangeKey& key() const noexcept {
+        return m_key;
+    }
+
+    bool empty() const noexcept {
+        return m_objects.empty();
+    }
+
+    std::size_t size() const noexcept {
+        return m_objects.size();
+    }
+
+    const std::vector<osmium::OSMObject*>& objects() const noexcept {
+        return m_objects;
+    }
+
+    void add(osmium::OSMObject& object);
+
+    // Append another range with the same key read after this one.
+    void append(IdRange&& other);
+
+    // Do both ranges (very likely) contain the same objects?
+    bool same_content(const IdRange& other) const noexcept {
+        return m_length == other.m_length &&
+               m_objects.size() == other.m_objects.size() &&
+               m_crc32 == other.m_crc32 &&
+               m_adler32 == other.m_adler32;
+    }
+
+}; // class IdRange
+
+/**
+ * Reads an OSM file sorted by type and ID and returns the objects grouped
+ * into ranges of 2^range_bits IDs. The checksums are calculated on the
+ * worker threads.
+ */
+class IdRangeReader {
+
+    osmium::io::Reader& m_reader;
+    unsigned int m_range_bits;
+    std::deque<std::future<std::vector<IdRange>>> m_pending;
+    std::deque<IdRange> m_ranges;
+    IdRange m_current;
+    bool m_eof = false;
+
+    bool fetch();
+
+public:
+
+    IdRangeReader(osmium::io::Reader& reader, unsigned int range_bits) :
+        m_reader(reader),
+        m_range_bits(range_bits) {
+    }
+
+    // Get the next range. Returns an empty range at the end of the file.
+    IdRange next();
+
+}; // class IdRangeReader
+
+#endif // ID_RANGE_HPP
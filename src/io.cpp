@@ -22,11 +22,13 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "cmd.hpp"
 #include "exception.hpp"
+#include "pbf_index.hpp"
 #include "util.hpp"
 
 #include <osmium/io/any_input.hpp> // IWYU pragma: keep
 #include <osmium/io/any_output.hpp> // IWYU pragma: keep
 #include <osmium/io/file.hpp>
+#include <osmium/io/file_format.hpp>
 #include <osmium/io/header.hpp>
 #include <osmium/io/writer_options.hpp>
 #include <osmium/util/verbose_output.hpp>
@@ -152,6 +154,14 @@ void with_osm_output::init_output_file(const po::variables_map& vm) {
     if (vm.count("fsync")) {
         m_fsync = osmium::io::fsync::yes;
     }
+
+    if (vm.count("write-stats")) {
+        m_write_stats = true;
+    }
+
+    if (vm.count("write-index")) {
+        m_write_index = true;
+    }
 }
 
 void with_osm_output::check_output_file() {
@@ -166,8 +176,20 @@ void with_osm_output::check_output_file() {
         }
     }
 
+    if (m_write_stats && (m_output_filename.empty() || m_output_filename == "-")) {
+        throw argument_error{"Can not use --write-stats when writing to STDOUT."};
+    }
+
+    if (m_write_index && (m_output_filename.empty() || m_output_filename == "-")) {
+        throw argument_error{"Can not use --write-index when writing to STDOUT."};
+    }
+
     m_output_file = osmium::io::File{m_output_filename, m_output_format};
     m_output_file.check();
+
+    if (m_write_index && m_output_file.format() != osmium::io::file_format::pbf) {
+        throw argument_error{"The --write-index option only works for PBF output files."};
+    }
 }
 
 void with_osm_output::setup_output_file(const po::variables_map& vm) {
@@ -197,6 +219,12 @@ void with_osm_output::show_output_arguments(osmium::VerboseOutput& vout) {
     vout << "    generator: " << m_generator << "\n";
     vout << "    overwrite: " << yes_no(m_output_overwrite == osmium::io::overwrite::allow);
     vout << "    fsync: " << yes_no(m_fsync == osmium::io::fsync::yes);
+    if (m_write_stats) {
+        vout << "    stats file: " << stats_filename(m_output_filename) << "\n";
+    }
+    if (m_write_index) {
+        vout << "    index file: " << pbf_index_filename(m_output_filename) << "\n";
+    }
     if (!m_output_headers.empty()) {
         vout << "    output header:\n";
         for (const auto& h : m_output_headers) {
@@ -212,6 +240,20 @@ void with_osm_output::setup_header(osmium::io::Header& header) const {
     }
 }
 
+void with_osm_output::write_output_stats() const {
+    if (m_write_stats) {
+        m_output_stats.write(m_output_filename);
+    }
+}
+
+void with_osm_output::write_output_index() const {
+    if (m_write_index) {
+        PBFIndex index;
+        index.create(m_output_filename);
+        index.write(m_output_filename);
+    }
+}
+
 void init_header(osmium::io::Header& header, const osmium::io::Header& input_header, const std::vector<std::string>& options) {
     for (const auto& h : options) {
         if (!h.empty() && h.back() == '!') {
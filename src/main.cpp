@@ -128,7 +128,12 @@ int main(int argc, char* argv[]) {
     cmd->print_arguments(command);
 
     try {
-        if (cmd->run()) {
+        // Statistics and metrics are also written when the command
+        // finished normally but reports a result like differences found.
+        const bool result = cmd->run();
+        cmd->show_stats();
+        cmd->write_metrics();
+        if (result) {
             return return_code::okay;
         }
     } catch (const std::bad_alloc&) {
@@ -24,9 +24,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "exception.hpp"
 
+#include <osmium/osm/metadata_options.hpp>
 #include <osmium/osm/object.hpp>
 #include <osmium/osm/types.hpp>
 
+#include <string>
+
 void OptionClean::setup(const boost::program_options::variables_map& vm) {
     if (vm.count("clean")) {
         for (const auto& c : vm["clean"].as<std::vector<std::string>>()) {
@@ -67,6 +70,39 @@ void OptionClean::clean_buffer(osmium::memory::Buffer& buffer) const {
     }
 }
 
+void OptionClean::apply_to(osmium::io::File& file) const {
+    if (!m_clean_attrs) {
+        return;
+    }
+
+    // Keep attributes already disabled on the output file disabled.
+    const osmium::metadata_options metadata{file.get("add_metadata")};
+
+    std::string attributes;
+    if (metadata.version() && !(m_clean_attrs & clean_options::clean_version)) {
+        attributes += "version+";
+    }
+    if (metadata.timestamp() && !(m_clean_attrs & clean_options::clean_timestamp)) {
+        attributes += "timestamp+";
+    }
+    if (metadata.changeset() && !(m_clean_attrs & clean_options::clean_changeset)) {
+        attributes += "changeset+";
+    }
+    if (metadata.uid() && !(m_clean_attrs & clean_options::clean_uid)) {
+        attributes += "uid+";
+    }
+    if (metadata.user() && !(m_clean_attrs & clean_options::clean_user)) {
+        attributes += "user+";
+    }
+
+    if (attributes.empty()) {
+        file.set("add_metadata", "none");
+    } else {
+        attributes.resize(attributes.size() - 1);
+        file.set("add_metadata", attributes);
+    }
+}
+
 std::string OptionClean::to_string() const {
     if (!m_clean_attrs) {
         return "(none)";
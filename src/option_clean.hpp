@@ -23,6 +23,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 */
 
+#include <osmium/io/file.hpp>
 #include <osmium/memory/buffer.hpp>
 
 #include <boost/program_options.hpp>
@@ -47,12 +48,19 @@ public:
 
     void setup(const boost::program_options::variables_map& vm);
 
+    // Clean the attributes of all objects in the buffer. Only needed if
+    // the data is used for something else than writing it out.
     void apply_to(osmium::memory::Buffer& buffer) const {
         if (m_clean_attrs) {
             clean_buffer(buffer);
         }
     }
 
+    // Set the 'add_metadata' option on the output file so that the
+    // cleaned attributes are not written out. This is much cheaper than
+    // cleaning the objects in the buffers.
+    void apply_to(osmium::io::File& file) const;
+
     std::string to_string() const;
 }; // class OptionClean
 
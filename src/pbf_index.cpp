@@ -0,0 +1,748 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "pbf_index.hpp"
+
+#include "util.hpp"
+
+#include <osmium/io/detail/pbf_decoder.hpp>
+#include <osmium/io/detail/read_write.hpp>
+#include <osmium/io/error.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/thread/pool.hpp>
+#include <osmium/util/file.hpp>
+#include <osmium/util/progress_bar.hpp>
+
+#include <protozero/pbf_reader.hpp>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+namespace {
+
+    const char magic[8] = {'O', 'S', 'M', 'P', 'B', 'I', 'D', 'X'};
+    constexpr const uint32_t format_version = 1;
+
+    // Used to detect an index written on a machine with different byte order.
+    constexpr const uint32_t byte_order_mark = 0x01020304;
+
+    // Limits from the PBF format specification.
+    constexpr const uint32_t max_blob_header_size = 64UL * 1024UL;
+    constexpr const uint32_t max_blob_size = 32UL * 1024UL * 1024UL;
+
+    // Maximum number of blobs handed to the worker threads for decoding
+    // which haven't been processed yet.
+    constexpr const std::size_t max_pending_blocks = 20;
+
+    // Field numbers in the BlobHeader message.
+    constexpr const protozero::pbf_tag_type blob_header_type = 1;
+    constexpr const protozero::pbf_tag_type blob_header_datasize = 3;
+
+    template <typename T>
+    void append(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T)); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    }
+
+    std::runtime_error broken_index(const std::string& filename) {
+        return std::runtime_error{"PBF index file '" + filename + "' is broken."};
+    }
+
+    uint32_t get_size(const char* data) noexcept {
+        const auto* d = reinterpret_cast<const unsigned char*>(data); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+        return (static_cast<uint32_t>(d[0]) << 24U) |
+               (static_cast<uint32_t>(d[1]) << 16U) |
+               (static_cast<uint32_t>(d[2]) <<  8U) |
+                static_cast<uint32_t>(d[3]);
+    }
+
+    // Decode the BlobHeader message and return the type and the size of
+    // the blob following it.
+    std::pair<std::string, uint32_t> decode_blob_header(const protozero::data_view& data) {
+        std::pair<std::string, uint32_t> result{"", 0};
+
+        protozero::pbf_reader reader{data};
+        while (reader.next()) {
+            switch (reader.tag_and_type()) {
+                case protozero::tag_and_type(blob_header_type, protozero::pbf_wire_type::length_delimited):
+                    result.first = reader.get_string();
+                    break;
+                case protozero::tag_and_type(blob_header_datasize, protozero::pbf_wire_type::varint):
+                    result.second = static_cast<uint32_t>(reader.get_int32());
+                    break;
+                default:
+                    reader.skip();
+            }
+        }
+
+        if (result.second > max_blob_size) {
+            throw osmium::pbf_error{"invalid Blob size (> max_blob_size)"};
+        }
+
+        return result;
+    }
+
+    // A blob in a memory mapped PBF file.
+    struct BlobRef {
+        std::string type;
+        protozero::data_view data;
+        uint64_t size = 0;
+    };
+
+    // Get the blob at the given offset of the file data, which ends at
+    // the specified end.
+    BlobRef get_blob(const char* file_data, uint64_t offset, uint64_t end) {
+        if (end - offset < 4) {
+            throw osmium::pbf_error{"truncated data (EOF encountered)"};
+        }
+
+        const auto header_size = get_size(file_data + offset);
+        if (header_size > max_blob_header_size) {
+            throw osmium::pbf_error{"invalid BlobHeader size (> max_blob_header_size)"};
+        }
+        if (end - offset - 4 < header_size) {
+            throw osmium::pbf_error{"truncated data (EOF encountered)"};
+        }
+
+        const auto header = decode_blob_header(protozero::data_view{file_data + offset + 4, header_size});
+        if (end - offset - 4 - header_size < header.second) {
+            throw osmium::pbf_error{"truncated data (EOF encountered)"};
+        }
+
+        BlobRef blob;
+        blob.type = header.first;
+        blob.data = protozero::data_view{file_data + offset + 4 + header_size, header.second};
+        blob.size = 4 + header_size + header.second;
+        return blob;
+    }
+
+    // Field numbers in the Blob message.
+    constexpr const protozero::pbf_tag_type blob_raw = 1;
+    constexpr const protozero::pbf_tag_type blob_raw_size = 2;
+    constexpr const protozero::pbf_tag_type blob_zlib_data = 3;
+
+    // Get the contents of a Blob message. Uncompressed data is returned
+    // directly, zlib compressed data is uncompressed into the output
+    // string. Other compression formats are handed to libosmium (which
+    // needs a copy of the data).
+    protozero::data_view uncompress_blob(const protozero::data_view& blob, std::string& output) {
+        protozero::data_view zlib_data;
+        int32_t raw_size = 0;
+
+        protozero::pbf_reader message{blob};
+        while (message.next()) {
+            switch (message.tag_and_type()) {
+                case protozero::tag_and_type(blob_raw, protozero::pbf_wire_type::length_delimited):
+                    return message.get_view();
+                case protozero::tag_and_type(blob_raw_size, protozero::pbf_wire_type::varint):
+                    raw_size = message.get_int32();
+                    break;
+                case protozero::tag_and_type(blob_zlib_data, protozero::pbf_wire_type::length_delimited):
+                    zlib_data = message.get_view();
+                    break;
+                default:
+                    message.skip();
+            }
+        }
+
+        if (zlib_data.data() && raw_size >= 0 && static_cast<uint32_t>(raw_size) <= max_blob_size) {
+            output.resize(static_cast<std::size_t>(raw_size));
+            auto size = static_cast<uLongf>(raw_size);
+            if (::uncompress(reinterpret_cast<Bytef*>(&output[0]), &size, reinterpret_cast<const Bytef*>(zlib_data.data()), static_cast<uLong>(zlib_data.size())) != Z_OK || size != static_cast<uLongf>(raw_size)) { // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+                throw osmium::pbf_error{"failed to uncompress data"};
+            }
+            return protozero::data_view{output.data(), output.size()};
+        }
+
+        const std::string data{blob.data(), blob.size()};
+        const auto view = osmium::io::detail::decode_blob(data, output);
+        std::string decoded{view.data(), view.size()};
+        output.swap(decoded);
+        return protozero::data_view{output.data(), output.size()};
+    }
+
+    osmium::util::MemoryMapping map_file(const std::string& filename, uint64_t file_size) {
+        const int fd = osmium::io::detail::open_for_reading(filename);
+        osmium::util::MemoryMapping mapping{file_size, osmium::util::MemoryMapping::mapping_mode::readonly, fd};
+        osmium::io::detail::reliable_close(fd);
+        return mapping;
+    }
+
+    std::size_t page_size() noexcept {
+#ifdef _WIN32
+        return 4096;
+#else
+        return static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+    enum class access_hint {
+        sequential,
+        not_needed
+    };
+
+    // Tell the kernel how we are going to use this part of the mapping.
+    // This is only a hint, so errors are ignored.
+    void advise(osmium::util::MemoryMapping& mapping, uint64_t offset, uint64_t size, access_hint hint) noexcept {
+#ifdef _WIN32
+        (void)mapping;
+        (void)offset;
+        (void)size;
+        (void)hint;
+#else
+        ::madvise(mapping.get_addr<char>() + offset, size,
+                  hint == access_hint::sequential ? MADV_SEQUENTIAL : MADV_DONTNEED);
+#endif
+    }
+
+    // Field numbers in the PrimitiveBlock, PrimitiveGroup, Node,
+    // DenseNodes, Way, and Relation messages. Only the fields needed for
+    // the index are decoded, everything else is skipped.
+    constexpr const protozero::pbf_tag_type primitive_block_group = 2;
+    constexpr const protozero::pbf_tag_type primitive_block_granularity = 17;
+    constexpr const protozero::pbf_tag_type primitive_block_lat_offset = 19;
+    constexpr const protozero::pbf_tag_type primitive_block_lon_offset = 20;
+    constexpr const protozero::pbf_tag_type group_nodes = 1;
+    constexpr const protozero::pbf_tag_type group_dense = 2;
+    constexpr const protozero::pbf_tag_type group_ways = 3;
+    constexpr const protozero::pbf_tag_type group_relations = 4;
+    constexpr const protozero::pbf_tag_type object_id = 1;
+    constexpr const protozero::pbf_tag_type node_lat = 8;
+    constexpr const protozero::pbf_tag_type node_lon = 9;
+
+    // PBF coordinates are in nanodegrees, osmium::Location uses 1/10^7
+    // degrees.
+    constexpr const int64_t resolution_convert = 100;
+
+    class BlockScanner {
+
+        PBFBlock m_block;
+        int64_t m_granularity = 100;
+        int64_t m_lat_offset = 0;
+        int64_t m_lon_offset = 0;
+
+        void add_object(osmium::item_type type, osmium::object_id_type id) noexcept {
+            if (m_block.count == 0) {
+                m_block.min_id = id;
+                m_block.max_id = id;
+            } else {
+                m_block.min_id = std::min(m_block.min_id, id);
+                m_block.max_id = std::max(m_block.max_id, id);
+            }
+            ++m_block.count;
+            m_block.types |= osmium::osm_entity_bits::from_item_type(type);
+        }
+
+        void add_location(int64_t lat, int64_t lon) noexcept {
+            const osmium::Location location{
+                static_cast<int32_t>((m_lon_offset + m_granularity * lon) / resolution_convert),
+                static_cast<int32_t>((m_lat_offset + m_granularity * lat) / resolution_convert)
+            };
+            if (location.valid()) {
+                m_block.bounds.extend(location);
+            }
+        }
+
+        void scan_node(protozero::pbf_reader message) {
+            osmium::object_id_type id = 0;
+            int64_t lat = 0;
+            int64_t lon = 0;
+            while (message.next()) {
+                switch (message.tag_and_type()) {
+                    case protozero::tag_and_type(object_id, protozero::pbf_wire_type::varint):
+                        id = message.get_sint64();
+                        break;
+                    case protozero::tag_and_type(node_lat, protozero::pbf_wire_type::varint):
+                        lat = message.get_sint64();
+                        break;
+                    case protozero::tag_and_type(node_lon, protozero::pbf_wire_type::varint):
+                        lon = message.get_sint64();
+                        break;
+                    default:
+                        message.skip();
+                }
+            }
+            add_object(osmium::item_type::node, id);
+            add_location(lat, lon);
+        }
+
+        void scan_dense_nodes(protozero::pbf_reader message) {
+            protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> ids;
+            protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> lats;
+            protozero::iterator_range<protozero::pbf_reader::const_sint64_iterator> lons;
+            while (message.next()) {
+                switch (message.tag_and_type()) {
+                    case protozero::tag_and_type(object_id, protozero::pbf_wire_type::length_delimited):
+                        ids = message.get_packed_sint64();
+                        break;
+                    case protozero::tag_and_type(node_lat, protozero::pbf_wire_type::length_delimited):
+                        lats = message.get_packed_sint64();
+                        break;
+                    case protozero::tag_and_type(node_lon, protozero::pbf_wire_type::length_delimited):
+                        lons = message.get_packed_sint64();
+                        break;
+                    default:
+                        message.skip();
+                }
+            }
+
+            // IDs and coordinates are delta encoded.
+            osmium::object_id_type id = 0;
+            int64_t lat = 0;
+            int64_t lon = 0;
+            auto lat_it = lats.begin();
+            auto lon_it = lons.begin();
+            for (const auto delta : ids) {
+                id += delta;
+                add_object(osmium::item_type::node, id);
+                if (lat_it != lats.end() && lon_it != lons.end()) {
+                    lat += *lat_it++;
+                    lon += *lon_it++;
+                    add_location(lat, lon);
+                }
+            }
+        }
+
+        void scan_object(osmium::item_type type, protozero::pbf_reader message) {
+            osmium::object_id_type id = 0;
+            while (message.next(object_id, protozero::pbf_wire_type::varint)) {
+                id = message.get_int64();
+            }
+            add_object(type, id);
+        }
+
+        void scan_group(protozero::pbf_reader message) {
+            while (message.next()) {
+                switch (message.tag_and_type()) {
+                    case protozero::tag_and_type(group_nodes, protozero::pbf_wire_type::length_delimited):
+                        scan_node(message.get_message());
+                        break;
+                    case protozero::tag_and_type(group_dense, protozero::pbf_wire_type::length_delimited):
+                        scan_dense_nodes(message.get_message());
+                        break;
+                    case protozero::tag_and_type(group_ways, protozero::pbf_wire_type::length_delimited):
+                        scan_object(osmium::item_type::way, message.get_message());
+                        break;
+                    case protozero::tag_and_type(group_relations, protozero::pbf_wire_type::length_delimited):
+                        scan_object(osmium::item_type::relation, message.get_message());
+                        break;
+                    default:
+                        message.skip();
+                }
+            }
+        }
+
+    public:
+
+        BlockScanner(uint64_t offset, uint64_t size) noexcept {
+            m_block.offset = offset;
+            m_block.size = size;
+        }
+
+        // Get the information for the index from a PrimitiveBlock without
+        // decoding tags, way nodes, relation members, or metadata.
+        PBFBlock operator()(const protozero::data_view& data) {
+            std::vector<protozero::data_view> groups;
+
+            // The coordinate settings come after the groups in the block.
+            protozero::pbf_reader message{data};
+            while (message.next()) {
+                switch (message.tag_and_type()) {
+                    case protozero::tag_and_type(primitive_block_group, protozero::pbf_wire_type::length_delimited):
+                        groups.push_back(message.get_view());
+                        break;
+                    case protozero::tag_and_type(primitive_block_granularity, protozero::pbf_wire_type::varint):
+                        m_granularity = message.get_int32();
+                        break;
+                    case protozero::tag_and_type(primitive_block_lat_offset, protozero::pbf_wire_type::varint):
+                        m_lat_offset = message.get_int64();
+                        break;
+                    case protozero::tag_and_type(primitive_block_lon_offset, protozero::pbf_wire_type::varint):
+                        m_lon_offset = message.get_int64();
+                        break;
+                    default:
+                        message.skip();
+                }
+            }
+
+            for (const auto& group : groups) {
+                scan_group(protozero::pbf_reader{group});
+            }
+
+            return m_block;
+        }
+
+    }; // class BlockScanner
+
+    class IndexReader {
+
+        const std::string& m_data;
+        const std::string& m_filename;
+        std::size_t m_pos = 0;
+
+    public:
+
+        IndexReader(const std::string& data, const std::string& filename) noexcept :
+            m_data(data),
+            m_filename(filename) {
+        }
+
+        template <typename T>
+        T get() {
+            if (m_pos + sizeof(T) > m_data.size()) {
+                throw broken_index(m_filename);
+            }
+            T value;
+            std::memcpy(&value, m_data.data() + m_pos, sizeof(T));
+            m_pos += sizeof(T);
+            return value;
+        }
+
+        bool at_end() const noexcept {
+            return m_pos == m_data.size();
+        }
+
+    }; // class IndexReader
+
+} // anonymous namespace
+
+std::string pbf_index_filename(const std::string& pbf_filename) {
+    return pbf_filename + ".idx";
+}
+
+void PBFIndex::create(const std::string& pbf_filename, osmium::ProgressBar* progress_bar) {
+    const uint64_t file_size = osmium::file_size(pbf_filename);
+    auto mapping = map_file(pbf_filename, file_size);
+    advise(mapping, 0, file_size, access_hint::sequential);
+    const char* data = mapping.get_addr<char>();
+
+    m_blocks.clear();
+
+    std::deque<std::future<PBFBlock>> pending;
+    const auto add_next_block = [&]() {
+        m_blocks.push_back(pending.front().get());
+        pending.pop_front();
+    };
+
+    try {
+        uint64_t offset = 0;
+        while (offset < file_size) {
+            const auto blob = get_blob(data, offset, file_size);
+            if (offset == 0 && blob.type != "OSMHeader") {
+                throw osmium::pbf_error{"blob does not have type 'OSMHeader'"};
+            }
+
+            if (blob.type == "OSMData") {
+                // Only the view of the blob data and its size are needed,
+                // don't copy the type string to the worker thread.
+                pending.push_back(osmium::thread::Pool::default_instance().submit([blob_data = blob.data, blob_size = blob.size, offset]() {
+                    std::string output;
+                    return BlockScanner{offset, blob_size}(uncompress_blob(blob_data, output));
+                }));
+                if (pending.size() >= max_pending_blocks) {
+                    add_next_block();
+                }
+            }
+            offset += blob.size;
+
+            if (progress_bar) {
+                progress_bar->update(offset);
+            }
+        }
+
+        while (!pending.empty()) {
+            add_next_block();
+        }
+    } catch (...) {
+        // The worker threads must be done with the mapping before it
+        // goes away.
+        for (auto& future : pending) {
+            future.wait();
+        }
+        throw;
+    }
+}
+
+void PBFIndex::write(const std::string& pbf_filename) const {
+    const auto filename = pbf_index_filename(pbf_filename);
+    std::ofstream file{filename, std::ios::binary};
+    if (!file) {
+        throw std::runtime_error{"Can not open index file '" + filename + "'"};
+    }
+
+    std::string out{magic, sizeof(magic)};
+    append(out, format_version);
+    append(out, byte_order_mark);
+    append(out, static_cast<uint64_t>(osmium::file_size(pbf_filename)));
+    append(out, file_mtime(pbf_filename));
+
+    append(out, static_cast<uint64_t>(m_blocks.size()));
+    for (const auto& block : m_blocks) {
+        append(out, block.offset);
+        append(out, block.size);
+        append(out, block.count);
+        append(out, static_cast<uint32_t>(block.types));
+        append(out, block.min_id);
+        append(out, block.max_id);
+        append(out, block.bounds.bottom_left().x());
+        append(out, block.bounds.bottom_left().y());
+        append(out, block.bounds.top_right().x());
+        append(out, block.bounds.top_right().y());
+    }
+
+    if (!file.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+        throw std::runtime_error{"Error writing index file '" + filename + "'"};
+    }
+}
+
+bool PBFIndex::read(const std::string& pbf_filename) {
+    const auto filename = pbf_index_filename(pbf_filename);
+    std::ifstream file{filename, std::ios::binary};
+    if (!file) {
+        return false;
+    }
+
+    const std::string data{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    if (data.size() < sizeof(magic) || std::memcmp(data.data(), magic, sizeof(magic)) != 0) {
+        throw broken_index(filename);
+    }
+
+    const std::string tables = data.substr(sizeof(magic));
+    IndexReader reader{tables, filename};
+    if (reader.get<uint32_t>() != format_version || reader.get<uint32_t>() != byte_order_mark) {
+        throw broken_index(filename);
+    }
+
+    if (reader.get<uint64_t>() != osmium::file_size(pbf_filename) ||
+        reader.get<int64_t>() != file_mtime(pbf_filename)) {
+        return false;
+    }
+
+    m_blocks.resize(reader.get<uint64_t>());
+    for (auto& block : m_blocks) {
+        block.offset = reader.get<uint64_t>();
+        block.size = reader.get<uint64_t>();
+        block.count = reader.get<uint64_t>();
+        block.types = static_cast<osmium::osm_entity_bits::type>(reader.get<uint32_t>());
+        block.min_id = reader.get<osmium::object_id_type>();
+        block.max_id = reader.get<osmium::object_id_type>();
+        const auto x1 = reader.get<int32_t>();
+        const auto y1 = reader.get<int32_t>();
+        const auto x2 = reader.get<int32_t>();
+        const auto y2 = reader.get<int32_t>();
+        block.bounds = osmium::Box{osmium::Location{x1, y1}, osmium::Location{x2, y2}};
+    }
+
+    if (!reader.at_end()) {
+        throw broken_index(filename);
+    }
+
+    return true;
+}
+
+std::vector<PBFBlock> PBFIndex::find_blocks(osmium::osm_entity_bits::type types,
+                                            const std::function<bool(const PBFBlock&)>& func) const {
+    std::vector<PBFBlock> result;
+
+    std::copy_if(m_blocks.cbegin(), m_blocks.cend(), std::back_inserter(result), [&](const PBFBlock& block) {
+        return (block.types & types) != 0 && func(block);
+    });
+
+    return result;
+}
+
+bool open_pbf_index(const osmium::io::File& file, PBFIndex& index) {
+    if (file.format() != osmium::io::file_format::pbf ||
+        file.filename().empty() ||
+        file.filename() == "-") {
+        return false;
+    }
+
+    return index.read(file.filename());
+}
+
+bool PBFBlockReader::can_map(const osmium::io::File& file) {
+#ifdef _WIN32
+    (void)file;
+    return false;
+#else
+    if (sizeof(void*) < 8 ||
+        file.format() != osmium::io::file_format::pbf ||
+        file.compression() != osmium::io::file_compression::none ||
+        file.filename().empty() ||
+        file.filename() == "-") {
+        return false;
+    }
+
+    struct stat s; // NOLINT(cppcoreguidelines-pro-type-member-init, hicpp-member-init)
+    return ::stat(file.filename().c_str(), &s) == 0 && S_ISREG(s.st_mode);
+#endif
+}
+
+PBFBlockReader::PBFBlockReader(const std::string& pbf_filename) :
+    m_filename(pbf_filename),
+    m_file_size(osmium::file_size(pbf_filename)),
+    m_mapping(map_file(pbf_filename, m_file_size)) {
+    // Decode the header like osmium::io::Reader does. This throws if the
+    // file needs features we don't support.
+    const auto blob = get_blob(m_mapping.get_addr<char>(), 0, m_file_size);
+    if (blob.type != "OSMHeader") {
+        throw osmium::pbf_error{"blob does not have type 'OSMHeader'"};
+    }
+    std::string output;
+    m_header = osmium::io::detail::decode_header_block(uncompress_blob(blob.data, output));
+}
+
+PBFBlockReader::PBFBlockReader(const std::string& pbf_filename,
+                               std::vector<PBFBlock> blocks,
+                               osmium::osm_entity_bits::type types,
+                               osmium::io::read_meta read_metadata) :
+    PBFBlockReader(pbf_filename) {
+    m_blocks = std::move(blocks);
+    m_types = types;
+    m_read_metadata = read_metadata;
+    start();
+}
+
+PBFBlockReader::~PBFBlockReader() noexcept {
+    close();
+}
+
+void PBFBlockReader::start() {
+    if (m_all_blocks) {
+        advise(m_mapping, 0, m_file_size, access_hint::sequential);
+    }
+
+    while (m_pending.size() < max_pending_blocks && submit_next_block()) {
+    }
+}
+
+bool PBFBlockReader::submit_next_block() {
+    const char* data = m_mapping.get_addr<char>();
+    protozero::data_view blob;
+
+    if (m_all_blocks) {
+        while (true) {
+            if (m_next_offset >= m_file_size) {
+                return false;
+            }
+            const auto ref = get_blob(data, m_next_offset, m_file_size);
+            m_next_offset += ref.size;
+            if (ref.type == "OSMData") {
+                blob = ref.data;
+                break;
+            }
+        }
+    } else {
+        if (m_next_block >= m_blocks.size()) {
+            return false;
+        }
+        const auto& block = m_blocks[m_next_block++];
+        if (block.offset + block.size > m_file_size) {
+            throw std::runtime_error{"Reading block from '" + m_filename + "' failed. Is the index up to date?"};
+        }
+        blob = get_blob(data, block.offset, block.offset + block.size).data;
+        m_next_offset = block.offset + block.size;
+    }
+
+    const auto types = m_types;
+    const auto read_metadata = m_read_metadata;
+    m_pending.push_back(osmium::thread::Pool::default_instance().submit([blob, types, read_metadata]() {
+        std::string output;
+        osmium::io::detail::PBFPrimitiveBlockDecoder decoder{uncompress_blob(blob, output), types, read_metadata};
+        return decoder();
+    }));
+    m_pending_ends.push_back(m_next_offset);
+
+    return true;
+}
+
+// Blocks are read in order, so the pages before the current offset are
+// not needed any more. They stay in the page cache.
+void PBFBlockReader::release_pages() {
+    const auto end = m_offset / page_size() * page_size();
+    if (end > m_released) {
+        advise(m_mapping, m_released, end - m_released, access_hint::not_needed);
+        m_released = end;
+    }
+}
+
+osmium::memory::Buffer PBFBlockReader::read() {
+    if (m_pending.empty()) {
+        return osmium::memory::Buffer{};
+    }
+
+    auto buffer = m_pending.front().get();
+    m_pending.pop_front();
+    m_offset = m_pending_ends.front();
+    m_pending_ends.pop_front();
+
+    release_pages();
+    submit_next_block();
+
+    return buffer;
+}
+
+void PBFBlockReader::close() noexcept {
+    for (auto& future : m_pending) {
+        future.wait();
+    }
+    m_pending.clear();
+    m_pending_ends.clear();
+}
+
+void read_osm_file(const osmium::io::File& file,
+                   osmium::osm_entity_bits::type types,
+                   osmium::io::read_meta read_metadata,
+                   const std::function<void(osmium::memory::Buffer&)>& func) {
+    if (PBFBlockReader::can_map(file)) {
+        PBFBlockReader reader{file, types, read_metadata};
+        while (osmium::memory::Buffer buffer = reader.read()) {
+            func(buffer);
+        }
+        reader.close();
+        return;
+    }
+
+    osmium::io::Reader reader{file, types, read_metadata};
+    while (osmium::memory::Buffer buffer = reader.read()) {
+        func(buffer);
+    }
+    reader.close();
+}
@@ -0,0 +1,239 @@
+#ifndef PBF_INDEX_HPP
+#define PBF_INDEX_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/io/file.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/io/reader.hpp> // IWYU pragma: keep
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/box.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/util/memory_mapping.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace osmium {
+    class ProgressBar;
+} // namespace osmium
+
+/**
+ * Information about one data blob in a PBF file.
+ */
+struct PBFBlock {
+
+    // Position and size of the blob in the PBF file. This includes the
+    // length field and the blob header.
+    uint64_t offset = 0;
+    uint64_t size = 0;
+
+    uint64_t count = 0;
+
+    // Types of the objects in this blob.
+    osmium::osm_entity_bits::type types = osmium::osm_entity_bits::nothing;
+
+    // Smallest and largest ID of all objects in this blob (regardless
+    // of type).
+    osmium::object_id_type min_id = 0;
+    osmium::object_id_type max_id = 0;
+
+    // Bounding box of all node locations in this blob.
+    osmium::Box bounds;
+
+}; // struct PBFBlock
+
+/**
+ * A sidecar index for a PBF file with the position, object types, ID
+ * range, and bounding box of each data blob in the file. Readers can use
+ * it to read only the blobs they are interested in.
+ *
+ * The index file has the name of the PBF file with ".idx" appended. It
+ * is only valid as long as size and modification time of the PBF file
+ * don't change.
+ */
+class PBFIndex {
+
+    std::vector<PBFBlock> m_blocks;
+
+public:
+
+    const std::vector<PBFBlock>& blocks() const noexcept {
+        return m_blocks;
+    }
+
+    /**
+     * Create the index by reading the PBF file with the given name. Only
+     * IDs and node locations are decoded from the data blobs, this is
+     * done on the worker threads.
+     *
+     * @throws osmium::pbf_error If the file is not a valid PBF file.
+     */
+    void create(const std::string& pbf_filename, osmium::ProgressBar* progress_bar = nullptr);
+
+    // Write the index to the sidecar file of the PBF file.
+    void write(const std::string& pbf_filename) const;
+
+    /**
+     * Read the index from the sidecar file of the PBF file. Returns false
+     * if there is no index or if it doesn't match the PBF file.
+     *
+     * @throws std::runtime_error If the index file is broken.
+     */
+    bool read(const std::string& pbf_filename);
+
+    // Blocks with objects of any of the specified types for which the
+    // function returns true.
+    std::vector<PBFBlock> find_blocks(osmium::osm_entity_bits::type types,
+                                      const std::function<bool(const PBFBlock&)>& func = [](const PBFBlock& /*block*/) { return true; }) const;
+
+}; // class PBFIndex
+
+/**
+ * Reads the data blocks of a local PBF file through a memory mapping.
+ * Slices of the mapping are handed to the worker threads which decode
+ * them, so the data is not copied before decompression (and not at all
+ * for uncompressed blocks). The decoded buffers are returned in order.
+ *
+ * While reading, the kernel is told that the file is read sequentially
+ * and that the parts already read are not needed any more. The data stays
+ * in the page cache, so further passes over the same file are fast.
+ */
+class PBFBlockReader {
+
+    std::string m_filename;
+    uint64_t m_file_size;
+    osmium::util::MemoryMapping m_mapping;
+    osmium::io::Header m_header;
+
+    // Read only these blocks if m_all_blocks is not set.
+    std::vector<PBFBlock> m_blocks;
+    bool m_all_blocks = false;
+
+    std::deque<std::future<osmium::memory::Buffer>> m_pending;
+    std::deque<uint64_t> m_pending_ends;
+    osmium::osm_entity_bits::type m_types = osmium::osm_entity_bits::all;
+    osmium::io::read_meta m_read_metadata = osmium::io::read_meta::yes;
+    std::size_t m_next_block = 0;
+    uint64_t m_next_offset = 0;
+    uint64_t m_offset = 0;
+    uint64_t m_released = 0;
+
+    explicit PBFBlockReader(const std::string& pbf_filename);
+
+    void set_option(osmium::osm_entity_bits::type types) noexcept {
+        m_types = types;
+    }
+
+    void set_option(osmium::io::read_meta read_metadata) noexcept {
+        m_read_metadata = read_metadata;
+    }
+
+    void start();
+    bool submit_next_block();
+    void release_pages();
+
+public:
+
+    /**
+     * Can the file be read with this reader? It must be an uncompressed
+     * local PBF file.
+     */
+    static bool can_map(const osmium::io::File& file);
+
+    /**
+     * Read all data blocks of the file. Like for osmium::io::Reader the
+     * object types to read and whether to read metadata can be given as
+     * additional arguments.
+     */
+    template <typename... TArgs>
+    explicit PBFBlockReader(const osmium::io::File& file, TArgs&&... args) :
+        PBFBlockReader(file.filename()) {
+        (void)std::initializer_list<int>{(set_option(std::forward<TArgs>(args)), 0)...};
+        m_all_blocks = true;
+        start();
+    }
+
+    // Read only the specified blocks (from the index) of the file.
+    PBFBlockReader(const std::string& pbf_filename,
+                   std::vector<PBFBlock> blocks,
+                   osmium::osm_entity_bits::type types = osmium::osm_entity_bits::all,
+                   osmium::io::read_meta read_metadata = osmium::io::read_meta::yes);
+
+    PBFBlockReader(const PBFBlockReader&) = delete;
+    PBFBlockReader& operator=(const PBFBlockReader&) = delete;
+
+    PBFBlockReader(PBFBlockReader&&) = delete;
+    PBFBlockReader& operator=(PBFBlockReader&&) = delete;
+
+    ~PBFBlockReader() noexcept;
+
+    // Returns the next buffer or an invalid buffer at the end.
+    osmium::memory::Buffer read();
+
+    // Wait for the worker threads and stop reading.
+    void close() noexcept;
+
+    uint64_t file_size() const noexcept {
+        return m_file_size;
+    }
+
+    // The header from the OSMHeader blob of the file.
+    const osmium::io::Header& header() const noexcept {
+        return m_header;
+    }
+
+    // End of the last block returned in the input file. Can be used for
+    // progress bars.
+    uint64_t offset() const noexcept {
+        return m_offset;
+    }
+
+}; // class PBFBlockReader
+
+/**
+ * Read the objects of the given types from the file and call the function
+ * for each buffer. Local PBF files are read with the PBFBlockReader,
+ * everything else with the osmium::io::Reader.
+ */
+void read_osm_file(const osmium::io::File& file,
+                   osmium::osm_entity_bits::type types,
+                   osmium::io::read_meta read_metadata,
+                   const std::function<void(osmium::memory::Buffer&)>& func);
+
+std::string pbf_index_filename(const std::string& pbf_filename);
+
+/**
+ * Open an index for the file if it is a PBF file and has an up-to-date
+ * index. Returns false otherwise.
+ */
+bool open_pbf_index(const osmium::io::File& file, PBFIndex& index);
+
+#endif // PBF_INDEX_HPP
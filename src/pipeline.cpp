@@ -0,0 +1,533 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "pipeline.hpp"
+
+#include "buffer_pool.hpp"
+#include "exception.hpp"
+#include "util.hpp"
+
+#include <osmium/index/relations_map.hpp>
+#include <osmium/object_pointer_collection.hpp>
+#include <osmium/osm.hpp>
+#include <osmium/osm/object_comparisons.hpp>
+#include <osmium/visitor.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace po = boost::program_options;
+
+namespace {
+
+    constexpr const std::size_t output_buffer_size = 10UL * 1024UL * 1024UL;
+
+    po::variables_map parse_stage_arguments(const std::vector<std::string>& arguments,
+                                            const po::options_description& options,
+                                            const po::options_description& hidden = po::options_description{},
+                                            const po::positional_options_description& positional = po::positional_options_description{}) {
+        po::options_description parsed_options;
+        parsed_options.add(options).add(hidden);
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(arguments).options(parsed_options).positional(positional).run(), vm);
+        po::notify(vm);
+
+        return vm;
+    }
+
+    // Copy the objects for which the function returns true into a new
+    // buffer. The input buffer goes back to the buffer pool afterwards.
+    template <typename TFunc>
+    osmium::memory::Buffer copy_objects_if(osmium::memory::Buffer&& buffer, TFunc func) {
+        // The output is never larger than the input, so any buffer of
+        // that size will do, even if it can not grow.
+        auto out = BufferPool::instance().get(buffer.committed());
+        for (auto& object : buffer.select<osmium::OSMObject>()) {
+            if (func(object)) {
+                out.add_item(object);
+                out.commit();
+            }
+        }
+        BufferPool::instance().put(std::move(buffer));
+        return out;
+    }
+
+    // Reads the objects of a sorted run back from its temporary file.
+    class RunReader {
+
+        using iterator = osmium::memory::Buffer::t_iterator<osmium::OSMObject>;
+
+        SpillFile* m_file;
+        osmium::memory::Buffer m_buffer;
+        iterator m_it;
+        iterator m_end;
+
+        void next_buffer() {
+            do {
+                m_buffer = m_file->read();
+                if (!m_buffer) {
+                    return;
+                }
+                m_it = m_buffer.begin<osmium::OSMObject>();
+                m_end = m_buffer.end<osmium::OSMObject>();
+            } while (m_it == m_end);
+        }
+
+    public:
+
+        explicit RunReader(SpillFile* file) :
+            m_file(file) {
+            m_file->rewind();
+            next_buffer();
+        }
+
+        bool empty() const noexcept {
+            return !m_buffer;
+        }
+
+        const osmium::OSMObject& front() const noexcept {
+            return *m_it;
+        }
+
+        void pop() {
+            ++m_it;
+            if (m_it == m_end) {
+                next_buffer();
+            }
+        }
+
+    }; // class RunReader
+
+} // anonymous namespace
+
+void TagsFilterStage::setup(const std::vector<std::string>& arguments) {
+    po::options_description options;
+    options.add_options()
+    ("expressions,e", po::value<std::string>(), "Read filter expressions from file")
+    ("invert-match,i", "Invert the sense of matching, exclude objects with matching tags")
+    ("omit-referenced,R", "Omit referenced objects")
+    ("remove-tags,t", "Remove tags from non-matching objects")
+    ;
+
+    po::options_description hidden;
+    hidden.add_options()
+    ("expression-list", po::value<std::vector<std::string>>(), "Filter expressions")
+    ;
+
+    po::positional_options_description positional;
+    positional.add("expression-list", -1);
+
+    const auto vm = parse_stage_arguments(arguments, options, hidden, positional);
+
+    m_add_referenced_objects = vm.count("omit-referenced") == 0;
+    m_invert_match = vm.count("invert-match") != 0;
+    m_remove_tags = vm.count("remove-tags") != 0;
+
+    if (vm.count("expression-list")) {
+        for (const auto& e : vm["expression-list"].as<std::vector<std::string>>()) {
+            m_rules.add_expression(e);
+        }
+    }
+
+    if (vm.count("expressions")) {
+        m_rules.read_expressions_file(vm["expressions"].as<std::string>());
+    }
+
+    if (!vm.count("expression-list") && !vm.count("expressions")) {
+        throw argument_error{"Missing filter expression for 'tags-filter' stage."};
+    }
+}
+
+void TagsFilterStage::show_arguments(osmium::VerboseOutput& vout) const {
+    vout << "      add referenced objects: " << yes_no(m_add_referenced_objects);
+    vout << "      invert match: " << yes_no(m_invert_match);
+    if (m_add_referenced_objects) {
+        vout << "      remove tags on non-matching objects: " << yes_no(m_remove_tags);
+    }
+}
+
+// Same as the 'tags-filter' command, but using the buffers kept in memory
+// or spilled to a temporary file instead of several passes over the input
+// file.
+void TagsFilterStage::find_referenced_objects() {
+    osmium::index::RelationsMapStash stash;
+
+    m_buffers.for_each([&](const osmium::memory::Buffer& buffer) {
+        for (const auto& relation : buffer.select<osmium::Relation>()) {
+            stash.add_members(relation);
+            if (m_rules.matches_object(relation) != m_invert_match) {
+                m_matching_ids(osmium::item_type::relation).set(relation.positive_id());
+            }
+        }
+    });
+
+    if (!stash.empty()) {
+        auto& referenced_relations = m_referenced_ids(osmium::item_type::relation);
+        const auto rel_in_rel = stash.build_parent_to_member_index();
+        for (const auto id : m_matching_ids(osmium::item_type::relation)) {
+            mark_rel_ids(rel_in_rel, referenced_relations, id);
+        }
+    }
+
+    m_buffers.for_each([&](const osmium::memory::Buffer& buffer) {
+        for (const auto& relation : buffer.select<osmium::Relation>()) {
+            if (m_matching_ids(osmium::item_type::relation).get(relation.positive_id()) ||
+                m_referenced_ids(osmium::item_type::relation).get(relation.positive_id())) {
+                for (const auto& member : relation.members()) {
+                    if (member.type() == osmium::item_type::node || member.type() == osmium::item_type::way) {
+                        m_referenced_ids(member.type()).set(member.positive_ref());
+                    }
+                }
+            }
+        }
+    });
+
+    m_buffers.for_each([&](const osmium::memory::Buffer& buffer) {
+        for (const auto& way : buffer.select<osmium::Way>()) {
+            const bool matches = m_rules.matches_object(way) != m_invert_match;
+            if (matches) {
+                m_matching_ids(osmium::item_type::way).set(way.positive_id());
+            }
+            if (matches || m_referenced_ids(osmium::item_type::way).get(way.positive_id())) {
+                for (const auto& nr : way.nodes()) {
+                    m_referenced_ids(osmium::item_type::node).set(nr.positive_ref());
+                }
+            }
+        }
+    });
+}
+
+bool TagsFilterStage::keep_object(osmium::OSMObject& object) const {
+    if (m_matching_ids(object.type()).get(object.positive_id())) {
+        return true;
+    }
+
+    if ((!m_add_referenced_objects || object.type() == osmium::item_type::node) && m_rules.matches_object(object) != m_invert_match) {
+        return true;
+    }
+
+    if (m_referenced_ids(object.type()).get(object.positive_id())) {
+        if (m_remove_tags) {
+            object.remove_tags();
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void TagsFilterStage::process(osmium::memory::Buffer&& buffer) {
+    if (m_add_referenced_objects) {
+        m_buffers.add(std::move(buffer));
+        return;
+    }
+
+    emit(copy_objects_if(std::move(buffer), [this](osmium::OSMObject& object) {
+        return keep_object(object);
+    }));
+}
+
+void TagsFilterStage::finish() {
+    if (!m_add_referenced_objects) {
+        return;
+    }
+
+    find_referenced_objects();
+
+    m_buffers.consume([this](osmium::memory::Buffer&& buffer) {
+        emit(copy_objects_if(std::move(buffer), [this](osmium::OSMObject& object) {
+            return keep_object(object);
+        }));
+    });
+}
+
+std::size_t TagsFilterStage::used_memory() const {
+    std::size_t sum = 0;
+    for (const auto type : {osmium::item_type::node, osmium::item_type::way, osmium::item_type::relation}) {
+        sum += m_matching_ids(type).used_memory() + m_referenced_ids(type).used_memory();
+    }
+    return sum;
+}
+
+void AddLocationsToWaysStage::setup(const std::vector<std::string>& arguments) {
+    po::options_description options;
+    options.add_options()
+    ("index-type,i", po::value<std::string>(), "Index type")
+    ("keep-untagged-nodes,n", "Keep untagged nodes")
+    ("ignore-missing-nodes", "Ignore missing nodes")
+    ;
+
+    const auto vm = parse_stage_arguments(arguments, options);
+
+    if (vm.count("index-type")) {
+        m_index_type_name = check_index_type(vm["index-type"].as<std::string>());
+    }
+
+    m_keep_untagged_nodes = vm.count("keep-untagged-nodes") != 0;
+
+    const auto& map_factory = osmium::index::MapFactory<osmium::unsigned_object_id_type, osmium::Location>::instance();
+    m_location_index_pos = map_factory.create_map(m_index_type_name);
+    m_location_index_neg = map_factory.create_map(m_index_type_name);
+    m_location_handler = std::make_unique<location_handler_type>(*m_location_index_pos, *m_location_index_neg);
+
+    if (vm.count("ignore-missing-nodes")) {
+        m_location_handler->ignore_errors();
+    }
+}
+
+void AddLocationsToWaysStage::show_arguments(osmium::VerboseOutput& vout) const {
+    vout << "      index type: " << m_index_type_name << '\n';
+    vout << "      keep untagged nodes: " << yes_no(m_keep_untagged_nodes);
+}
+
+void AddLocationsToWaysStage::setup_output(osmium::io::File& file, osmium::io::Header& /*header*/) const {
+    file.set("locations_on_ways");
+}
+
+void AddLocationsToWaysStage::process(osmium::memory::Buffer&& buffer) {
+    osmium::apply(buffer, *m_location_handler);
+
+    if (m_keep_untagged_nodes) {
+        emit(std::move(buffer));
+        return;
+    }
+
+    emit(copy_objects_if(std::move(buffer), [](const osmium::OSMObject& object) {
+        return object.type() != osmium::item_type::node || !object.tags().empty();
+    }));
+}
+
+std::size_t AddLocationsToWaysStage::used_memory() const {
+    return m_location_index_pos->used_memory() + m_location_index_neg->used_memory();
+}
+
+void RenumberStage::setup(const std::vector<std::string>& arguments) {
+    po::options_description options;
+    options.add_options()
+    ("start-id,s", po::value<std::string>(), "Comma separated list of first node, way, and relation id to use (default: 1,1,1)")
+    ;
+
+    const auto vm = parse_stage_arguments(arguments, options);
+
+    if (vm.count("start-id")) {
+        set_start_ids(m_id_map, vm["start-id"].as<std::string>());
+    }
+}
+
+void RenumberStage::show_arguments(osmium::VerboseOutput& vout) const {
+    vout << "      start ids: "
+         << m_id_map(osmium::item_type::node).start_id() << ','
+         << m_id_map(osmium::item_type::way).start_id() << ','
+         << m_id_map(osmium::item_type::relation).start_id() << '\n';
+}
+
+void RenumberStage::renumber(osmium::memory::Buffer& buffer) {
+    for (auto& object : buffer.select<osmium::OSMObject>()) {
+        switch (object.type()) {
+            case osmium::item_type::node:
+                m_check_order.node(static_cast<const osmium::Node&>(object));
+                object.set_id(m_id_map(osmium::item_type::node)(object.id()));
+                break;
+            case osmium::item_type::way:
+                m_check_order.way(static_cast<const osmium::Way&>(object));
+                object.set_id(m_id_map(osmium::item_type::way)(object.id()));
+                for (auto& ref : static_cast<osmium::Way&>(object).nodes()) {
+                    ref.set_ref(m_id_map(osmium::item_type::node)(ref.ref()));
+                }
+                break;
+            case osmium::item_type::relation:
+                m_check_order.relation(static_cast<const osmium::Relation&>(object));
+                object.set_id(m_id_map(osmium::item_type::relation)(object.id()));
+                for (auto& member : static_cast<osmium::Relation&>(object).members()) {
+                    member.set_ref(m_id_map(member.type())(member.ref()));
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void RenumberStage::process(osmium::memory::Buffer&& buffer) {
+    // Buffers with relations are kept, because relations can reference
+    // relations later in the input which don't have a new ID yet.
+    const auto relations = buffer.select<osmium::Relation>();
+    if (!m_relation_buffers.empty() || relations.begin() != relations.end()) {
+        m_relation_buffers.add(std::move(buffer));
+        return;
+    }
+
+    renumber(buffer);
+    emit(std::move(buffer));
+}
+
+void RenumberStage::finish() {
+    // Allocate new IDs for all relations in order first, like the
+    // 'renumber' command does in its first pass.
+    auto& relation_map = m_id_map(osmium::item_type::relation);
+    m_relation_buffers.for_each([&](const osmium::memory::Buffer& buffer) {
+        for (const auto& relation : buffer.select<osmium::Relation>()) {
+            relation_map(relation.id());
+        }
+    });
+
+    m_relation_buffers.consume([this](osmium::memory::Buffer&& buffer) {
+        renumber(buffer);
+        emit(std::move(buffer));
+    });
+}
+
+void SortStage::setup(const std::vector<std::string>& arguments) {
+    const po::options_description options;
+    parse_stage_arguments(arguments, options);
+}
+
+void SortStage::setup_output(osmium::io::File& /*file*/, osmium::io::Header& header) const {
+    header.set("sorting", "Type_then_ID");
+}
+
+void SortStage::process(osmium::memory::Buffer&& buffer) {
+    m_in_memory += buffer.capacity();
+    m_buffers.push_back(std::move(buffer));
+    if (m_in_memory > m_spill_size) {
+        write_run();
+    }
+}
+
+// Sort the objects in all buffers kept in memory and hand them to func
+// in new buffers.
+void SortStage::sort_buffers(const std::function<void(osmium::memory::Buffer&&)>& func) {
+    osmium::ObjectPointerCollection objects;
+    for (auto& buffer : m_buffers) {
+        osmium::apply(buffer, objects);
+    }
+
+    objects.sort(osmium::object_order_type_id_version());
+
+    osmium::memory::Buffer out{output_buffer_size, osmium::memory::Buffer::auto_grow::yes};
+    for (const auto& object : objects) {
+        out.add_item(object);
+        out.commit();
+        if (out.committed() >= output_buffer_size) {
+            func(std::move(out));
+            out = osmium::memory::Buffer{output_buffer_size, osmium::memory::Buffer::auto_grow::yes};
+        }
+    }
+    if (out.committed() > 0) {
+        func(std::move(out));
+    }
+
+    m_buffers.clear();
+    m_in_memory = 0;
+}
+
+void SortStage::write_run() {
+    auto run = std::make_unique<SpillFile>();
+    sort_buffers([&run](osmium::memory::Buffer&& buffer) {
+        run->write(buffer);
+    });
+    m_runs.push_back(std::move(run));
+}
+
+void SortStage::merge_runs() {
+    std::vector<RunReader> readers;
+    readers.reserve(m_runs.size());
+    for (const auto& run : m_runs) {
+        readers.emplace_back(run.get());
+    }
+
+    const auto greater = [&readers](std::size_t a, std::size_t b) {
+        return osmium::object_order_type_id_version{}(readers[b].front(), readers[a].front());
+    };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(greater)> queue{greater};
+    for (std::size_t n = 0; n < readers.size(); ++n) {
+        if (!readers[n].empty()) {
+            queue.push(n);
+        }
+    }
+
+    osmium::memory::Buffer out{output_buffer_size, osmium::memory::Buffer::auto_grow::yes};
+    while (!queue.empty()) {
+        const auto n = queue.top();
+        queue.pop();
+        out.add_item(readers[n].front());
+        out.commit();
+        readers[n].pop();
+        if (!readers[n].empty()) {
+            queue.push(n);
+        }
+        if (out.committed() >= output_buffer_size) {
+            emit(std::move(out));
+            out = osmium::memory::Buffer{output_buffer_size, osmium::memory::Buffer::auto_grow::yes};
+        }
+    }
+    emit(std::move(out));
+
+    m_runs.clear();
+}
+
+void SortStage::finish() {
+    if (m_runs.empty()) {
+        sort_buffers([this](osmium::memory::Buffer&& buffer) {
+            emit(std::move(buffer));
+        });
+        return;
+    }
+
+    if (!m_buffers.empty()) {
+        write_run();
+    }
+    merge_runs();
+}
+
+std::unique_ptr<PipelineStage> create_pipeline_stage(const std::vector<std::string>& words) {
+    if (words.empty()) {
+        throw argument_error{"Empty stage in pipeline."};
+    }
+
+    const auto& name = words.front();
+    std::unique_ptr<PipelineStage> stage;
+
+    if (name == "tags-filter") {
+        stage = std::make_unique<TagsFilterStage>();
+    } else if (name == "add-locations-to-ways") {
+        stage = std::make_unique<AddLocationsToWaysStage>();
+    } else if (name == "renumber") {
+        stage = std::make_unique<RenumberStage>();
+    } else if (name == "sort") {
+        stage = std::make_unique<SortStage>();
+    } else {
+        throw argument_error{"Unknown pipeline stage '" + name + "' (Allowed are 'tags-filter', 'add-locations-to-ways', 'renumber', and 'sort')."};
+    }
+
+    const std::vector<std::string> arguments(words.cbegin() + 1, words.cend());
+    stage->setup(arguments);
+
+    return stage;
+}
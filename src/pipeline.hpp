@@ -0,0 +1,298 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "buffer_spill.hpp"
+#include "command_renumber.hpp"
+#include "tags_filter_rules.hpp"
+
+#include <osmium/fwd.hpp>
+#include <osmium/handler/check_order.hpp>
+#include <osmium/handler/node_locations_for_ways.hpp>
+#include <osmium/index/id_set.hpp>
+#include <osmium/index/map.hpp>
+#include <osmium/index/nwr_array.hpp>
+#include <osmium/io/file.hpp>
+#include <osmium/io/header.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/util/verbose_output.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Bytes of input a stage keeps in memory before writing it to temporary
+// files if not set with the --spill-size option.
+constexpr const std::size_t default_spill_size = 1024UL * 1024UL * 1024UL;
+
+/**
+ * One stage of the pipeline command. Each stage gets buffers from the
+ * previous stage (or the input file) and hands the buffers it creates
+ * on to the next stage (or the output file).
+ *
+ * Stages that can only produce their output after they have seen all
+ * their input (like sorting) keep the input buffers until finish() is
+ * called. Above the spill size they write them to temporary files.
+ */
+class PipelineStage {
+
+public:
+
+    using output_type = std::function<void(osmium::memory::Buffer&&)>;
+
+private:
+
+    output_type m_output;
+
+protected:
+
+    // Hand on a buffer to the next stage. Empty buffers are dropped.
+    void emit(osmium::memory::Buffer&& buffer) {
+        if (buffer.committed() > 0) {
+            m_output(std::move(buffer));
+        }
+    }
+
+public:
+
+    PipelineStage() = default;
+
+    virtual ~PipelineStage() = default;
+
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator=(const PipelineStage&) = delete;
+
+    PipelineStage(PipelineStage&&) = delete;
+    PipelineStage& operator=(PipelineStage&&) = delete;
+
+    void set_output(output_type output) {
+        m_output = std::move(output);
+    }
+
+    virtual const char* name() const noexcept = 0;
+
+    // Parse the arguments (without the stage name) of this stage. Throws
+    // argument_error or a boost::program_options error on problems.
+    virtual void setup(const std::vector<std::string>& arguments) = 0;
+
+    virtual void show_arguments(osmium::VerboseOutput& /*vout*/) const {
+    }
+
+    // Does this stage keep all its input until finish() is called?
+    virtual bool holds_input() const noexcept {
+        return false;
+    }
+
+    // Set the number of bytes of input a stage keeps in memory before it
+    // writes it to temporary files. Only used by stages holding input.
+    virtual void set_spill_size(std::size_t /*size*/) {
+    }
+
+    // Change the output file settings or header needed because of this
+    // stage.
+    virtual void setup_output(osmium::io::File& /*file*/, osmium::io::Header& /*header*/) const {
+    }
+
+    virtual void process(osmium::memory::Buffer&& buffer) = 0;
+
+    // Called after the last buffer was processed.
+    virtual void finish() {
+    }
+
+    // Memory used by indexes of this stage.
+    virtual std::size_t used_memory() const {
+        return 0;
+    }
+
+}; // class PipelineStage
+
+/**
+ * Keeps objects matching the filter expressions. Unless --omit-referenced
+ * is set, all input is kept until the end to find the referenced objects.
+ */
+class TagsFilterStage : public PipelineStage {
+
+    TagsFilterRules m_rules;
+
+    osmium::nwr_array<osmium::index::IdSetDense<osmium::unsigned_object_id_type>> m_matching_ids;
+    osmium::nwr_array<osmium::index::IdSetDense<osmium::unsigned_object_id_type>> m_referenced_ids;
+
+    BufferSpill m_buffers{default_spill_size};
+
+    bool m_add_referenced_objects = true;
+    bool m_invert_match = false;
+    bool m_remove_tags = false;
+
+    void find_referenced_objects();
+    bool keep_object(osmium::OSMObject& object) const;
+
+public:
+
+    const char* name() const noexcept override final {
+        return "tags-filter";
+    }
+
+    void setup(const std::vector<std::string>& arguments) override final;
+
+    void show_arguments(osmium::VerboseOutput& vout) const override final;
+
+    bool holds_input() const noexcept override final {
+        return m_add_referenced_objects;
+    }
+
+    void set_spill_size(std::size_t size) override final {
+        m_buffers.set_max_in_memory(size);
+    }
+
+    void process(osmium::memory::Buffer&& buffer) override final;
+
+    void finish() override final;
+
+    std::size_t used_memory() const override final;
+
+}; // class TagsFilterStage
+
+/**
+ * Adds node locations to ways. Untagged nodes are removed unless
+ * --keep-untagged-nodes is set.
+ */
+class AddLocationsToWaysStage : public PipelineStage {
+
+    using index_type = osmium::index::map::Map<osmium::unsigned_object_id_type, osmium::Location>;
+    using location_handler_type = osmium::handler::NodeLocationsForWays<index_type>;
+
+    std::string m_index_type_name{"flex_mem"};
+    std::unique_ptr<index_type> m_location_index_pos;
+    std::unique_ptr<index_type> m_location_index_neg;
+    std::unique_ptr<location_handler_type> m_location_handler;
+
+    bool m_keep_untagged_nodes = false;
+
+public:
+
+    const char* name() const noexcept override final {
+        return "add-locations-to-ways";
+    }
+
+    void setup(const std::vector<std::string>& arguments) override final;
+
+    void show_arguments(osmium::VerboseOutput& vout) const override final;
+
+    void setup_output(osmium::io::File& file, osmium::io::Header& header) const override final;
+
+    void process(osmium::memory::Buffer&& buffer) override final;
+
+    std::size_t used_memory() const override final;
+
+}; // class AddLocationsToWaysStage
+
+/**
+ * Renumbers objects. Relations are kept until the end, because relations
+ * can reference relations later in the input.
+ */
+class RenumberStage : public PipelineStage {
+
+    osmium::handler::CheckOrder m_check_order;
+    osmium::nwr_array<id_map> m_id_map;
+    BufferSpill m_relation_buffers{default_spill_size};
+
+    void renumber(osmium::memory::Buffer& buffer);
+
+public:
+
+    const char* name() const noexcept override final {
+        return "renumber";
+    }
+
+    void setup(const std::vector<std::string>& arguments) override final;
+
+    void show_arguments(osmium::VerboseOutput& vout) const override final;
+
+    bool holds_input() const noexcept override final {
+        return true;
+    }
+
+    void set_spill_size(std::size_t size) override final {
+        m_relation_buffers.set_max_in_memory(size);
+    }
+
+    void process(osmium::memory::Buffer&& buffer) override final;
+
+    void finish() override final;
+
+}; // class RenumberStage
+
+/**
+ * Sorts all objects by type, ID, and version. If the input is larger than
+ * the spill size, sorted runs are written to temporary files and merged
+ * at the end.
+ */
+class SortStage : public PipelineStage {
+
+    std::vector<osmium::memory::Buffer> m_buffers;
+    std::vector<std::unique_ptr<SpillFile>> m_runs;
+    std::size_t m_in_memory = 0;
+    std::size_t m_spill_size = default_spill_size;
+
+    void sort_buffers(const std::function<void(osmium::memory::Buffer&&)>& func);
+
+    void write_run();
+
+    void merge_runs();
+
+public:
+
+    const char* name() const noexcept override final {
+        return "sort";
+    }
+
+    void setup(const std::vector<std::string>& arguments) override final;
+
+    bool holds_input() const noexcept override final {
+        return true;
+    }
+
+    void set_spill_size(std::size_t size) override final {
+        m_spill_size = size;
+    }
+
+    void setup_output(osmium::io::File& file, osmium::io::Header& header) const override final;
+
+    void process(osmium::memory::Buffer&& buffer) override final;
+
+    void finish() override final;
+
+}; // class SortStage
+
+/**
+ * Create a pipeline stage from its name and arguments. Throws
+ * argument_error if there is no stage with this name.
+ */
+std::unique_ptr<PipelineStage> create_pipeline_stage(const std::vector<std::string>& words);
+
+#endif // PIPELINE_HPP
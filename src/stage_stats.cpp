@@ -0,0 +1,220 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "stage_stats.hpp"
+
+#include <osmium/osm/entity.hpp>
+#include <osmium/osm/item_type.hpp>
+
+#include <rapidjson/ostreamwrapper.h>
+#include <rapidjson/prettywriter.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+#ifndef _WIN32
+# include <sys/resource.h>
+# include <time.h>
+#endif
+
+void StageStats::add_buffer(const osmium::memory::Buffer& buffer) {
+    ++buffers;
+    for (const auto& entity : buffer.select<osmium::OSMEntity>()) {
+        ++objects;
+        switch (entity.type()) {
+            case osmium::item_type::node:
+                ++nodes;
+                break;
+            case osmium::item_type::way:
+                ++ways;
+                break;
+            case osmium::item_type::relation:
+                ++relations;
+                break;
+            case osmium::item_type::changeset:
+                ++changesets;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+double thread_cpu_time() noexcept {
+#if !defined(_WIN32) && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts{};
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+        return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+    }
+#endif
+    return 0.0;
+}
+
+std::size_t peak_rss() noexcept {
+#ifndef _WIN32
+    struct rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+# ifdef __APPLE__
+        return static_cast<std::size_t>(usage.ru_maxrss);
+# else
+        return static_cast<std::size_t>(usage.ru_maxrss) * 1024U;
+# endif
+    }
+#endif
+    return 0;
+}
+
+StageStats& RunStats::stage(const char* name) {
+    for (auto& stage : m_stages) {
+        if (stage.name == name) {
+            return stage;
+        }
+    }
+    m_stages.emplace_back(name);
+    return m_stages.back();
+}
+
+void RunStats::add_index(const char* name, std::size_t memory) {
+    for (auto& index : m_indexes) {
+        if (index.first == name) {
+            index.second = std::max(index.second, memory);
+            return;
+        }
+    }
+    m_indexes.emplace_back(name, memory);
+}
+
+double RunStats::wall_time() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+double RunStats::cpu_time() const {
+    return static_cast<double>(std::clock() - m_cpu_start) / CLOCKS_PER_SEC;
+}
+
+void RunStats::print(std::ostream& out) const {
+    const auto flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+
+    out << "Statistics:\n";
+    out << "  Wall time: " << wall_time() << " s\n";
+    out << "  CPU time (all threads): " << cpu_time() << " s\n";
+    if (peak_rss() > 0) {
+        out << "  Peak RSS: " << (peak_rss() / (1024U * 1024U)) << " MBytes\n";
+    }
+    for (const auto& index : m_indexes) {
+        out << "  Index '" << index.first << "': " << (index.second / (1024U * 1024U)) << " MBytes\n";
+    }
+
+    for (const auto& stage : m_stages) {
+        out << "  Stage '" << stage.name << "':\n";
+        out << "    Wall time: " << stage.wall_time << " s\n";
+        out << "    CPU time (main thread): " << stage.cpu_time << " s\n";
+        out << "    Wait time: " << stage.wait_time() << " s\n";
+        out << "    Bytes in: " << stage.bytes_in << "\n";
+        out << "    Bytes out: " << stage.bytes_out << "\n";
+        out << "    Buffers: " << stage.buffers << "\n";
+        out << "    Objects: " << stage.objects
+            << " (" << std::llround(stage.objects_per_second()) << " per second)\n";
+        if (stage.objects > 0) {
+            out << "      Nodes: " << stage.nodes << "\n";
+            out << "      Ways: " << stage.ways << "\n";
+            out << "      Relations: " << stage.relations << "\n";
+            out << "      Changesets: " << stage.changesets << "\n";
+        }
+    }
+
+    out.flags(flags);
+}
+
+void RunStats::print_json(std::ostream& out) const {
+    rapidjson::OStreamWrapper stream_wrapper{out};
+    rapidjson::PrettyWriter<rapidjson::OStreamWrapper> writer{stream_wrapper};
+
+    writer.StartObject();
+
+    if (!m_command.empty()) {
+        writer.String("command");
+        writer.String(m_command.c_str());
+    }
+    writer.String("wall_time");
+    writer.Double(wall_time());
+    writer.String("cpu_time");
+    writer.Double(cpu_time());
+    writer.String("peak_rss");
+    writer.Uint64(peak_rss());
+
+    writer.String("indexes");
+    writer.StartArray();
+    for (const auto& index : m_indexes) {
+        writer.StartObject();
+        writer.String("name");
+        writer.String(index.first.c_str());
+        writer.String("memory");
+        writer.Uint64(index.second);
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.String("stages");
+    writer.StartArray();
+    for (const auto& stage : m_stages) {
+        writer.StartObject();
+        writer.String("name");
+        writer.String(stage.name.c_str());
+        writer.String("wall_time");
+        writer.Double(stage.wall_time);
+        writer.String("cpu_time");
+        writer.Double(stage.cpu_time);
+        writer.String("wait_time");
+        writer.Double(stage.wait_time());
+        writer.String("bytes_in");
+        writer.Uint64(stage.bytes_in);
+        writer.String("bytes_out");
+        writer.Uint64(stage.bytes_out);
+        writer.String("buffers");
+        writer.Uint64(stage.buffers);
+        writer.String("objects");
+        writer.Uint64(stage.objects);
+        writer.String("objects_per_second");
+        writer.Double(stage.objects_per_second());
+        writer.String("types");
+        writer.StartObject();
+        writer.String("node");
+        writer.Uint64(stage.nodes);
+        writer.String("way");
+        writer.Uint64(stage.ways);
+        writer.String("relation");
+        writer.Uint64(stage.relations);
+        writer.String("changeset");
+        writer.Uint64(stage.changesets);
+        writer.EndObject();
+        writer.EndObject();
+    }
+    writer.EndArray();
+
+    writer.EndObject();
+
+    out << '\n';
+}
@@ -0,0 +1,167 @@
+#ifndef STAGE_STATS_HPP
+#define STAGE_STATS_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/memory/buffer.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Timing and throughput statistics for one processing stage of a command,
+ * for instance reading the input or writing the output. Times are measured
+ * on the main thread. For stages handing off work to the reader or writer
+ * threads the difference between wall time and CPU time is the time spent
+ * waiting on the queues of those threads.
+ */
+struct StageStats {
+
+    std::string name;
+    double wall_time = 0.0; // seconds
+    double cpu_time = 0.0; // seconds, main thread only
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t buffers = 0;
+    uint64_t objects = 0;
+    uint64_t nodes = 0;
+    uint64_t ways = 0;
+    uint64_t relations = 0;
+    uint64_t changesets = 0;
+
+    explicit StageStats(std::string stage_name) :
+        name(std::move(stage_name)) {
+    }
+
+    // Count buffer and the objects in it (in total and per type). Does
+    // not change the byte counts.
+    void add_buffer(const osmium::memory::Buffer& buffer);
+
+    double wait_time() const noexcept {
+        return wall_time > cpu_time ? wall_time - cpu_time : 0.0;
+    }
+
+    double objects_per_second() const noexcept {
+        return wall_time > 0.0 ? static_cast<double>(objects) / wall_time : 0.0;
+    }
+
+}; // struct StageStats
+
+/**
+ * CPU time used by the calling thread in seconds. Returns 0 on systems
+ * where this is not available.
+ */
+double thread_cpu_time() noexcept;
+
+/**
+ * Peak resident set size of the process in bytes. Returns 0 on systems
+ * where this is not available.
+ */
+std::size_t peak_rss() noexcept;
+
+/**
+ * Adds the time from construction to destruction to a stage.
+ */
+class StageTimer {
+
+    StageStats& m_stage;
+    std::chrono::steady_clock::time_point m_start;
+    double m_cpu_start;
+
+public:
+
+    explicit StageTimer(StageStats& stage) :
+        m_stage(stage),
+        m_start(std::chrono::steady_clock::now()),
+        m_cpu_start(thread_cpu_time()) {
+    }
+
+    ~StageTimer() noexcept {
+        m_stage.wall_time += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        m_stage.cpu_time += thread_cpu_time() - m_cpu_start;
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    StageTimer(StageTimer&&) = delete;
+    StageTimer& operator=(StageTimer&&) = delete;
+
+}; // class StageTimer
+
+/**
+ * Statistics for all stages of a command run.
+ */
+class RunStats {
+
+    // deque because references to the stages are handed out
+    std::deque<StageStats> m_stages;
+
+    // name and memory used for indexes
+    std::vector<std::pair<std::string, std::size_t>> m_indexes;
+
+    std::string m_command;
+
+    std::chrono::steady_clock::time_point m_start;
+    std::clock_t m_cpu_start;
+
+public:
+
+    RunStats() :
+        m_start(std::chrono::steady_clock::now()),
+        m_cpu_start(std::clock()) {
+    }
+
+    void set_command(const char* command) {
+        m_command = command;
+    }
+
+    // Get the stage with the specified name, create it if necessary.
+    StageStats& stage(const char* name);
+
+    // Record memory used by the named index. If an index with this name
+    // was recorded before, the larger value is kept.
+    void add_index(const char* name, std::size_t memory);
+
+    // Wall time since start of the run in seconds.
+    double wall_time() const;
+
+    // CPU time of the whole process (all threads) in seconds.
+    double cpu_time() const;
+
+    void print(std::ostream& out) const;
+
+    // Write statistics as JSON. This is used for the --stats=json
+    // option and for the file written with the --metrics-file option.
+    void print_json(std::ostream& out) const;
+
+}; // class RunStats
+
+#endif // STAGE_STATS_HPP
@@ -0,0 +1,130 @@
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "tags_filter_rules.hpp"
+
+#include "exception.hpp"
+#include "util.hpp"
+
+#include <osmium/osm.hpp>
+#include <osmium/tags/taglist.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <string>
+
+void TagsFilterRules::add_filter(osmium::osm_entity_bits::type entities, const osmium::TagMatcher& matcher) {
+    if (entities & osmium::osm_entity_bits::node) {
+        m_filters(osmium::item_type::node).add_rule(true, matcher);
+    }
+    if (entities & osmium::osm_entity_bits::way) {
+        m_filters(osmium::item_type::way).add_rule(true, matcher);
+    }
+    if (entities & osmium::osm_entity_bits::relation) {
+        m_filters(osmium::item_type::relation).add_rule(true, matcher);
+    }
+    if (entities & osmium::osm_entity_bits::area) {
+        m_area_filters.add_rule(true, matcher);
+    }
+}
+
+void TagsFilterRules::add_expression(const std::string& expression) {
+    const auto p = get_filter_expression(expression);
+    add_filter(p.first, get_tag_matcher(p.second));
+}
+
+void TagsFilterRules::read_expressions_file(const std::string& file_name) {
+    std::ifstream file{file_name};
+    if (!file.is_open()) {
+        throw argument_error{"Could not open file '" + file_name + "'"};
+    }
+
+    for (std::string line; std::getline(file, line);) {
+        const auto pos = line.find_first_of('#');
+        if (pos != std::string::npos) {
+            line.erase(pos);
+        }
+        if (!line.empty()) {
+            if (line.back() == '\r') {
+                line.resize(line.size() - 1);
+            }
+            add_expression(line);
+        }
+    }
+}
+
+bool TagsFilterRules::has_rules_for(osmium::item_type type) const noexcept {
+    if (!m_filters(type).empty()) {
+        return true;
+    }
+    return type != osmium::item_type::node && !m_area_filters.empty();
+}
+
+bool TagsFilterRules::matches_node(const osmium::Node& node) const noexcept {
+    return osmium::tags::match_any_of(node.tags(), m_filters(osmium::item_type::node));
+}
+
+bool TagsFilterRules::matches_way(const osmium::Way& way) const noexcept {
+    return osmium::tags::match_any_of(way.tags(), m_filters(osmium::item_type::way)) ||
+           (way.nodes().size() >= 4 &&
+            way.is_closed() &&
+               osmium::tags::match_any_of(way.tags(), m_area_filters));
+}
+
+bool TagsFilterRules::matches_relation(const osmium::Relation& relation) const noexcept {
+    return osmium::tags::match_any_of(relation.tags(), m_filters(osmium::item_type::relation)) ||
+           (is_multipolygon(relation) &&
+               osmium::tags::match_any_of(relation.tags(), m_area_filters));
+}
+
+bool TagsFilterRules::matches_object(const osmium::OSMObject& object) const noexcept {
+    switch (object.type()) {
+        case osmium::item_type::node:
+            return matches_node(static_cast<const osmium::Node&>(object));
+        case osmium::item_type::way:
+            return matches_way(static_cast<const osmium::Way&>(object));
+        case osmium::item_type::relation:
+            return matches_relation(static_cast<const osmium::Relation&>(object));
+        default:
+            break;
+    }
+    return false;
+}
+
+bool is_multipolygon(const osmium::Relation& relation) noexcept {
+    const char* type = relation.tags().get_value_by_key("type");
+    if (type == nullptr) {
+        return false;
+    }
+
+    return !std::strcmp(type, "multipolygon") || !std::strcmp(type, "boundary");
+}
+
+void mark_rel_ids(const osmium::index::RelationsMapIndex& rel_in_rel,
+                  osmium::index::IdSetDense<osmium::unsigned_object_id_type>& ids,
+                  osmium::unsigned_object_id_type parent_id) {
+    rel_in_rel.for_each(parent_id, [&](osmium::unsigned_object_id_type member_id) {
+        if (ids.check_and_set(member_id)) {
+            mark_rel_ids(rel_in_rel, ids, member_id);
+        }
+    });
+}
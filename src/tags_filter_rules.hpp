@@ -0,0 +1,77 @@
+#ifndef TAGS_FILTER_RULES_HPP
+#define TAGS_FILTER_RULES_HPP
+
+/*
+
+Osmium -- OpenStreetMap data manipulation command line tool
+https://osmcode.org/osmium-tool/
+
+Copyright (C) 2013-2023  Jochen Topf <jochen@topf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <osmium/fwd.hpp>
+#include <osmium/index/id_set.hpp>
+#include <osmium/index/nwr_array.hpp>
+#include <osmium/index/relations_map.hpp>
+#include <osmium/osm/entity_bits.hpp>
+#include <osmium/osm/item_type.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/tags/tags_filter.hpp>
+
+#include <string>
+
+/**
+ * The rules built from the filter expressions of the 'tags-filter'
+ * command and the 'tags-filter' stage of the 'pipeline' command.
+ */
+class TagsFilterRules {
+
+    osmium::nwr_array<osmium::TagsFilter> m_filters;
+    osmium::TagsFilter m_area_filters;
+
+public:
+
+    void add_filter(osmium::osm_entity_bits::type entities, const osmium::TagMatcher& matcher);
+
+    // Parse an expression like "w/highway=primary" and add it.
+    void add_expression(const std::string& expression);
+
+    // Add all expressions from a file, one per line. Throws
+    // argument_error if the file can not be opened.
+    void read_expressions_file(const std::string& file_name);
+
+    // Are there any rules which can match objects of this type? Area
+    // rules count for ways and relations.
+    bool has_rules_for(osmium::item_type type) const noexcept;
+
+    bool matches_node(const osmium::Node& node) const noexcept;
+    bool matches_way(const osmium::Way& way) const noexcept;
+    bool matches_relation(const osmium::Relation& relation) const noexcept;
+    bool matches_object(const osmium::OSMObject& object) const noexcept;
+
+}; // class TagsFilterRules
+
+// Is this relation of type multipolygon or boundary?
+bool is_multipolygon(const osmium::Relation& relation) noexcept;
+
+// Recursively add the IDs of all member relations of the relation with
+// the given ID to the set.
+void mark_rel_ids(const osmium::index::RelationsMapIndex& rel_in_rel,
+                  osmium::index::IdSetDense<osmium::unsigned_object_id_type>& ids,
+                  osmium::unsigned_object_id_type parent_id);
+
+#endif // TAGS_FILTER_RULES_HPP
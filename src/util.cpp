@@ -30,10 +30,23 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/util/file.hpp>
 #include <osmium/util/string.hpp>
 
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _MSC_VER
+# include <direct.h>
+# include <process.h>
+#else
+# include <unistd.h>
+#endif
+
 #include <cassert>
+#include <cerrno>
+#include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <system_error>
 #include <vector>
 
 /**
@@ -270,6 +283,43 @@ std::size_t show_mbytes(std::size_t value) noexcept {
     return value / (1024UL * 1024UL);
 }
 
+// Modification time of the file in nanoseconds (where the system supports
+// it), so that a file rewritten within the same second is detected.
+int64_t file_mtime(const std::string& filename) noexcept {
+    struct stat s; // NOLINT(cppcoreguidelines-pro-type-member-init, hicpp-member-init)
+    if (::stat(filename.c_str(), &s) != 0) {
+        return 0;
+    }
+    constexpr const int64_t ns_per_second = 1000000000;
+#if defined(_MSC_VER)
+    return static_cast<int64_t>(s.st_mtime) * ns_per_second;
+#elif defined(__APPLE__)
+    return static_cast<int64_t>(s.st_mtimespec.tv_sec) * ns_per_second + s.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(s.st_mtim.tv_sec) * ns_per_second + s.st_mtim.tv_nsec;
+#endif
+}
+
+// Create a directory, it is not an error if it already exists.
+void create_directory(const std::string& name) {
+#ifdef _MSC_VER
+    const int result = ::_mkdir(name.c_str());
+#else
+    const int result = ::mkdir(name.c_str(), 0777); // NOLINT(hicpp-signed-bitwise)
+#endif
+    if (result != 0 && errno != EEXIST) {
+        throw std::system_error{errno, std::system_category(), std::string{"Could not create directory '"} + name + "'"};
+    }
+}
+
+int process_id() noexcept {
+#ifdef _MSC_VER
+    return ::_getpid();
+#else
+    return static_cast<int>(::getpid());
+#endif
+}
+
 double show_gbytes(std::size_t value) noexcept {
     return static_cast<double>(show_mbytes(value)) / 1000; // NOLINT(bugprone-integer-division)
 }
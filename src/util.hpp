@@ -31,6 +31,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <osmium/tags/tags_filter.hpp>
 #include <osmium/util/string_matcher.hpp>
 
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
@@ -53,5 +54,8 @@ const char* object_type_as_string(const osmium::OSMObject& object) noexcept;
 bool ends_with(const std::string& str, const std::string& suffix);
 std::size_t show_mbytes(std::size_t value) noexcept;
 double show_gbytes(std::size_t value) noexcept;
+int64_t file_mtime(const std::string& filename) noexcept;
+void create_directory(const std::string& name);
+int process_id() noexcept;
 
 #endif // UTIL_HPP
@@ -2,13 +2,19 @@
 #include "test.hpp" // IWYU pragma: keep
 
 #include "exception.hpp"
+#include "extract_index.hpp"
 #include "geojson_file_parser.hpp"
 #include "geometry_util.hpp"
 #include "osm_file_parser.hpp"
 #include "poly_file_parser.hpp"
+#include "polygon_cache.hpp"
 
 #include <osmium/memory/buffer.hpp>
 
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
 TEST_CASE("Parse poly files") {
     osmium::memory::Buffer buffer{1024};
 
@@ -209,6 +215,53 @@ TEST_CASE("Parse OSM files") {
 
 }
 
+TEST_CASE("Get polygons from OSM files through polygon cache") {
+    osmium::memory::Buffer buffer{1024};
+    PolygonCache cache;
+
+    SECTION("Missing OSM file") {
+        cache.prefetch("test/extract/missing.osm.opl");
+        cache.load(2);
+        REQUIRE_THROWS(cache.get("test/extract/missing.osm.opl", buffer));
+    }
+
+    SECTION("Prefetched files") {
+        cache.prefetch("test/extract/polygon-way.osm.opl");
+        cache.prefetch("test/extract/multipolygon.osm.opl");
+        cache.load(2);
+
+        REQUIRE(cache.get("test/extract/multipolygon.osm.opl", buffer) == 0);
+        const auto offset = cache.get("test/extract/polygon-way.osm.opl", buffer);
+        REQUIRE(offset > 0);
+
+        const auto nr1 = buffer.get<osmium::Area>(0).num_rings();
+        REQUIRE(nr1.first == 2);
+        REQUIRE(nr1.second == 1);
+
+        const auto nr2 = buffer.get<osmium::Area>(offset).num_rings();
+        REQUIRE(nr2.first == 1);
+        REQUIRE(nr2.second == 0);
+    }
+
+    SECTION("File not prefetched") {
+        REQUIRE(cache.get("test/extract/polygon-two-ways.osm.opl", buffer) == 0);
+        const auto nr = buffer.get<osmium::Area>(0).num_rings();
+        REQUIRE(nr.first == 2);
+        REQUIRE(nr.second == 0);
+    }
+
+    REQUIRE(cache.cache_hits() == 0);
+    REQUIRE(cache.cache_misses() == 0);
+}
+
+TEST_CASE("Polygon cache file name") {
+    const auto name = polygon_cache_filename("cache", "test/extract/multipolygon.osm.opl");
+    REQUIRE(name.substr(0, 6) == "cache/");
+    REQUIRE(name.size() == 6 + 16 + 10);
+    REQUIRE(name == polygon_cache_filename("cache/", "test/extract/multipolygon.osm.opl"));
+    REQUIRE(name != polygon_cache_filename("cache", "test/extract/polygon-way.osm.opl"));
+}
+
 TEST_CASE("Parse GeoJSON files") {
     osmium::memory::Buffer buffer{1024};
 
@@ -257,3 +310,78 @@ TEST_CASE("Ring orientation (counter-clockwise)") {
     REQUIRE(is_ccw(c));
 }
 
+
+TEST_CASE("Segment intersection") {
+    osmium::Location location;
+
+    SECTION("crossing segments") {
+        REQUIRE(segment_intersection(osmium::Location{0.0, 0.0}, osmium::Location{2.0, 2.0},
+                                     osmium::Location{0.0, 2.0}, osmium::Location{2.0, 0.0}, &location));
+        REQUIRE(location == osmium::Location(1.0, 1.0));
+    }
+
+    SECTION("touching segments") {
+        REQUIRE(segment_intersection(osmium::Location{0.0, 0.0}, osmium::Location{2.0, 0.0},
+                                     osmium::Location{1.0, 0.0}, osmium::Location{1.0, 1.0}, &location));
+        REQUIRE(location == osmium::Location(1.0, 0.0));
+    }
+
+    SECTION("disjoint segments") {
+        REQUIRE_FALSE(segment_intersection(osmium::Location{0.0, 0.0}, osmium::Location{1.0, 1.0},
+                                           osmium::Location{2.0, 0.0}, osmium::Location{3.0, 1.0}, &location));
+    }
+
+    SECTION("parallel segments") {
+        REQUIRE_FALSE(segment_intersection(osmium::Location{0.0, 0.0}, osmium::Location{2.0, 0.0},
+                                           osmium::Location{0.0, 1.0}, osmium::Location{2.0, 1.0}, &location));
+    }
+}
+
+static std::vector<std::size_t> find_extracts(const ExtractIndex& index, double lon, double lat) {
+    std::vector<std::size_t> result;
+    index.for_each(osmium::Location{lon, lat}, [&](std::size_t n) {
+        result.push_back(n);
+    });
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+TEST_CASE("Extract index") {
+    std::vector<osmium::Box> envelopes;
+    for (int x = 0; x < 10; ++x) {
+        envelopes.emplace_back(x, 0.0, x + 1.0, 1.0);
+    }
+    envelopes.emplace_back(-180.0, -90.0, 180.0, 90.0);
+    envelopes.emplace_back(2.5, 0.5, 3.5, 0.7);
+
+    const ExtractIndex index{envelopes};
+
+    REQUIRE(find_extracts(index, 0.5, 0.5) == std::vector<std::size_t>({0, 10}));
+    REQUIRE(find_extracts(index, 3.0, 0.6) == std::vector<std::size_t>({2, 3, 10, 11}));
+    REQUIRE(find_extracts(index, 9.5, 0.9) == std::vector<std::size_t>({9, 10}));
+    REQUIRE(find_extracts(index, 20.0, 20.0) == std::vector<std::size_t>({10}));
+    REQUIRE(find_extracts(index, 180.0, 90.0) == std::vector<std::size_t>({10}));
+    REQUIRE(find_extracts(index, 9.5, 1.5) == std::vector<std::size_t>({10}));
+}
+
+TEST_CASE("Extract index with invalid location") {
+    const std::vector<osmium::Box> envelopes{osmium::Box{0.0, 0.0, 1.0, 1.0}};
+    const ExtractIndex index{envelopes};
+
+    bool called = false;
+    index.for_each(osmium::Location{}, [&](std::size_t /*n*/) {
+        called = true;
+    });
+    REQUIRE_FALSE(called);
+}
+
+TEST_CASE("Location on segment") {
+    const osmium::Location a{0.0, 0.0};
+    const osmium::Location b{2.0, 2.0};
+
+    REQUIRE(on_segment(osmium::Location{1.0, 1.0}, a, b));
+    REQUIRE(on_segment(a, a, b));
+    REQUIRE(on_segment(b, a, b));
+    REQUIRE_FALSE(on_segment(osmium::Location{3.0, 3.0}, a, b));
+    REQUIRE_FALSE(on_segment(osmium::Location{1.0, 0.0}, a, b));
+}
@@ -11,5 +11,49 @@ TEST_CASE("time-filter") {
         REQUIRE_THROWS_AS(cmd.setup({}), argument_error);
     }
 
+    SECTION("list of snapshots") {
+        cmd.setup({"--snapshot=2015-02-01T00:00:00Z,2015-01-01T00:00:00Z", "--snapshot=2015-03-01T00:00:00Z", "-o", "out-{}.osm.pbf", "in.osh.pbf"});
+
+        const auto& snapshots = cmd.snapshots();
+        REQUIRE(snapshots.size() == 3);
+        REQUIRE(snapshots[0] == osmium::Timestamp{"2015-01-01T00:00:00Z"});
+        REQUIRE(snapshots[2] == osmium::Timestamp{"2015-03-01T00:00:00Z"});
+
+        const auto& files = cmd.output_files();
+        REQUIRE(files.size() == 3);
+        REQUIRE(files[0].filename() == "out-20150101T000000Z.osm.pbf");
+        REQUIRE(files[0].format() == osmium::io::file_format::pbf);
+    }
+
+    SECTION("snapshot range in months") {
+        cmd.setup({"--snapshot-range=2014-11-15T00:00:00Z,2015-03-01T00:00:00Z,1m", "-o", "out-{}.osm", "in.osh"});
+
+        const auto& snapshots = cmd.snapshots();
+        REQUIRE(snapshots.size() == 4);
+        REQUIRE(snapshots[0] == osmium::Timestamp{"2014-11-15T00:00:00Z"});
+        REQUIRE(snapshots[1] == osmium::Timestamp{"2014-12-15T00:00:00Z"});
+        REQUIRE(snapshots[2] == osmium::Timestamp{"2015-01-15T00:00:00Z"});
+        REQUIRE(snapshots[3] == osmium::Timestamp{"2015-02-15T00:00:00Z"});
+    }
+
+    SECTION("snapshot range in days") {
+        cmd.setup({"--snapshot-range=2015-01-01T00:00:00Z,2015-01-03T00:00:00Z,1d", "-o", "out-{}.osm", "in.osh"});
+        REQUIRE(cmd.snapshots().size() == 3);
+    }
+
+    SECTION("multiple snapshots need pattern in output file name") {
+        REQUIRE_THROWS_AS(cmd.setup({"--snapshot=2015-01-01T00:00:00Z,2015-02-01T00:00:00Z", "-o", "out.osm", "in.osh"}), argument_error);
+    }
+
+    SECTION("snapshots together with time arguments") {
+        REQUIRE_THROWS_AS(cmd.setup({"--snapshot=2015-01-01T00:00:00Z", "-o", "out.osm", "in.osh", "2015-01-01T00:00:00Z"}), argument_error);
+    }
+
+    SECTION("broken snapshot range") {
+        REQUIRE_THROWS_AS(cmd.setup({"--snapshot-range=2015-01-01T00:00:00Z,2015-02-01T00:00:00Z", "-o", "out-{}.osm", "in.osh"}), argument_error);
+        REQUIRE_THROWS_AS(cmd.setup({"--snapshot-range=2015-01-01T00:00:00Z,2015-02-01T00:00:00Z,1x", "-o", "out-{}.osm", "in.osh"}), argument_error);
+        REQUIRE_THROWS_AS(cmd.setup({"--snapshot-range=2015-01-31T00:00:00Z,2015-05-01T00:00:00Z,1m", "-o", "out-{}.osm", "in.osh"}), argument_error);
+    }
+
 }
 
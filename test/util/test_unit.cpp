@@ -1,8 +1,16 @@
 
 #include "test.hpp" // IWYU pragma: keep
 
+#include "buffer_compactor.hpp"
+#include "buffer_pool.hpp"
+#include "external_sort.hpp"
 #include "util.hpp"
 
+#include <osmium/builder/attr.hpp>
+#include <osmium/osm/node.hpp>
+
+#include <vector>
+
 TEST_CASE("Get suffix from filename") {
     REQUIRE(get_filename_suffix("foo.bar") == "bar");
 }
@@ -135,3 +143,177 @@ TEST_CASE("ends_with") {
     REQUIRE(ends_with("file.osm.bz2", ".bz2"));
     REQUIRE(ends_with("file.osm.bz2", ".osm.bz2"));
 }
+
+static std::vector<ExternalIdPairs::value_type> sorted_pairs(ExternalIdPairs& pairs) {
+    std::vector<ExternalIdPairs::value_type> result;
+    pairs.for_each_sorted([&](const ExternalIdPairs::value_type& value) {
+        result.push_back(value);
+    });
+    return result;
+}
+
+TEST_CASE("External ID pairs in memory") {
+    ExternalIdPairs pairs{10};
+    pairs.push_back({3, 1});
+    pairs.push_back({-2, 5});
+    pairs.push_back({3, 0});
+    REQUIRE(pairs.size() == 3);
+    REQUIRE(pairs.used_disk() == 0);
+
+    const std::vector<ExternalIdPairs::value_type> expected{{-2, 5}, {3, 0}, {3, 1}};
+    REQUIRE(sorted_pairs(pairs) == expected);
+    REQUIRE(pairs.empty());
+}
+
+TEST_CASE("External ID pairs with temporary files") {
+    ExternalIdPairs pairs{3};
+    for (osmium::object_id_type id = 10; id > 0; --id) {
+        pairs.push_back({id % 4, id});
+    }
+    REQUIRE(pairs.size() == 10);
+    REQUIRE(pairs.used_disk() > 0);
+
+    const std::vector<ExternalIdPairs::value_type> expected{
+        {0, 4}, {0, 8}, {1, 1}, {1, 5}, {1, 9}, {2, 2}, {2, 6}, {2, 10}, {3, 3}, {3, 7}
+    };
+    REQUIRE(sorted_pairs(pairs) == expected);
+}
+
+static osmium::memory::Buffer new_buffer(std::size_t capacity) {
+    return osmium::memory::Buffer{capacity, osmium::memory::Buffer::auto_grow::no};
+}
+
+TEST_CASE("Buffer pool allocates new buffer if empty") {
+    BufferPool pool{2, 1024 * 1024};
+    const auto buffer = pool.get(1024);
+    REQUIRE(buffer);
+    REQUIRE(buffer.capacity() >= 1024);
+    REQUIRE(pool.size() == 0);
+}
+
+TEST_CASE("Buffer pool reuses buffers") {
+    BufferPool pool{2, 1024 * 1024};
+    auto buffer = new_buffer(4096);
+    buffer.reserve_space(64);
+    buffer.commit();
+    const auto* data = buffer.data();
+
+    pool.put(std::move(buffer));
+    REQUIRE(pool.size() == 1);
+    REQUIRE(pool.memory() == 4096);
+
+    const auto reused = pool.get(1024);
+    REQUIRE(reused.data() == data);
+    REQUIRE(reused.committed() == 0);
+    REQUIRE(pool.size() == 0);
+    REQUIRE(pool.memory() == 0);
+}
+
+TEST_CASE("Buffer pool only returns buffers that are large enough") {
+    BufferPool pool{2, 1024 * 1024};
+    pool.put(new_buffer(1024));
+
+    const auto buffer = pool.get(8192);
+    REQUIRE(buffer.capacity() == 8192);
+    REQUIRE(pool.size() == 1);
+
+    const auto small = pool.get(8192, 1024);
+    REQUIRE(small.capacity() == 1024);
+    REQUIRE(pool.size() == 0);
+}
+
+TEST_CASE("Buffer pool returns smallest matching buffer") {
+    BufferPool pool{3, 1024 * 1024};
+    pool.put(new_buffer(16384));
+    pool.put(new_buffer(4096));
+    pool.put(new_buffer(1024));
+
+    const auto buffer = pool.get(2048);
+    REQUIRE(buffer.capacity() == 4096);
+    REQUIRE(pool.size() == 2);
+    REQUIRE(pool.memory() == 16384 + 1024);
+}
+
+TEST_CASE("Buffer pool keeps its limits") {
+    BufferPool pool{2, 16 * 1024};
+    pool.put(new_buffer(1024));
+    pool.put(new_buffer(1024));
+    pool.put(new_buffer(1024));
+    REQUIRE(pool.size() == 2);
+
+    pool.clear();
+    REQUIRE(pool.size() == 0);
+    REQUIRE(pool.memory() == 0);
+
+    pool.put(new_buffer(32 * 1024));
+    REQUIRE(pool.size() == 0);
+}
+
+static osmium::memory::Buffer buffer_with_node(osmium::object_id_type id) {
+    auto buffer = new_buffer(4096);
+    osmium::builder::add_node(buffer, osmium::builder::attr::_id(id));
+    return buffer;
+}
+
+TEST_CASE("Buffer compactor packs partially filled buffers") {
+    std::vector<osmium::memory::Buffer> buffers;
+    BufferCompactor compactor{[&](osmium::memory::Buffer&& buffer) {
+        buffers.push_back(std::move(buffer));
+    }};
+
+    compactor.add(buffer_with_node(1));
+    compactor.add(buffer_with_node(2));
+    compactor.add(buffer_with_node(3));
+    compactor.flush();
+
+    REQUIRE(buffers.size() == 1);
+    REQUIRE(buffers[0].capacity() == buffers[0].committed());
+
+    std::vector<osmium::object_id_type> ids;
+    for (const auto& node : buffers[0].select<osmium::Node>()) {
+        ids.push_back(node.id());
+    }
+    REQUIRE(ids == std::vector<osmium::object_id_type>{1, 2, 3});
+}
+
+TEST_CASE("Buffer compactor passes full buffers through") {
+    const auto node_buffer = buffer_with_node(1);
+    auto full = new_buffer(node_buffer.committed());
+    full.add_item(*node_buffer.begin());
+    full.commit();
+    const auto* data = full.data();
+
+    std::vector<osmium::memory::Buffer> buffers;
+    BufferCompactor compactor{[&](osmium::memory::Buffer&& buffer) {
+        buffers.push_back(std::move(buffer));
+    }};
+
+    compactor.add(buffer_with_node(2));
+    compactor.add(std::move(full));
+    compactor.add(buffer_with_node(3));
+    compactor.flush();
+
+    REQUIRE(buffers.size() == 3);
+    REQUIRE(buffers[1].data() == data);
+    REQUIRE(buffers[0].select<osmium::Node>().begin()->id() == 2);
+    REQUIRE(buffers[2].select<osmium::Node>().begin()->id() == 3);
+}
+
+TEST_CASE("Buffer compactor keeps the maximum buffer size") {
+    const auto size = buffer_with_node(1).committed();
+
+    std::vector<osmium::memory::Buffer> buffers;
+    BufferCompactor compactor{[&](osmium::memory::Buffer&& buffer) {
+        buffers.push_back(std::move(buffer));
+    }, size * 2};
+
+    for (osmium::object_id_type id = 1; id <= 5; ++id) {
+        compactor.add(buffer_with_node(id));
+    }
+    compactor.flush();
+
+    REQUIRE(buffers.size() == 3);
+    REQUIRE(buffers[0].committed() == size * 2);
+    REQUIRE(buffers[1].committed() == size * 2);
+    REQUIRE(buffers[2].committed() == size);
+}